@@ -0,0 +1,330 @@
+// Headless benchmark: renders the default scene offscreen along a camera
+// path and writes CPU and GPU frame-time statistics as JSON.
+//
+//   Benchmark [--width W] [--height H] [--warmup N] [--frames N] [--repeat N]
+//             [--path FILE] [--out FILE] [--stats-log FILE] [--dump-graph FILE]
+//             [--deferred] [--depth-prepass] [--occlusion-culling]
+//             [--gpu-culling] [--hiz-culling] [--sdsm] [--resolution-scale F]
+//             [--gpu-target MS] [--stress-* ...]
+//
+// The --stress-* flags (see stress_scene.h) add procedural models and
+// lights, sweeping --stress-models or --stress-point-lights gives frame
+// time against N. Dynamic models move with the frame index, not the clock.
+// --gpu-target turns on dynamic resolution with that GPU frame time goal,
+// --resolution-scale fixes the render scale instead.
+//
+// Every repetition replays the whole path: warm-up frames first (shader
+// compilation, buffer growth, GPU clocks), then the measured frames. The
+// camera pose depends only on the frame index, so runs on the same machine
+// render identical frames and their numbers can be compared directly.
+#include "scene.h"
+#include "window.h"
+#include "renderer.h"
+#include "default_scene.h"
+#include "camera_path.h"
+#include "stress_scene.h"
+#include "frame_stats.h"
+#include "gpu_timer.h"
+#include "profiler.h"
+
+// standart libraries
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct BenchmarkOptions {
+  int width = 1280;
+  int height = 720;
+  unsigned int warmup = 60;
+  unsigned int frames = 600;
+  unsigned int repeat = 3;
+  std::string path;  // empty - orbit around the scene
+  std::string out = "benchmark.json";
+  std::string stats_log;
+  std::string dump_graph;  // Graphviz file of the last frame's frame graph
+  StressSceneOptions stress;
+};
+
+// Statistics of one series of frame times
+struct TimeSummary {
+  double mean = 0.0, stddev = 0.0;
+  float min = 0.0f, p50 = 0.0f, p90 = 0.0f, p95 = 0.0f, p99 = 0.0f, max = 0.0f;
+};
+
+// Per-frame samples of one repetition
+struct RunSamples {
+  std::vector<float> frame_ms;  // RenderScene including the swap
+  std::vector<float> cpu_ms;    // RenderScene up to the swap
+  std::vector<float> gpu_ms;    // sum of the timed passes
+  unsigned long long draw_calls = 0;
+  unsigned long long triangles = 0;
+};
+
+// Nearest rank, same definition as FrameTimeHistory::Percentile
+static float Percentile(const std::vector<float>& sorted, float p) {
+  size_t rank = (size_t)std::ceil(p / 100.0f * sorted.size());
+  return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static TimeSummary Summarize(std::vector<float> samples) {
+  TimeSummary summary;
+  if (samples.empty()) return summary;
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (float ms : samples) sum += ms;
+  summary.mean = sum / samples.size();
+  double variance = 0.0;
+  for (float ms : samples) variance += (ms - summary.mean) * (ms - summary.mean);
+  summary.stddev = std::sqrt(variance / samples.size());
+  summary.min = samples.front();
+  summary.max = samples.back();
+  summary.p50 = Percentile(samples, 50.0f);
+  summary.p90 = Percentile(samples, 90.0f);
+  summary.p95 = Percentile(samples, 95.0f);
+  summary.p99 = Percentile(samples, 99.0f);
+  return summary;
+}
+
+// JSON OUTPUT
+//=-----------------------------=
+static void WriteString(FILE* file, const char* text) {
+  std::fputc('"', file);
+  for (const char* c = text ? text : ""; *c; c++) {
+    if (*c == '"' || *c == '\\') std::fputc('\\', file);
+    if ((unsigned char)*c >= 0x20) std::fputc(*c, file);
+  }
+  std::fputc('"', file);
+}
+
+static void WriteSummary(FILE* file, const char* name, const TimeSummary& s) {
+  std::fprintf(file, "\"%s\":{\"mean\":%.4f,\"stddev\":%.4f,\"min\":%.4f,\"p50\":%.4f,\"p90\":%.4f,"
+               "\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}", name, s.mean, s.stddev, s.min, s.p50, s.p90, s.p95,
+               s.p99, s.max);
+}
+
+static void WriteRun(FILE* file, const RunSamples& run) {
+  WriteSummary(file, "frame_ms", Summarize(run.frame_ms));
+  std::fputc(',', file);
+  WriteSummary(file, "cpu_ms", Summarize(run.cpu_ms));
+  std::fputc(',', file);
+  WriteSummary(file, "gpu_ms", Summarize(run.gpu_ms));
+  size_t frames = std::max<size_t>(run.frame_ms.size(), 1);
+  std::fprintf(file, ",\"draw_calls\":%.1f,\"triangles\":%.1f", (double)run.draw_calls / frames,
+               (double)run.triangles / frames);
+}
+
+static bool WriteReport(const std::string& path, const BenchmarkOptions& options, const Properties& properties,
+                        bool gpu_statistics, const std::vector<RunSamples>& runs) {
+  FILE* file = std::fopen(path.c_str(), "w");
+  if (!file) return false;
+
+  std::fputs("{\"gl_renderer\":", file);
+  WriteString(file, (const char*)glGetString(GL_RENDERER));
+  std::fputs(",\"gl_version\":", file);
+  WriteString(file, (const char*)glGetString(GL_VERSION));
+  std::fprintf(file, ",\"width\":%d,\"height\":%d,\"warmup\":%u,\"frames\":%u,\"repeat\":%u,\"path\":",
+               options.width, options.height, options.warmup, options.frames, options.repeat);
+  WriteString(file, options.path.empty() ? "orbit" : options.path.c_str());
+  std::fprintf(file, ",\"stress\":{\"models\":%u,\"layout\":%d,\"dynamic_fraction\":%.3f,\"hierarchy_depth\":%u,"
+               "\"point_lights\":%u,\"spot_lights\":%u,\"light_radius_min\":%.2f,\"light_radius_max\":%.2f,"
+               "\"seed\":%u}", options.stress.models, (int)options.stress.layout, options.stress.dynamic_fraction,
+               options.stress.hierarchy_depth, options.stress.point_lights, options.stress.spot_lights,
+               options.stress.light_radius_min, options.stress.light_radius_max, options.stress.seed);
+  std::fprintf(file, ",\"settings\":{\"deferred_shading\":%s,\"depth_prepass\":%s,\"occlusion_culling\":%s,"
+               "\"gpu_culling\":%s,\"hiz_culling\":%s,\"sdsm\":%s,\"dynamic_resolution\":%s,\"resolution_scale\":%.3f,"
+               "\"gpu_target_ms\":%.2f},\"pipeline_statistics\":%s",
+               properties.deferred_shading ? "true" : "false", properties.depth_prepass ? "true" : "false",
+               properties.occlusion_culling ? "true" : "false", properties.gpu_culling ? "true" : "false",
+               properties.hiz_culling ? "true" : "false", properties.sdsm ? "true" : "false",
+               properties.dynamic_resolution ? "true" : "false",
+               properties.resolution_scale, properties.gpu_target_ms, gpu_statistics ? "true" : "false");
+
+  // Every repetition, then all of them pooled
+  RunSamples all;
+  std::fputs(",\"runs\":[", file);
+  for (size_t i = 0; i < runs.size(); i++) {
+    std::fputs(i ? ",\n{" : "\n{", file);
+    WriteRun(file, runs[i]);
+    std::fputc('}', file);
+    all.frame_ms.insert(all.frame_ms.end(), runs[i].frame_ms.begin(), runs[i].frame_ms.end());
+    all.cpu_ms.insert(all.cpu_ms.end(), runs[i].cpu_ms.begin(), runs[i].cpu_ms.end());
+    all.gpu_ms.insert(all.gpu_ms.end(), runs[i].gpu_ms.begin(), runs[i].gpu_ms.end());
+    all.draw_calls += runs[i].draw_calls;
+    all.triangles += runs[i].triangles;
+  }
+  std::fputs("],\n\"total\":{", file);
+  WriteRun(file, all);
+  std::fputs("}}\n", file);
+  return std::fclose(file) == 0;
+}
+
+// RENDERING
+//=-----------------------------=
+static float GpuFrameMs(const GpuTimer& timer) {
+  float ms = 0.0f;
+  for (int pass = 0; pass < GPU_PASS_COUNT; pass++) ms += timer.result(pass).ms;
+  return ms;
+}
+
+// Content the frames are rendered from
+struct BenchmarkScene {
+  Camera* camera;
+  SpotLight* flashlight;
+  StressScene* stress;
+  const CameraPath* path;
+};
+
+static void RenderFrame(Renderer& renderer, const BenchmarkScene& scene, unsigned int frame, float t) {
+  PROFILE_FRAME();
+  Camera* camera = scene.camera;
+  SpotLight* flashlight = scene.flashlight;
+  CameraPath::Apply(camera, scene.path->Sample(t));
+  scene.stress->Animate(frame / 60.0f);
+  flashlight->setPosition(camera->getPosition());
+  flashlight->setDirection(camera->Front);
+  renderer.RenderScene(false);
+}
+
+static RunSamples Run(Renderer& renderer, const BenchmarkScene& scene, const BenchmarkOptions& options) {
+  RunSamples run;
+  for (unsigned int i = 0; i < options.warmup; i++)
+    RenderFrame(renderer, scene, i, options.warmup > 1 ? (float)i / (options.warmup - 1) : 0.0f);
+
+  // GPU results arrive GpuTimer::FRAMES frames late and a set that was not
+  // ready is dropped, so samples are matched to the frame they belong to;
+  // a few extra frames at the end of the path collect the last ones
+  GpuTimer& timer = renderer.gpu_timer_;
+  unsigned int first_gpu_frame = 0, last_gpu_frame = 0, last_result = timer.result_frame();
+  for (unsigned int i = 0; i < options.frames + 2 * GpuTimer::FRAMES; i++) {
+    bool measured = i < options.frames;
+    float t = options.frames > 1 ? (float)std::min(i, options.frames - 1) / (options.frames - 1) : 0.0f;
+    uint64_t begin = profiler::Now();
+    RenderFrame(renderer, scene, i, t);
+    if (measured) {
+      run.frame_ms.push_back((profiler::Now() - begin) / 1e6f);
+      run.cpu_ms.push_back(renderer.cpu_ms_);
+      // Cleared by the next frame, complete until then
+      run.draw_calls += frame_stats::counters.draw_calls;
+      run.triangles += frame_stats::counters.triangles;
+      if (i == 0) first_gpu_frame = timer.frame();
+      last_gpu_frame = timer.frame();
+    }
+    unsigned int result = timer.result_frame();
+    if (result != last_result && result >= first_gpu_frame && result <= last_gpu_frame)
+      run.gpu_ms.push_back(GpuFrameMs(timer));
+    last_result = result;
+    if (!measured && result >= last_gpu_frame) break;
+  }
+  // Nothing of this run is left in flight for the next one
+  glFinish();
+  return run;
+}
+
+static bool ParseOptions(int argc, char** argv, BenchmarkOptions& options, Properties& properties) {
+  for (int i = 1; i < argc; i++) {
+    int used = ParseStressSceneArg(argc, argv, i, options.stress);
+    if (used < 0) return false;
+    if (used > 0) {
+      i += used - 1;
+      continue;
+    }
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    auto number = [&]() { i++; return (unsigned int)std::strtoul(value, nullptr, 10); };
+    if (strcmp(arg, "--deferred") == 0) properties.deferred_shading = true;
+    else if (strcmp(arg, "--depth-prepass") == 0) properties.depth_prepass = true;
+    else if (strcmp(arg, "--occlusion-culling") == 0) properties.occlusion_culling = true;
+    else if (strcmp(arg, "--gpu-culling") == 0) properties.gpu_culling = true;
+    else if (strcmp(arg, "--hiz-culling") == 0) properties.gpu_culling = properties.hiz_culling = true;
+    else if (strcmp(arg, "--sdsm") == 0) properties.sdsm = true;
+    else if (!value) { std::cout << "Missing value for " << arg << std::endl; return false; }
+    else if (strcmp(arg, "--width") == 0) options.width = (int)number();
+    else if (strcmp(arg, "--height") == 0) options.height = (int)number();
+    else if (strcmp(arg, "--warmup") == 0) options.warmup = number();
+    else if (strcmp(arg, "--frames") == 0) options.frames = number();
+    else if (strcmp(arg, "--repeat") == 0) options.repeat = number();
+    else if (strcmp(arg, "--path") == 0) options.path = argv[++i];
+    else if (strcmp(arg, "--out") == 0) options.out = argv[++i];
+    else if (strcmp(arg, "--stats-log") == 0) options.stats_log = argv[++i];
+    else if (strcmp(arg, "--dump-graph") == 0) options.dump_graph = argv[++i];
+    else if (strcmp(arg, "--resolution-scale") == 0) properties.resolution_scale = std::strtof(argv[++i], nullptr);
+    else if (strcmp(arg, "--gpu-target") == 0) {
+      properties.dynamic_resolution = true;
+      properties.gpu_target_ms = std::strtof(argv[++i], nullptr);
+    }
+    else { std::cout << "Unknown option " << arg << std::endl; return false; }
+  }
+  if (options.width <= 0 || options.height <= 0 || !options.frames || !options.repeat) {
+    std::cout << "Size, frames and repeat must be positive" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  BenchmarkOptions options;
+  Properties properties;
+  if (!ParseOptions(argc, argv, options, properties)) return 1;
+
+  Window window(4, 5, options.width, options.height);
+  if (!window.IsValid()) return 1;
+  // Every shader is GLSL 4.50, an older compiler would leave the frames
+  // half drawn instead of failing
+  const char* glsl = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+  int glsl_major = 0, glsl_minor = 0;
+  if (!glsl || std::sscanf(glsl, "%d.%d", &glsl_major, &glsl_minor) != 2 || glsl_major * 100 + glsl_minor < 450) {
+    std::cout << "GLSL 4.50 is required, the driver reports " << (glsl ? glsl : "no version") << std::endl;
+    return 1;
+  }
+
+  Scene scene;
+  scene.properties = properties;
+  DefaultScene default_scene = BuildDefaultScene(scene);
+  Camera* camera = default_scene.camera;
+  StressScene stress_scene;
+  if (options.stress.enabled()) stress_scene.Build(scene, camera, options.stress);
+
+  CameraPath path;
+  if (!options.path.empty() && !path.Load(options.path)) {
+    std::cout << "Could not read camera path " << options.path << std::endl;
+    return 1;
+  }
+  if (options.path.empty()) {
+    float radius = std::max(8.0f, 1.2f * stress_scene.extent());
+    path = CameraPath::Orbit(stress_scene.center(), radius, 0.4f * radius, 16);
+  }
+  camera->screenWidth = options.width;
+  camera->screenHeight = options.height;
+
+  Renderer renderer(&window, &scene);
+  if (!options.stats_log.empty() && !renderer.stats_logger_.Open(options.stats_log))
+    std::cout << "Could not open " << options.stats_log << std::endl;
+
+  std::cout << "Benchmark on " << glGetString(GL_RENDERER) << ", " << options.width << "x" << options.height
+            << ", " << options.warmup << " warm-up + " << options.frames << " frames x " << options.repeat
+            << std::endl;
+
+  std::vector<RunSamples> runs;
+  for (unsigned int r = 0; r < options.repeat; r++) {
+    runs.push_back(Run(renderer, { camera, default_scene.flashlight, &stress_scene, &path }, options));
+    TimeSummary frame = Summarize(runs.back().frame_ms);
+    TimeSummary gpu = Summarize(runs.back().gpu_ms);
+    std::printf("Run %u: frame %.3f ms (p95 %.3f, p99 %.3f), gpu %.3f ms\n", r + 1, frame.mean, frame.p95,
+                frame.p99, gpu.mean);
+  }
+
+  bool written = WriteReport(options.out, options, scene.properties, renderer.gpu_timer_.statistics_supported(),
+                             runs);
+  if (written) std::cout << "Results written to " << options.out << std::endl;
+  else std::cout << "Could not write " << options.out << std::endl;
+  if (!options.dump_graph.empty() && !renderer.frame_graph_.DumpToFile(options.dump_graph))
+    std::cout << "Could not write " << options.dump_graph << std::endl;
+
+  renderer.Terminate();
+  return written ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#ifndef CAMERA_PATH_H_
+#define CAMERA_PATH_H_
+
+#include <glm/glm.hpp>
+#include <custom/camera.h>
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Camera pose, pitch and yaw in degrees as in Object::getRotation()
+struct CameraKey {
+  glm::vec3 position = glm::vec3(0.0f);
+  float pitch = 0.0f;
+  float yaw = 0.0f;
+};
+
+// CAMERA PATH
+//=-----------------------------=
+// Keyframes played back with a Catmull-Rom spline, the curve passes through
+// every key. Files hold one key per line, "x y z pitch yaw", '#' starts a
+// comment; F10 in the editor appends the current camera to camera_path.txt.
+// Sampling is by path parameter, not by time, so a benchmark renders the
+// same frames no matter how fast it runs.
+class CameraPath {
+  std::vector<CameraKey> keys_;
+
+public:
+  size_t size() const { return keys_.size(); }
+  void Add(const CameraKey& key) { keys_.push_back(key); }
+
+  bool Load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+    keys_.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+      size_t comment = line.find('#');
+      if (comment != std::string::npos) line.resize(comment);
+      std::istringstream in(line);
+      CameraKey key;
+      if (in >> key.position.x >> key.position.y >> key.position.z >> key.pitch >> key.yaw) keys_.push_back(key);
+    }
+    return !keys_.empty();
+  }
+
+  static bool Append(const std::string& path, const CameraKey& key) {
+    std::ofstream file(path, std::ios::app);
+    if (!file) return false;
+    file << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' '
+         << key.pitch << ' ' << key.yaw << '\n';
+    return (bool)file;
+  }
+
+  // Full circle around center looking at it, the last key repeats the first
+  static CameraPath Orbit(const glm::vec3& center, float radius, float height, int key_count) {
+    CameraPath path;
+    for (int i = 0; i <= key_count; i++) {
+      float angle = 2.0f * 3.14159265f * i / key_count;
+      CameraKey key;
+      key.position = center + glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle));
+      // Facing -offset: yaw is the angle plus half a turn, kept continuous
+      // so the spline does not spin at the wrap
+      key.yaw = glm::degrees(angle) + 180.0f;
+      key.pitch = glm::degrees(std::atan2(-height, radius));
+      path.Add(key);
+    }
+    return path;
+  }
+
+  // t in [0, 1] over the whole path, the end keys are repeated as tangents
+  CameraKey Sample(float t) const {
+    if (keys_.empty()) return CameraKey();
+    if (keys_.size() == 1) return keys_[0];
+    float segment = glm::clamp(t, 0.0f, 1.0f) * (keys_.size() - 1);
+    int i = glm::min((int)segment, (int)keys_.size() - 2);
+    float u = segment - i;
+    const CameraKey& p0 = keys_[glm::max(i - 1, 0)];
+    const CameraKey& p1 = keys_[i];
+    const CameraKey& p2 = keys_[i + 1];
+    const CameraKey& p3 = keys_[glm::min(i + 2, (int)keys_.size() - 1)];
+    CameraKey key;
+    key.position = CatmullRom(p0.position, p1.position, p2.position, p3.position, u);
+    key.pitch = CatmullRom(p0.pitch, p1.pitch, p2.pitch, p3.pitch, u);
+    key.yaw = CatmullRom(p0.yaw, p1.yaw, p2.yaw, p3.yaw, u);
+    return key;
+  }
+
+  static void Apply(Camera* camera, const CameraKey& key) {
+    camera->setPosition(key.position);
+    glm::vec3 rotation = camera->getRotation();
+    rotation.x = glm::clamp(key.pitch, -89.0f, 89.0f);
+    rotation.y = key.yaw;
+    camera->setRotation(rotation);
+    camera->updateCameraVectors();
+  }
+
+  static CameraKey FromCamera(Camera* camera) {
+    CameraKey key;
+    key.position = camera->getPosition();
+    key.pitch = camera->getRotation().x;
+    key.yaw = camera->getRotation().y;
+    return key;
+  }
+
+private:
+  template <typename T>
+  static T CatmullRom(const T& p0, const T& p1, const T& p2, const T& p3, float u) {
+    float u2 = u * u;
+    float u3 = u2 * u;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+  }
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef CASCADE_SCHEDULER_H_
+#define CASCADE_SCHEDULER_H_
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+struct CascadeSchedulerStats {
+  unsigned int updated = 0;           // cascades redrawn with this frame's matrix
+  unsigned int stale = 0;             // kept last matrix and map
+  unsigned int deferred = 0;          // were due but did not fit the triangle budget
+  unsigned long long triangles = 0;   // estimated cost of the updated cascades
+};
+
+// CASCADE SCHEDULER
+//=-----------------------------=
+// Decides which sun cascades are redrawn this frame. A cascade with an
+// interval of N is due every Nth frame, offset by its index so the far
+// cascades take turns instead of all landing on the same frame. A cascade
+// that is not redrawn keeps the matrix its map was drawn with; the shaders
+// sample it with that matrix, so the old map is reprojected onto the
+// moved camera for free as long as it still covers the cascade's frustum
+// slice. When it does not, or when the light or the map resolution
+// changed, the cascade is redrawn whatever its interval.
+// Due cascades are taken most overdue first while their estimated
+// triangles fit the budget; cascades with an interval of 1 and forced
+// ones ignore it. A cascade deferred for two intervals is forced.
+class CascadeScheduler {
+  struct Cascade {
+    glm::mat4 matrix;
+    unsigned int age = 0;  // frames since the map was drawn
+    bool valid = false;
+    bool updated = false;
+  };
+
+  std::vector<Cascade> cascades_;
+  std::vector<glm::mat4> matrices_;
+  unsigned int frame_ = 0;
+  unsigned int light_revision_ = 0;
+  unsigned int resolution_ = 0;
+  CascadeSchedulerStats stats_;
+
+  // The slice corners fit the stale map in xy, and its depth range holds
+  // the one fitted for this frame (the casters did not move out of it)
+  static bool Covers(const glm::mat4& stale, const glm::mat4& fitted, const std::vector<glm::vec4>& slice) {
+    const float EPSILON = 1e-4f;
+    for (const glm::vec4& corner : slice) {
+      glm::vec4 clip = stale * corner;
+      if (std::abs(clip.x) > 1.0f + EPSILON || std::abs(clip.y) > 1.0f + EPSILON) return false;
+    }
+    glm::mat4 to_stale = stale * glm::inverse(fitted);
+    for (float z : { -1.0f, 1.0f }) {
+      glm::vec4 clip = to_stale * glm::vec4(0.0f, 0.0f, z, 1.0f);
+      if (std::abs(clip.z) > 1.0f + EPSILON) return false;
+    }
+    return true;
+  }
+
+public:
+  // fitted - this frame's matrix of every cascade; slices - world corners
+  // of its frustum slice; costs - estimated triangles to redraw it;
+  // intervals - frames between redraws, at least one per cascade;
+  // budget - triangles per frame, 0 for no limit
+  void Schedule(const std::vector<glm::mat4>& fitted, const std::vector<std::vector<glm::vec4>>& slices,
+                const std::vector<unsigned long long>& costs, const int* intervals, unsigned long long budget,
+                unsigned int light_revision, unsigned int resolution) {
+    frame_++;
+    stats_ = CascadeSchedulerStats();
+    bool reset = cascades_.size() != fitted.size() || light_revision != light_revision_ || resolution != resolution_;
+    if (reset) cascades_.assign(fitted.size(), Cascade());
+    light_revision_ = light_revision;
+    resolution_ = resolution;
+
+    // Forced and every-frame cascades first, then the due ones by age
+    std::vector<size_t> due;
+    for (size_t i = 0; i < cascades_.size(); ++i) {
+      Cascade& cascade = cascades_[i];
+      unsigned int interval = (unsigned int)std::max(intervals[i], 1);
+      cascade.updated = false;
+      bool forced = !cascade.valid || interval == 1 || cascade.age + 1 >= 2 * interval ||
+                    !Covers(cascade.matrix, fitted[i], slices[i]);
+      if (forced) {
+        cascade.updated = true;
+        stats_.triangles += costs[i];
+      }
+      else if ((frame_ + i) % interval == 0 || cascade.age + 1 >= interval) {
+        due.push_back(i);
+      }
+    }
+    std::stable_sort(due.begin(), due.end(),
+                     [&](size_t a, size_t b) { return cascades_[a].age > cascades_[b].age; });
+    for (size_t i : due) {
+      if (budget && stats_.triangles + costs[i] > budget) {
+        stats_.deferred++;
+        continue;
+      }
+      cascades_[i].updated = true;
+      stats_.triangles += costs[i];
+    }
+
+    matrices_.resize(cascades_.size());
+    for (size_t i = 0; i < cascades_.size(); ++i) {
+      Cascade& cascade = cascades_[i];
+      if (cascade.updated) {
+        cascade.matrix = fitted[i];
+        cascade.age = 0;
+        cascade.valid = true;
+        stats_.updated++;
+      }
+      else {
+        cascade.age++;
+        stats_.stale++;
+      }
+      matrices_[i] = cascade.matrix;
+    }
+  }
+
+  // Matrix each cascade's map was drawn with, what the shaders must use
+  const std::vector<glm::mat4>& matrices() const { return matrices_; }
+  bool updated(size_t cascade) const { return cascades_[cascade].updated; }
+  const CascadeSchedulerStats& stats() const { return stats_; }
+};
+
+#endif
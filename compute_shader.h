@@ -0,0 +1,72 @@
+#ifndef COMPUTE_SHADER_H_
+#define COMPUTE_SHADER_H_
+
+#include <glad/glad.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// COMPUTE SHADER
+//=-----------------------------=
+// Single-stage program for the compute passes, Shader only takes the
+// graphics stages. Uniforms are set with the raw glUniform* calls.
+class ComputeShader {
+public:
+  GLuint ID = 0;
+
+  explicit ComputeShader(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+      std::cout << "ERROR::SHADER::COMPUTE::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+      return;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string code = stream.str();
+    const char* source = code.c_str();
+
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    if (!CheckStatus(shader, GL_COMPILE_STATUS, path)) {
+      glDeleteShader(shader);
+      return;
+    }
+
+    ID = glCreateProgram();
+    glAttachShader(ID, shader);
+    glLinkProgram(ID);
+    glDeleteShader(shader);
+    if (!CheckStatus(ID, GL_LINK_STATUS, path)) {
+      glDeleteProgram(ID);
+      ID = 0;
+    }
+  }
+
+  ~ComputeShader() {
+    if (ID) glDeleteProgram(ID);
+  }
+
+  bool valid() const { return ID != 0; }
+  void use() const { glUseProgram(ID); }
+  GLint location(const char* name) const { return glGetUniformLocation(ID, name); }
+
+private:
+  static bool CheckStatus(GLuint object, GLenum status, const char* path) {
+    GLint success = 0;
+    char log[1024];
+    if (status == GL_COMPILE_STATUS) glGetShaderiv(object, status, &success);
+    else glGetProgramiv(object, status, &success);
+    if (success) return true;
+
+    if (status == GL_COMPILE_STATUS) glGetShaderInfoLog(object, sizeof(log), nullptr, log);
+    else glGetProgramInfoLog(object, sizeof(log), nullptr, log);
+    std::cout << "ERROR::SHADER::COMPUTE::" << (status == GL_COMPILE_STATUS ? "COMPILATION" : "LINKING")
+              << "_FAILED " << path << "\n" << log << std::endl;
+    return false;
+  }
+};
+
+#endif
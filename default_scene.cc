@@ -0,0 +1,81 @@
+#include "default_scene.h"
+
+Model* createPlaneModel(const std::string& textureFile, const std::string& path) {
+  vector<Vertex> vertices = {
+    // Positions          // Normals        // Texture Coords
+    {{-0.5f, 0.0f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}}, // Bottom-left
+    {{0.5f, 0.0f, -0.5f},  {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}}, // Bottom-right
+    {{0.5f, 0.0f, 0.5f},   {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}}, // Top-right
+    {{-0.5f, 0.0f, 0.5f},  {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}  // Top-left
+  };
+
+  vector<unsigned int> indices = {
+      2, 1, 0, // First triangle
+      0, 3, 2 // Second triangle
+  };
+
+  vector<Texture> textures;
+  Texture texture;
+  texture.id = TextureFromFile(textureFile.c_str(), path.c_str()); // Load texture
+  texture.type = "texture_diffuse";
+  texture.path = textureFile;
+  textures.push_back(texture);
+
+  return new Model(Mesh(vertices, indices, textures));
+}
+
+DefaultScene BuildDefaultScene(Scene& scene) {
+  DefaultScene result;
+
+  // Adding camera object
+  Camera* camera = scene.AddCamera(glm::vec3(0.0f, 0.0f, 3.0f));
+  result.camera = camera;
+
+  // Adding ambient light object
+  AmbientLight* ambientLight = scene.AddAmbientLight(glm::vec3(0.3f, 0.3f, 0.3f));
+
+  // Add directional light to scene
+  DirectionalLight* directionLight = scene.AddDirectionalLight(camera, glm::vec3(-0.2f, -0.5f, -0.3f), "Sun");
+
+  // Create point lights and add to scene
+  PointLight* pointLight = scene.AddPointLight(camera, glm::vec3(3.0f, 2.0f, 2.0f));
+  //pointLight->setIntensity(1.0f);
+
+  //PointLight* pointLight1 = scene.AddPointLight(camera, glm::vec3(2.0f, 2.0f, 2.0f));
+
+  //PointLight* pointLight2 = scene.AddPointLight(camera, glm::vec3(1.0f, 2.0f, 2.0f));
+
+  result.flashlight = scene.AddSpotLight("Flashlight");
+
+  // Set path to cube object
+  char path_cube[] = "resources/models/default/CUBE/default_cube.obj";
+
+  // Add first cube to scene
+  Model* default_cube_1 = scene.AddModel(path_cube, "Default_cube1");
+  default_cube_1->setSelection(false);
+  default_cube_1->setPosition(glm::vec3(0.0f, 0.0f, 0.0f));
+  default_cube_1->scale_texture = true;
+
+  // Add second cube to scene
+  Model* default_cube_2 = scene.AddModel(path_cube, "Default_cube2");
+  default_cube_2->setSelection(false);
+  default_cube_2->setPosition(glm::vec3(3.0f, 2.0f, 0.0f));
+  default_cube_2->scale_texture = true;
+
+  // Add plane to scene
+  Model* plane = createPlaneModel("concrete_diffuse.png", "resources/textures/default");
+  scene.AddModel(plane, "Plane");
+  plane->setSelection(false);
+  plane->setPosition(glm::vec3(1.5f, -1.0001f, 0.0f));
+  plane->setSize(glm::vec3(20.0f));
+  plane->scale_texture = true;
+
+  // Add Skybox to scene
+  Skybox* skybox = scene.AddSkybox();
+
+  char path[] = "resources/models/backpack/backpack.obj";
+  Model* backpack = scene.AddModel(path);
+  backpack->setPosition(glm::vec3(-3.0, 1.0, 1.0));
+
+  return result;
+}
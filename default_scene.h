@@ -0,0 +1,22 @@
+#ifndef DEFAULT_SCENE_H_
+#define DEFAULT_SCENE_H_
+
+#include <string>
+
+#include "scene.h"
+
+// DEFAULT SCENE
+//=-----------------------------=
+// The scene the editor starts with, shared with the benchmark so both
+// render the same content.
+struct DefaultScene {
+  Camera* camera = nullptr;
+  SpotLight* flashlight = nullptr;  // follows the camera
+};
+
+Model* createPlaneModel(const std::string& textureFile, const std::string& path);
+
+// Camera, lights, two cubes, a ground plane, the skybox and the backpack
+DefaultScene BuildDefaultScene(Scene& scene);
+
+#endif
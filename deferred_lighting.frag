@@ -0,0 +1,336 @@
+#version 450 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+struct DirLight {
+    vec3 direction;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// std430 light records (see light_buffer.h)
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 diffuse;
+    float linear;
+    vec3 specular;
+    float quadratic;
+
+    float farPlane;
+    int shadowIndex;    // -1 - no shadow map
+    float radius;       // light fades out to zero here
+    float pad;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 direction;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float cutOff;
+
+    float outerCutOff;
+    int shadowIndex;    // -1 - no shadow map
+    float radius;
+    float pad;
+};
+
+// surface read back from the G-buffer
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    vec3 specular;
+    float shininess;
+};
+
+layout (std140, binding = 0) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+// G-buffer (see GBufferSlot)
+layout (binding = 0) uniform sampler2D gAlbedo;
+layout (binding = 1) uniform sampler2D gSpecular;
+layout (binding = 2) uniform sampler2D gNormal;
+layout (binding = 5) uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+
+layout (std430, binding = 6) readonly buffer LightGlobals
+{
+    vec3 ambient;
+    int numPointLights;
+    vec3 dirDirection;
+    int numSpotLights;
+    vec3 dirDiffuse;
+    int cascadeCount;   // number of frusta - 1
+    vec3 dirSpecular;
+    float dirFarPlane;
+    float cascadePlaneDistances[16];
+};
+
+layout (std430, binding = 7) readonly buffer PointLights
+{
+    PointLight pointLights[];
+};
+
+layout (std430, binding = 8) readonly buffer SpotLights
+{
+    SpotLight spotLights[];
+};
+
+// light clusters (see light_clusters.h)
+layout (std430, binding = 9) readonly buffer LightClusters
+{
+    uvec4 clusters[];
+};
+
+layout (std430, binding = 10) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+uniform uvec3 clusterGrid;
+uniform vec2 clusterTileScale;
+uniform vec2 clusterDepthScale;
+
+uniform sampler2DArray DLshadowMap;
+
+// point and spot light shadow maps, tiles of one atlas (see shadow_atlas.h)
+uniform sampler2D shadowAtlas;
+
+struct ShadowTile {
+    mat4 viewProjection;
+    vec4 rect;          // xy - offset, zw - size, in atlas uv
+};
+
+layout (std430, binding = 15) readonly buffer ShadowTiles
+{
+    ShadowTile shadowTiles[];
+};
+
+layout (std140, binding = 1) uniform LightSpaceMatrices
+{
+    mat4 lightSpaceMatrices[16];
+};
+
+vec3 DecodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+float RadiusFalloff(float distance, float radius)
+{
+    float x = distance / radius;
+    float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return window * window;
+}
+
+float DLShadowCalculation(Surface s)
+{
+    // Select cascade layer
+    float depthValue = abs((view * vec4(s.position, 1.0)).z);
+
+    int layer = -1;
+    for (int i = 0; i < cascadeCount; ++i)
+    {
+        if (depthValue < cascadePlaneDistances[i])
+        {
+            layer = i;
+            break;
+        }
+    }
+    if (layer == -1)
+    {
+        layer = cascadeCount;
+    }
+
+    // Apply normal bias: push fragment along normal in light space
+    vec3 lightDir = normalize(-dirDirection);
+    vec3 normalBias = s.normal * 0.01;
+
+    vec4 biasedFragPosLightSpace = lightSpaceMatrices[layer] * vec4(s.position + normalBias, 1.0);
+    vec3 projCoords = biasedFragPosLightSpace.xyz / biasedFragPosLightSpace.w;
+    projCoords = projCoords * 0.5 + 0.5;
+
+    if (projCoords.z > 1.0)
+    {
+        return 0.0;
+    }
+
+    // Compute depth bias based on angle and cascade level
+    float angle = max(dot(s.normal, lightDir), 0.0);
+    float bias = max(0.005 * (1.0 - angle), 0.0005);
+    const float biasModifier = 0.05;
+    if (layer == cascadeCount)
+    {
+        bias *= 1 / (dirFarPlane * biasModifier);
+    }
+    else
+    {
+        bias *= 1 / (cascadePlaneDistances[layer] * biasModifier);
+    }
+
+    // PCF
+    float shadow = 0.0;
+    vec2 texelSize = 1.0 / vec2(textureSize(DLshadowMap, 0));
+    for (int x = -1; x <= 1; ++x)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            float pcfDepth = texture(DLshadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, layer)).r;
+            shadow += (projCoords.z - bias) > pcfDepth ? 1.0 : 0.0;
+        }
+    }
+    return shadow / 9.0;
+}
+
+// shadow of a light face stored in one tile of the atlas
+float AtlasShadowCalculation(int tileIndex, vec3 fragPos, vec3 normal, float distance)
+{
+    ShadowTile tile = shadowTiles[tileIndex];
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowAtlas, 0));
+
+    // Normal bias of about a texel and a half of this tile at this distance
+    float tileTexels = tile.rect.z / texelSize.x;
+    vec4 fragPosLightSpace = tile.viewProjection * vec4(fragPos + normal * (3.0 * distance / tileTexels), 1.0);
+    if (fragPosLightSpace.w <= 0.0)
+        return 0.0;
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w * 0.5 + 0.5;
+    if (projCoords.z > 1.0)
+        return 0.0;
+
+    // PCF, taps are clamped inside the tile so they never read a neighbour
+    vec2 uv = tile.rect.xy + clamp(projCoords.xy, 0.0, 1.0) * tile.rect.zw;
+    vec2 uvMin = tile.rect.xy + 0.5 * texelSize;
+    vec2 uvMax = tile.rect.xy + tile.rect.zw - 0.5 * texelSize;
+    const float bias = 0.0001;
+    float shadow = 0.0;
+    for (int x = -1; x <= 1; ++x)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            float pcfDepth = texture(shadowAtlas, clamp(uv + vec2(x, y) * texelSize, uvMin, uvMax)).r;
+            shadow += (projCoords.z - bias) > pcfDepth ? 1.0 : 0.0;
+        }
+    }
+    return shadow / 9.0;
+}
+
+float PLShadowCalculation(vec3 fragPos, vec3 normal, PointLight light)
+{
+    if (light.shadowIndex < 0)
+        return 0.0;
+
+    // Cube face the fragment falls into, tiles follow the +X -X +Y -Y +Z -Z
+    // order of PointShadowMatrices
+    vec3 fragToLight = fragPos - light.position;
+    vec3 absFragToLight = abs(fragToLight);
+    int faceIndex;
+    if (absFragToLight.x >= absFragToLight.y && absFragToLight.x >= absFragToLight.z)
+        faceIndex = fragToLight.x > 0.0 ? 0 : 1;
+    else if (absFragToLight.y >= absFragToLight.z)
+        faceIndex = fragToLight.y > 0.0 ? 2 : 3;
+    else
+        faceIndex = fragToLight.z > 0.0 ? 4 : 5;
+
+    return AtlasShadowCalculation(light.shadowIndex + faceIndex, fragPos, normal, length(fragToLight));
+}
+
+float SLShadowCalculation(vec3 fragPos, vec3 normal, SpotLight light)
+{
+    if (light.shadowIndex < 0)
+        return 0.0;
+    return AtlasShadowCalculation(light.shadowIndex, fragPos, normal, length(fragPos - light.position));
+}
+
+vec3 Shade(Surface s, vec3 lightDir, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
+{
+    float diff = max(dot(s.normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(s.normal, halfwayDir), 0.0), s.shininess);
+    return diffuseColor * diff * s.albedo + specularColor * spec * s.specular;
+}
+
+vec3 CalcDirLight(Surface s, vec3 viewDir)
+{
+    float shadow = DLShadowCalculation(s);
+    return (1.0 - shadow) * Shade(s, normalize(-dirDirection), viewDir, dirDiffuse, dirSpecular);
+}
+
+vec3 CalcPointLight(PointLight light, Surface s, vec3 viewDir)
+{
+    float distance = length(light.position - s.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    attenuation *= RadiusFalloff(distance, light.radius);
+    float shadow = PLShadowCalculation(s.position, s.normal, light);
+    vec3 lightDir = normalize(light.position - s.position);
+    return (1.0 - shadow) * attenuation * Shade(s, lightDir, viewDir, light.diffuse, light.specular);
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface s, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - s.position);
+    float distance = length(light.position - s.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    attenuation *= RadiusFalloff(distance, light.radius);
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    float shadow = SLShadowCalculation(s.position, s.normal, light);
+    return (1.0 - shadow) * attenuation * intensity * Shade(s, lightDir, viewDir, light.diffuse, light.specular);
+}
+
+void main()
+{
+    float depth = texelFetch(gDepth, ivec2(gl_FragCoord.xy), 0).r;
+    // background, left to the clear color and the skybox
+    if (depth == 1.0)
+        discard;
+
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 specular = texelFetch(gSpecular, texel, 0);
+    vec4 clipPos = inverseViewProjection * vec4(TexCoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+
+    Surface s;
+    s.position = clipPos.xyz / clipPos.w;
+    s.normal = DecodeNormal(texelFetch(gNormal, texel, 0).rg);
+    s.albedo = texelFetch(gAlbedo, texel, 0).rgb;
+    s.specular = specular.rgb;
+    s.shininess = exp2(specular.a * 11.0);
+
+    vec3 viewDir = normalize(viewPos - s.position);
+
+    // phase 1: directional lighting
+    vec3 result = CalcDirLight(s, viewDir);
+
+    // only the lights binned into this pixel's cluster
+    float viewDepth = -(view * vec4(s.position, 1.0)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterTileScale), clusterGrid.xy - 1u);
+    uint slice = uint(clamp(log(viewDepth) * clusterDepthScale.x - clusterDepthScale.y, 0.0, float(clusterGrid.z - 1u)));
+    uvec4 cluster = clusters[(slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+
+    // phase 2: point lights
+    for (uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(pointLights[lightIndices[cluster.x + i]], s, viewDir);
+
+    // phase 3: spot lights
+    for (uint i = 0u; i < cluster.z; i++)
+        result += CalcSpotLight(spotLights[lightIndices[cluster.x + cluster.y + i]], s, viewDir);
+
+    result += ambient * s.albedo;
+
+    FragColor = vec4(result, 1.0);
+}
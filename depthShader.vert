@@ -1,9 +1,25 @@
-#version 460 core
+#version 450 core
 layout (location = 0) in vec3 aPos;
-    
-uniform mat4 model;
+layout (location = 3) in uint aDrawIndex;
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 scale;
+    uvec4 flags;
+};
+
+layout (std430, binding = 3) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+layout (std430, binding = 5) readonly buffer Draws
+{
+    uvec2 draws[];  // x - object, y - material
+};
     
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    gl_Position = objects[draws[aDrawIndex].x].model * vec4(aPos, 1.0);
+}
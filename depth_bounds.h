@@ -0,0 +1,112 @@
+#ifndef DEPTH_BOUNDS_H_
+#define DEPTH_BOUNDS_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+#include "compute_shader.h"
+
+// Binding point of the result buffer in depth_bounds.comp
+const unsigned int DEPTH_BOUNDS_BINDING = 16;
+
+// DEPTH BOUNDS
+//=-----------------------------=
+// Nearest and farthest view distance the camera saw, for fitting the sun
+// cascades to the visible geometry (sample distribution shadow maps).
+// depth_bounds.comp reduces the depth buffer into one of FRAMES small
+// buffers; Update reads back the newest one whose fence has passed, so the
+// result is a frame or two old and the CPU never waits on the GPU.
+class DepthBounds {
+public:
+  static const int FRAMES = 3;
+
+private:
+  struct Slot {
+    GLuint buffer = 0;
+    GLsync fence = nullptr;
+    glm::mat4 inverse_projection = glm::mat4(1.0f);
+  };
+
+  Slot slots_[FRAMES];
+  int next_ = 0;  // slot of the next reduction, also the oldest pending one
+  bool valid_ = false;
+  float near_ = 0.0f, far_ = 0.0f;
+
+public:
+  ~DepthBounds() {
+    Reset();
+    for (Slot& slot : slots_)
+      if (slot.buffer) glDeleteBuffers(1, &slot.buffer);
+  }
+
+  // After the main pass, width and height - the covered part of depth_texture
+  void Reduce(const ComputeShader& shader, GLuint depth_texture, int width, int height,
+              const glm::mat4& projection) {
+    Slot& slot = slots_[next_];
+    next_ = (next_ + 1) % FRAMES;
+    if (slot.fence) glDeleteSync(slot.fence);  // never read back, superseded
+    if (!slot.buffer) {
+      glCreateBuffers(1, &slot.buffer);
+      glNamedBufferData(slot.buffer, 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+    }
+    const GLuint reset[2] = { 0xFFFFFFFFu, 0u };
+    glNamedBufferSubData(slot.buffer, 0, sizeof(reset), reset);
+    slot.inverse_projection = glm::inverse(projection);
+
+    shader.use();
+    glUniform1i(shader.location("source"), 0);
+    glUniform2i(shader.location("sourceSize"), width, height);
+    glBindTextureUnit(0, depth_texture);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEPTH_BOUNDS_BINDING, slot.buffer);
+    glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindTextureUnit(0, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  // Takes the newest finished reduction, once per frame before the result
+  // is used. A frame without geometry invalidates the result.
+  void Update() {
+    for (int i = 0; i < FRAMES; i++) {
+      Slot& slot = slots_[(next_ + i) % FRAMES];  // oldest first, newest wins
+      if (!slot.fence) continue;
+      GLenum state = glClientWaitSync(slot.fence, 0, 0);
+      if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED) continue;
+      glDeleteSync(slot.fence);
+      slot.fence = nullptr;
+
+      GLuint bounds[2];
+      glGetNamedBufferSubData(slot.buffer, 0, sizeof(bounds), bounds);
+      valid_ = bounds[0] <= bounds[1];
+      if (!valid_) continue;
+      float depth[2];
+      std::memcpy(depth, bounds, sizeof(depth));
+      near_ = Distance(slot.inverse_projection, depth[0]);
+      far_ = Distance(slot.inverse_projection, depth[1]);
+    }
+  }
+
+  // Forgets the result and the reductions in flight
+  void Reset() {
+    for (Slot& slot : slots_) {
+      if (slot.fence) glDeleteSync(slot.fence);
+      slot.fence = nullptr;
+    }
+    valid_ = false;
+  }
+
+  bool valid() const { return valid_; }
+  float near_distance() const { return near_; }
+  float far_distance() const { return far_; }
+
+private:
+  // View distance of a depth buffer value
+  static float Distance(const glm::mat4& inverse_projection, float depth) {
+    glm::vec4 view = inverse_projection * glm::vec4(0.0f, 0.0f, depth * 2.0f - 1.0f, 1.0f);
+    return -view.z / view.w;
+  }
+};
+
+#endif
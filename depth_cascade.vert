@@ -0,0 +1,37 @@
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : require
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uint aDrawIndex;
+
+// Single cascade variant of depth_layered.vert for the GPU-culled draws,
+// replaces depthShader.vert + DLightDepthCascade.geom
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 scale;
+    uvec4 flags;
+};
+
+layout (std430, binding = 3) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+layout (std430, binding = 5) readonly buffer Draws
+{
+    uvec2 draws[];  // x - object, y - material
+};
+
+layout (std140, binding = 1) uniform LightSpaceMatrices
+{
+    mat4 lightSpaceMatrices[5];
+};
+
+uniform int cascadeIndex;
+
+void main()
+{
+    gl_Position = lightSpaceMatrices[cascadeIndex] * objects[draws[aDrawIndex].x].model * vec4(aPos, 1.0);
+    gl_Layer = cascadeIndex;
+}
@@ -0,0 +1,42 @@
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : require
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uint aDrawIndex;  // entry in LayerDraws, not a draw record
+
+// Every cascade a draw touches is one instance, the layer is picked here
+// instead of amplifying each triangle in DLightDepthShader.geom (see
+// layered_shadows.h)
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 scale;
+    uvec4 flags;
+};
+
+layout (std430, binding = 3) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+layout (std430, binding = 5) readonly buffer Draws
+{
+    uvec2 draws[];  // x - object, y - material
+};
+
+layout (std430, binding = 17) readonly buffer LayerDraws
+{
+    uvec2 layerDraws[];  // x - draw record, y - cascade
+};
+
+layout (std140, binding = 1) uniform LightSpaceMatrices
+{
+    mat4 lightSpaceMatrices[5];
+};
+
+void main()
+{
+    uvec2 entry = layerDraws[aDrawIndex];
+    gl_Position = lightSpaceMatrices[entry.y] * objects[draws[entry.x].x].model * vec4(aPos, 1.0);
+    gl_Layer = int(entry.y);
+}
@@ -0,0 +1,6 @@
+#version 450 core
+
+// depth only, no color output
+void main()
+{
+}
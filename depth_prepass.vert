@@ -0,0 +1,38 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uint aDrawIndex;
+
+// must match shader.vert, the color pass tests depth with GL_EQUAL
+invariant gl_Position;
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 scale;
+    uvec4 flags;
+};
+
+layout (std430, binding = 3) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+layout (std430, binding = 5) readonly buffer Draws
+{
+    uvec2 draws[];  // x - object, y - material
+};
+
+uniform float outlineScale = 1.0;
+
+void main()
+{
+    // same expressions as shader.vert, so both produce bit-identical depth
+    vec3 fragPos = vec3(objects[draws[aDrawIndex].x].model * vec4(aPos * outlineScale, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
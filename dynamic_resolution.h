@@ -0,0 +1,68 @@
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+#include <algorithm>
+#include <cmath>
+
+#include "gpu_timer.h"
+
+// Filter of the quad pass when the frame buffer is smaller than the window
+enum UpscaleFilter {
+  UPSCALE_BILINEAR = 0,
+  UPSCALE_SHARPEN = 1   // bilinear plus a contrast-limited unsharp mask, see quad.frag
+};
+
+// DYNAMIC RESOLUTION
+//=-----------------------------=
+// Picks the render scale of the frame buffer (per axis, so pixel cost goes
+// with its square) from the GPU frame time. Inside a dead band of
+// +-headroom around the target nothing changes; outside it the time has to
+// stay over or under for settle_frames in a row before the scale moves,
+// and after a move the controller waits for the GPU timer latency so it
+// never reacts to a frame rendered at the old scale. Steps are sized from
+// the measured ratio but limited to max_step.
+class DynamicResolution {
+  float scale_ = 1.0f;
+  int over_ = 0, under_ = 0;
+  int cooldown_ = 0;
+
+public:
+  float target_ms = 16.0f;
+  float min_scale = 0.5f;
+  float max_scale = 1.0f;
+  float headroom = 0.1f;      // dead band, fraction of target_ms
+  float max_step = 0.1f;      // largest change of the scale per decision
+  int settle_frames = 10;
+
+  float scale() const { return scale_; }
+
+  void Reset(float scale) {
+    scale_ = std::clamp(scale, min_scale, max_scale);
+    over_ = under_ = 0;
+    cooldown_ = GpuTimer::FRAMES;
+  }
+
+  // gpu_ms of the latest timed frame, 0 while there is none. Returns the
+  // scale for the next frame.
+  float Update(float gpu_ms) {
+    if (gpu_ms <= 0.0f) return scale_;
+    if (cooldown_ > 0) {
+      cooldown_--;
+      return scale_;
+    }
+
+    over_ = gpu_ms > target_ms * (1.0f + headroom) ? over_ + 1 : 0;
+    under_ = gpu_ms < target_ms * (1.0f - headroom) ? under_ + 1 : 0;
+    if (over_ < settle_frames && under_ < settle_frames) return scale_;
+
+    // Cost is roughly proportional to the pixel count
+    float wanted = scale_ * std::sqrt(target_ms / gpu_ms);
+    wanted = std::clamp(wanted, scale_ - max_step, scale_ + max_step);
+    wanted = std::clamp(wanted, min_scale, max_scale);
+    if (std::abs(wanted - scale_) > 0.005f) Reset(wanted);
+    over_ = under_ = 0;
+    return scale_;
+  }
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "frame_graph.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+// Framebuffers unused for this many frames are deleted. It must stay below
+// RenderTargetPool::KEEP_FRAMES, a texture name is only reused after the
+// pool deleted it, and by then no cached framebuffer refers to it.
+static const unsigned int FRAMEBUFFER_KEEP_FRAMES = 2;
+
+static std::string FormatName(GLenum format) {
+  switch (format) {
+  case GL_RGB8: return "RGB8";
+  case GL_RGBA8: return "RGBA8";
+  case GL_SRGB8_ALPHA8: return "SRGB8_ALPHA8";
+  case GL_RG16: return "RG16";
+  case GL_R32F: return "R32F";
+  case GL_RGBA16F: return "RGBA16F";
+  case GL_DEPTH24_STENCIL8: return "DEPTH24_STENCIL8";
+  case GL_DEPTH32F_STENCIL8: return "DEPTH32F_STENCIL8";
+  case GL_DEPTH_COMPONENT16: return "DEPTH16";
+  case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+  default: {
+    char hex[16];
+    std::snprintf(hex, sizeof(hex), "0x%04X", format);
+    return hex;
+  }
+  }
+}
+
+static bool HasStencil(GLenum format) {
+  return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+FrameGraph::~FrameGraph() {
+  for (const auto& entry : framebuffers_) glDeleteFramebuffers(1, &entry.second.fbo);
+}
+
+void FrameGraph::Reset() {
+  frame_++;
+  resources_.clear();
+  passes_.clear();
+
+  for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+    if (frame_ - it->second.last_frame < FRAMEBUFFER_KEEP_FRAMES) {
+      ++it;
+      continue;
+    }
+    glDeleteFramebuffers(1, &it->second.fbo);
+    it = framebuffers_.erase(it);
+  }
+}
+
+FrameGraphResource FrameGraph::Create(const std::string& name, const RenderTargetDesc& desc) {
+  Resource resource;
+  resource.name = name;
+  resource.desc = desc;
+  resources_.push_back(resource);
+  return (FrameGraphResource)resources_.size() - 1;
+}
+
+FrameGraphResource FrameGraph::Import(const std::string& name, GLuint texture) {
+  Resource resource;
+  resource.name = name;
+  resource.imported = true;
+  resource.texture = texture;
+  resources_.push_back(resource);
+  return (FrameGraphResource)resources_.size() - 1;
+}
+
+void FrameGraph::AddPass(const std::string& name, std::initializer_list<FrameGraphResource> reads,
+                         std::initializer_list<FrameGraphResource> writes, std::function<void()> execute,
+                         bool side_effect) {
+  Pass pass;
+  pass.name = name;
+  for (FrameGraphResource resource : reads)
+    if (resource >= 0) pass.reads.push_back(resource);
+  for (FrameGraphResource resource : writes)
+    if (resource >= 0) pass.writes.push_back(resource);
+  pass.execute = std::move(execute);
+  pass.side_effect = side_effect;
+  passes_.push_back(std::move(pass));
+}
+
+void FrameGraph::Compile() {
+  // Culling, backwards: a pass lives when it has a side effect or writes
+  // something a live pass after it reads
+  std::vector<bool> needed(resources_.size(), false);
+  for (int i = (int)passes_.size() - 1; i >= 0; i--) {
+    Pass& pass = passes_[i];
+    pass.live = pass.side_effect;
+    for (FrameGraphResource resource : pass.writes) pass.live = pass.live || needed[resource];
+    if (!pass.live) continue;
+    for (FrameGraphResource resource : pass.reads) needed[resource] = true;
+  }
+
+  // Lifetimes of the transients over the live passes
+  for (int i = 0; i < (int)passes_.size(); i++) {
+    const Pass& pass = passes_[i];
+    if (!pass.live) continue;
+    for (FrameGraphResource resource : pass.writes) {
+      Resource& r = resources_[resource];
+      if (r.first < 0) r.first = i;
+      r.last = i;
+    }
+    for (FrameGraphResource resource : pass.reads) {
+      Resource& r = resources_[resource];
+      if (r.first < 0 && !r.imported)
+        std::cout << "FRAME GRAPH:: " << pass.name << " reads " << r.name << " before it is written" << std::endl;
+      if (r.first < 0) r.first = i;
+      r.last = i;
+    }
+  }
+}
+
+void FrameGraph::Execute() {
+  stats_ = FrameGraphStats();
+  stats_.passes = (unsigned int)passes_.size();
+  std::set<GLuint> textures;
+
+  for (int i = 0; i < (int)passes_.size(); i++) {
+    Pass& pass = passes_[i];
+    if (!pass.live) {
+      stats_.culled++;
+      continue;
+    }
+    for (Resource& resource : resources_) {
+      if (resource.imported || resource.first != i) continue;
+      resource.texture = pool_.Acquire(resource.desc);
+      stats_.transients++;
+      if (textures.insert(resource.texture).second) {
+        stats_.textures++;
+        stats_.bytes += RenderTargetPool::Bytes(resource.desc);
+      }
+    }
+
+    pass.execute();
+
+    // Released textures are free for the transients of the next passes
+    for (const Resource& resource : resources_) {
+      if (!resource.imported && resource.last == i) pool_.Release(resource.texture);
+    }
+  }
+}
+
+GLuint FrameGraph::Framebuffer(std::initializer_list<FrameGraphResource> colors, FrameGraphResource depth) {
+  std::vector<GLuint> key;
+  for (FrameGraphResource color : colors) key.push_back(texture(color));
+  key.push_back(depth >= 0 ? texture(depth) : 0);
+
+  auto it = framebuffers_.find(key);
+  if (it != framebuffers_.end()) {
+    it->second.last_frame = frame_;
+    return it->second.fbo;
+  }
+
+  GLuint fbo = 0;
+  glCreateFramebuffers(1, &fbo);
+  GLenum attachments[8];
+  GLsizei count = 0;
+  for (FrameGraphResource color : colors) {
+    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0 + count, texture(color), 0);
+    attachments[count] = GL_COLOR_ATTACHMENT0 + count;
+    count++;
+  }
+  if (count) glNamedFramebufferDrawBuffers(fbo, count, attachments);
+  else glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+  if (depth >= 0) {
+    GLenum attachment = HasStencil(resources_[depth].desc.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    glNamedFramebufferTexture(fbo, attachment, texture(depth), 0);
+  }
+  if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "ERROR::FRAMEBUFFER:: Frame graph framebuffer is not complete!" << std::endl;
+
+  framebuffers_[key] = { fbo, frame_ };
+  return fbo;
+}
+
+std::string FrameGraph::Dump() const {
+  std::ostringstream out;
+  out << "digraph FrameGraph {\n  rankdir=LR;\n  node [fontname=\"Helvetica\", fontsize=10];\n";
+  for (size_t i = 0; i < passes_.size(); i++) {
+    const Pass& pass = passes_[i];
+    out << "  pass" << i << " [shape=box, label=\"" << i << ": " << pass.name << "\"";
+    if (!pass.live) out << ", style=dashed, color=gray, fontcolor=gray";
+    else if (pass.side_effect) out << ", style=bold";
+    out << "];\n";
+  }
+  for (size_t i = 0; i < resources_.size(); i++) {
+    const Resource& resource = resources_[i];
+    out << "  resource" << i << " [shape=ellipse, label=\"" << resource.name;
+    if (resource.imported) out << "\\nimported";
+    else {
+      out << "\\n" << resource.desc.width << "x" << resource.desc.height << " " << FormatName(resource.desc.format);
+      if (resource.first >= 0) out << "\\npasses " << resource.first << "-" << resource.last;
+      else out << "\\nunused";
+    }
+    if (resource.texture) out << "\\ntexture " << resource.texture;
+    out << "\"";
+    if (resource.imported) out << ", style=filled, fillcolor=lightgray";
+    out << "];\n";
+  }
+  for (size_t i = 0; i < passes_.size(); i++) {
+    for (FrameGraphResource resource : passes_[i].reads) out << "  resource" << resource << " -> pass" << i << ";\n";
+    for (FrameGraphResource resource : passes_[i].writes) out << "  pass" << i << " -> resource" << resource << ";\n";
+  }
+  out << "  label=\"" << stats_.passes - stats_.culled << "/" << stats_.passes << " passes, " << stats_.transients
+      << " transients in " << stats_.textures << " textures (" << stats_.bytes / (1024 * 1024) << " MB)\";\n}\n";
+  return out.str();
+}
+
+bool FrameGraph::DumpToFile(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file) return false;
+  file << Dump();
+  return (bool)file;
+}
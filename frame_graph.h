@@ -0,0 +1,102 @@
+#ifndef FRAME_GRAPH_H_
+#define FRAME_GRAPH_H_
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "render_target_pool.h"
+
+// Index of a resource in the frame graph, -1 for none
+typedef int FrameGraphResource;
+
+struct FrameGraphStats {
+  unsigned int passes = 0;
+  unsigned int culled = 0;        // declared but not executed
+  unsigned int transients = 0;    // transient resources used by live passes
+  unsigned int textures = 0;      // distinct textures behind them
+  size_t bytes = 0;               // estimated memory of those textures
+};
+
+// FRAME GRAPH
+//=-----------------------------=
+// The frame as a list of passes that declare the resources they read and
+// write. Declared every frame, then:
+//   Compile - walks the passes backwards from the ones with side effects
+//             (the backbuffer, state kept for the next frame) and culls
+//             every pass whose writes nobody reads; the lifetime of each
+//             transient is the span of live passes that touch it
+//   Execute - runs the live passes in declaration order; a transient's
+//             texture is taken from the RenderTargetPool right before its
+//             first pass and handed back right after its last one, so a
+//             later transient with the same descriptor reuses the texture
+//             (aliasing) instead of adding memory
+// Imported resources (shadow maps, the backbuffer) live outside the graph
+// and are only tracked for culling and the dump.
+class FrameGraph {
+  struct Resource {
+    std::string name;
+    RenderTargetDesc desc;
+    bool imported = false;
+    GLuint texture = 0;
+    int first = -1, last = -1;  // live passes using it
+  };
+  struct Pass {
+    std::string name;
+    std::vector<FrameGraphResource> reads, writes;
+    std::function<void()> execute;
+    bool side_effect = false;
+    bool live = false;
+  };
+  struct CachedFramebuffer {
+    GLuint fbo;
+    unsigned int last_frame;
+  };
+
+  RenderTargetPool& pool_;
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  // Keyed by the attached textures, color attachments then depth
+  std::map<std::vector<GLuint>, CachedFramebuffer> framebuffers_;
+  unsigned int frame_ = 0;
+  FrameGraphStats stats_;
+
+public:
+  explicit FrameGraph(RenderTargetPool& pool) : pool_(pool) {}
+  FrameGraph(const FrameGraph&) = delete;
+  FrameGraph& operator=(const FrameGraph&) = delete;
+  ~FrameGraph();
+
+  // Starts the declaration of a new frame
+  void Reset();
+
+  FrameGraphResource Create(const std::string& name, const RenderTargetDesc& desc);
+  FrameGraphResource Import(const std::string& name, GLuint texture);
+
+  // side_effect passes are never culled
+  void AddPass(const std::string& name, std::initializer_list<FrameGraphResource> reads,
+               std::initializer_list<FrameGraphResource> writes, std::function<void()> execute,
+               bool side_effect = false);
+
+  void Compile();
+  void Execute();
+
+  // Texture of a resource, valid inside the passes that declared it
+  GLuint texture(FrameGraphResource resource) const { return resources_[resource].texture; }
+
+  // Framebuffer with these attachments, made once and reused while the
+  // textures stay the same. No colors means depth only.
+  GLuint Framebuffer(std::initializer_list<FrameGraphResource> colors, FrameGraphResource depth = -1);
+
+  const FrameGraphStats& stats() const { return stats_; }
+
+  // Graphviz description of the last executed frame, culled passes dashed
+  std::string Dump() const;
+  bool DumpToFile(const std::string& path) const;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "frame_stats.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace frame_stats {
+
+FrameCounters counters;
+
+static void CountDraw(GLenum mode, GLsizei count, GLsizei instances) {
+  counters.draw_calls++;
+  if (instances > 1) counters.instanced_draws++;
+  if (count <= 0 || instances <= 0) return;
+  unsigned long long primitives = 0;
+  if (mode == GL_TRIANGLES) primitives = count / 3;
+  else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && count > 2) primitives = count - 2;
+  counters.triangles += primitives * instances;
+  counters.vertices += (unsigned long long)count * instances;
+}
+
+// GL HOOKS
+//=-----------------------------=
+// glad calls through function pointers, so every call site is counted by
+// swapping the pointers for wrappers that forward to the driver.
+#define FRAME_STATS_HOOK(name) static decltype(glad_##name) real_##name = nullptr
+
+FRAME_STATS_HOOK(glDrawArrays);
+FRAME_STATS_HOOK(glDrawElements);
+FRAME_STATS_HOOK(glDrawArraysInstanced);
+FRAME_STATS_HOOK(glDrawElementsInstanced);
+FRAME_STATS_HOOK(glDrawElementsBaseVertex);
+FRAME_STATS_HOOK(glDrawElementsInstancedBaseInstance);
+FRAME_STATS_HOOK(glDrawElementsInstancedBaseVertexBaseInstance);
+FRAME_STATS_HOOK(glMultiDrawElementsIndirect);
+FRAME_STATS_HOOK(glMultiDrawElementsIndirectCount);
+FRAME_STATS_HOOK(glUseProgram);
+FRAME_STATS_HOOK(glBindTexture);
+FRAME_STATS_HOOK(glBindTextureUnit);
+FRAME_STATS_HOOK(glBindTextures);
+FRAME_STATS_HOOK(glBufferData);
+FRAME_STATS_HOOK(glBufferSubData);
+FRAME_STATS_HOOK(glNamedBufferData);
+FRAME_STATS_HOOK(glNamedBufferSubData);
+
+static void APIENTRY DrawArrays(GLenum mode, GLint first, GLsizei count) {
+  CountDraw(mode, count, 1);
+  real_glDrawArrays(mode, first, count);
+}
+
+static void APIENTRY DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+  CountDraw(mode, count, 1);
+  real_glDrawElements(mode, count, type, indices);
+}
+
+static void APIENTRY DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+  CountDraw(mode, count, instances);
+  real_glDrawArraysInstanced(mode, first, count, instances);
+}
+
+static void APIENTRY DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                           GLsizei instances) {
+  CountDraw(mode, count, instances);
+  real_glDrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+static void APIENTRY DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                            GLint base_vertex) {
+  CountDraw(mode, count, 1);
+  real_glDrawElementsBaseVertex(mode, count, type, indices, base_vertex);
+}
+
+static void APIENTRY DrawElementsInstancedBaseInstance(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                                       GLsizei instances, GLuint base_instance) {
+  CountDraw(mode, count, instances);
+  real_glDrawElementsInstancedBaseInstance(mode, count, type, indices, instances, base_instance);
+}
+
+static void APIENTRY DrawElementsInstancedBaseVertexBaseInstance(GLenum mode, GLsizei count, GLenum type,
+                                                                 const void* indices, GLsizei instances,
+                                                                 GLint base_vertex, GLuint base_instance) {
+  CountDraw(mode, count, instances);
+  real_glDrawElementsInstancedBaseVertexBaseInstance(mode, count, type, indices, instances, base_vertex, base_instance);
+}
+
+// Commands live on the GPU, only their number is known here
+static void APIENTRY MultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei draw_count,
+                                               GLsizei stride) {
+  counters.draw_calls++;
+  counters.indirect_draws += draw_count;
+  real_glMultiDrawElementsIndirect(mode, type, indirect, draw_count, stride);
+}
+
+static void APIENTRY MultiDrawElementsIndirectCount(GLenum mode, GLenum type, const void* indirect,
+                                                    GLintptr draw_count, GLsizei max_draw_count, GLsizei stride) {
+  counters.draw_calls++;
+  counters.indirect_draws += max_draw_count;
+  real_glMultiDrawElementsIndirectCount(mode, type, indirect, draw_count, max_draw_count, stride);
+}
+
+static void APIENTRY UseProgram(GLuint program) {
+  counters.program_binds++;
+  real_glUseProgram(program);
+}
+
+static void APIENTRY BindTexture(GLenum target, GLuint texture) {
+  counters.texture_binds++;
+  real_glBindTexture(target, texture);
+}
+
+static void APIENTRY BindTextureUnit(GLuint unit, GLuint texture) {
+  counters.texture_binds++;
+  real_glBindTextureUnit(unit, texture);
+}
+
+static void APIENTRY BindTextures(GLuint first, GLsizei count, const GLuint* textures) {
+  counters.texture_binds += count;
+  real_glBindTextures(first, count, textures);
+}
+
+static void APIENTRY BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+  if (data) counters.upload_bytes += size;
+  real_glBufferData(target, size, data, usage);
+}
+
+static void APIENTRY BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+  counters.upload_bytes += size;
+  real_glBufferSubData(target, offset, size, data);
+}
+
+static void APIENTRY NamedBufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage) {
+  if (data) counters.upload_bytes += size;
+  real_glNamedBufferData(buffer, size, data, usage);
+}
+
+static void APIENTRY NamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+  counters.upload_bytes += size;
+  real_glNamedBufferSubData(buffer, offset, size, data);
+}
+
+void InstallGLHooks() {
+  // Entry points the context does not have stay null
+#define FRAME_STATS_INSTALL(name, hook) \
+  if (glad_##name && !real_##name) { real_##name = glad_##name; glad_##name = hook; }
+
+  FRAME_STATS_INSTALL(glDrawArrays, DrawArrays);
+  FRAME_STATS_INSTALL(glDrawElements, DrawElements);
+  FRAME_STATS_INSTALL(glDrawArraysInstanced, DrawArraysInstanced);
+  FRAME_STATS_INSTALL(glDrawElementsInstanced, DrawElementsInstanced);
+  FRAME_STATS_INSTALL(glDrawElementsBaseVertex, DrawElementsBaseVertex);
+  FRAME_STATS_INSTALL(glDrawElementsInstancedBaseInstance, DrawElementsInstancedBaseInstance);
+  FRAME_STATS_INSTALL(glDrawElementsInstancedBaseVertexBaseInstance, DrawElementsInstancedBaseVertexBaseInstance);
+  FRAME_STATS_INSTALL(glMultiDrawElementsIndirect, MultiDrawElementsIndirect);
+  FRAME_STATS_INSTALL(glMultiDrawElementsIndirectCount, MultiDrawElementsIndirectCount);
+  FRAME_STATS_INSTALL(glUseProgram, UseProgram);
+  FRAME_STATS_INSTALL(glBindTexture, BindTexture);
+  FRAME_STATS_INSTALL(glBindTextureUnit, BindTextureUnit);
+  FRAME_STATS_INSTALL(glBindTextures, BindTextures);
+  FRAME_STATS_INSTALL(glBufferData, BufferData);
+  FRAME_STATS_INSTALL(glBufferSubData, BufferSubData);
+  FRAME_STATS_INSTALL(glNamedBufferData, NamedBufferData);
+  FRAME_STATS_INSTALL(glNamedBufferSubData, NamedBufferSubData);
+
+#undef FRAME_STATS_INSTALL
+}
+
+FrameCounters EndFrame() {
+  FrameCounters frame = counters;
+  counters = FrameCounters();
+  return frame;
+}
+
+}  // namespace frame_stats
+
+// FRAME TIME HISTORY
+//=-----------------------------=
+void FrameTimeHistory::Add(float ms) {
+  if ((int)samples_.size() < CAPACITY) {
+    samples_.push_back(ms);
+    return;
+  }
+  samples_[next_] = ms;
+  next_ = (next_ + 1) % CAPACITY;
+}
+
+float FrameTimeHistory::Percentile(float p) const {
+  if (samples_.empty()) return 0.0f;
+  std::vector<float> sorted = samples_;
+  size_t rank = (size_t)std::ceil(std::clamp(p, 0.0f, 100.0f) / 100.0f * sorted.size());
+  rank = std::clamp<size_t>(rank, 1, sorted.size()) - 1;
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  return sorted[rank];
+}
+
+std::vector<float> FrameTimeHistory::Ordered() const {
+  std::vector<float> ordered(samples_.begin() + next_, samples_.end());
+  ordered.insert(ordered.end(), samples_.begin(), samples_.begin() + next_);
+  return ordered;
+}
+
+std::vector<float> FrameTimeHistory::Histogram() const {
+  std::vector<float> buckets(BUCKETS, 0.0f);
+  for (float ms : samples_) buckets[std::min((int)(ms / BUCKET_MS), BUCKETS - 1)] += 1.0f;
+  return buckets;
+}
+
+// FRAME STATS LOGGER
+//=-----------------------------=
+bool FrameStatsLogger::Open(const std::string& path) {
+  Close();
+  file_ = std::fopen(path.c_str(), "w");
+  if (!file_) return false;
+  size_t dot = path.rfind('.');
+  std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+  json_ = extension == ".json" || extension == ".jsonl";
+  frame_ = 0;
+  if (!json_) {
+    std::fputs("frame,time_s,frame_ms,cpu_ms,gpu_ms,draw_calls,instanced_draws,indirect_draws,triangles,vertices,"
+               "program_binds,texture_binds,upload_bytes\n", file_);
+  }
+  return true;
+}
+
+void FrameStatsLogger::Close() {
+  if (file_) std::fclose(file_);
+  file_ = nullptr;
+}
+
+void FrameStatsLogger::Write(double time_s, float frame_ms, float cpu_ms, float gpu_ms, const FrameCounters& c) {
+  if (!file_) return;
+  const char* format = json_
+    ? "{\"frame\":%llu,\"time_s\":%.4f,\"frame_ms\":%.3f,\"cpu_ms\":%.3f,\"gpu_ms\":%.3f,\"draw_calls\":%u,\"instanced_draws\":%u,"
+      "\"indirect_draws\":%u,\"triangles\":%llu,\"vertices\":%llu,\"program_binds\":%u,\"texture_binds\":%u,"
+      "\"upload_bytes\":%llu}\n"
+    : "%llu,%.4f,%.3f,%.3f,%.3f,%u,%u,%u,%llu,%llu,%u,%u,%llu\n";
+  std::fprintf(file_, format, frame_, time_s, frame_ms, cpu_ms, gpu_ms, c.draw_calls, c.instanced_draws, c.indirect_draws,
+               c.triangles, c.vertices, c.program_binds, c.texture_binds, c.upload_bytes);
+  if (++frame_ % 60 == 0) std::fflush(file_);
+}
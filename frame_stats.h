@@ -0,0 +1,76 @@
+#ifndef FRAME_STATS_H_
+#define FRAME_STATS_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// GL work submitted in one frame
+struct FrameCounters {
+  unsigned int draw_calls = 0;        // every glDraw* / glMultiDraw* call
+  unsigned int instanced_draws = 0;   // draws with more than one instance
+  unsigned int indirect_draws = 0;    // commands of multi-draw-indirect calls, upper bound
+  unsigned long long triangles = 0;   // direct draws only, see indirect_draws
+  unsigned long long vertices = 0;
+  unsigned int program_binds = 0;
+  unsigned int texture_binds = 0;
+  unsigned long long upload_bytes = 0;  // glBufferData / glBufferSubData and the named variants
+};
+
+namespace frame_stats {
+
+// Counters of the frame being recorded, written by the GL hooks
+extern FrameCounters counters;
+
+// Wraps the counted glad entry points, call once after the GL loader
+void InstallGLHooks();
+
+// Returns the counters of the frame and starts a new one
+FrameCounters EndFrame();
+
+}  // namespace frame_stats
+
+// FRAME TIME HISTORY
+//=-----------------------------=
+// Rolling window of the last CAPACITY frame times with percentiles and a
+// fixed-bucket histogram for the overlay.
+class FrameTimeHistory {
+public:
+  static const int CAPACITY = 1000;
+  static const int BUCKETS = 50;  // BUCKET_MS wide, the last one collects the rest
+  static constexpr float BUCKET_MS = 1.0f;
+
+private:
+  std::vector<float> samples_;
+  int next_ = 0;
+
+public:
+  void Add(float ms);
+  // p in [0, 100], 0 when empty
+  float Percentile(float p) const;
+  // Samples oldest first
+  std::vector<float> Ordered() const;
+  std::vector<float> Histogram() const;
+  size_t size() const { return samples_.size(); }
+};
+
+// FRAME STATS LOGGER
+//=-----------------------------=
+// One record per frame for soak tests, CSV or JSON lines picked by the
+// file extension (.json / .jsonl, anything else is CSV). Flushed every
+// second or so, so a crashed run still leaves its data behind.
+class FrameStatsLogger {
+  FILE* file_ = nullptr;
+  bool json_ = false;
+  unsigned long long frame_ = 0;
+
+public:
+  ~FrameStatsLogger() { Close(); }
+
+  bool Open(const std::string& path);
+  void Close();
+  bool is_open() const { return file_ != nullptr; }
+  void Write(double time_s, float frame_ms, float cpu_ms, float gpu_ms, const FrameCounters& counters);
+};
+
+#endif
@@ -0,0 +1,45 @@
+#version 450 core
+// G-buffer layout, see gbuffer.h
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gSpecular;
+layout (location = 2) out vec2 gNormal;
+
+struct MaterialData {
+    vec4 diffuse;   // rgb - diffuse
+    vec4 specular;  // rgb - specular, a - shininess
+};
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    flat uint MaterialIndex;
+} fs_in;
+
+layout (std430, binding = 4) readonly buffer Materials
+{
+    MaterialData materials[];
+};
+
+// material texture table (see MaterialTextureSlot)
+layout (binding = 0) uniform sampler2D texture_diffuse1;
+layout (binding = 1) uniform sampler2D texture_specular1;
+
+// octahedral mapping of a unit vector to [0, 1]^2
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+void main()
+{
+    MaterialData material = materials[fs_in.MaterialIndex];
+    // textures are sampled once here instead of once per light
+    gAlbedo = vec4(texture(texture_diffuse1, fs_in.TexCoords).rgb * material.diffuse.rgb, 1.0);
+    // shininess stored as log2(s) / 11, up to 2048
+    gSpecular = vec4(texture(texture_specular1, fs_in.TexCoords).rgb * material.specular.rgb,
+                     clamp(log2(max(material.specular.a, 1.0)) / 11.0, 0.0, 1.0));
+    gNormal = EncodeNormal(normalize(fs_in.Normal));
+}
@@ -0,0 +1,49 @@
+#ifndef GBUFFER_H_
+#define GBUFFER_H_
+
+#include <glad/glad.h>
+
+#include "frame_graph.h"
+
+// Texture units the deferred lighting pass reads the G-buffer from
+// (layout(binding = N) in deferred_lighting.frag)
+enum GBufferSlot {
+  GBUFFER_ALBEDO = 0,    // rgb - diffuse texture * material diffuse
+  GBUFFER_SPECULAR = 1,  // rgb - specular texture * material specular, a - encoded shininess
+  GBUFFER_NORMAL = 2,    // rg - octahedral world-space normal
+  GBUFFER_DEPTH = 5,     // shared depth-stencil of the frame buffer
+  GBUFFER_COLOR_COUNT = 3
+};
+
+// G-BUFFER
+//=-----------------------------=
+// Render targets of the deferred path, transient resources of the frame
+// graph that live from the G-buffer fill to the lighting pass. Depth and
+// stencil are the frame's depth target, so the outline and skybox passes
+// that follow work the same in both modes.
+class GBuffer {
+public:
+  FrameGraphResource targets[GBUFFER_COLOR_COUNT] = { -1, -1, -1 };
+
+  void Declare(FrameGraph& graph, int width, int height) {
+    // sRGB albedo keeps precision in the darks at 8 bits per channel
+    const GLenum formats[GBUFFER_COLOR_COUNT] = { GL_SRGB8_ALPHA8, GL_RGBA8, GL_RG16 };
+    const char* names[GBUFFER_COLOR_COUNT] = { "G-buffer albedo", "G-buffer specular", "G-buffer normal" };
+    for (int i = 0; i < GBUFFER_COLOR_COUNT; i++)
+      targets[i] = graph.Create(names[i], { formats[i], width, height, GL_NEAREST });
+  }
+
+  GLuint Framebuffer(FrameGraph& graph, FrameGraphResource depth) const {
+    return graph.Framebuffer({ targets[0], targets[1], targets[2] }, depth);
+  }
+
+  // Binds the color targets and the depth texture for the lighting pass
+  void BindTextures(const FrameGraph& graph, FrameGraphResource depth) const {
+    GLuint textures[GBUFFER_COLOR_COUNT];
+    for (int i = 0; i < GBUFFER_COLOR_COUNT; i++) textures[i] = graph.texture(targets[i]);
+    glBindTextures(GBUFFER_ALBEDO, GBUFFER_COLOR_COUNT, textures);
+    glBindTextureUnit(GBUFFER_DEPTH, graph.texture(depth));
+  }
+};
+
+#endif
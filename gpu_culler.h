@@ -0,0 +1,255 @@
+#ifndef GPU_CULLER_H_
+#define GPU_CULLER_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <SHADER/shader_c.h>
+
+#include "compute_shader.h"
+#include "render_queue.h"
+
+// Binding points of the culling SSBOs in cull.comp
+const unsigned int CULL_CANDIDATE_BINDING = 11;
+const unsigned int CULL_BUCKET_BINDING = 12;
+const unsigned int CULL_COMMAND_BINDING = 13;
+const unsigned int CULL_COUNT_BINDING = 14;
+// Texture unit of the depth pyramid in cull.comp
+const unsigned int HIZ_TEXTURE_UNIT = 6;
+// Size of viewProjections[] in cull.comp
+const unsigned int MAX_CULL_VIEWS = 16;
+
+// One draw to be culled, std430 (must match Candidate in cull.comp)
+struct CullCandidate {
+  glm::vec4 bounds_min;  // model space, w unused
+  glm::vec4 bounds_max;
+  glm::uvec4 command;    // x - index count, y - first index, z - base vertex, w - draw index
+  glm::uvec4 info;       // x - bucket
+};
+
+// Layout of glMultiDrawElementsIndirect commands
+struct DrawCommand {
+  unsigned int count;
+  unsigned int instance_count;
+  unsigned int first_index;
+  int base_vertex;
+  unsigned int base_instance;
+};
+
+// HI-Z PYRAMID
+//=-----------------------------=
+// Mip chain of the scene depth where every texel keeps the farthest depth
+// of its footprint. Level 0 is the largest power of two that fits the
+// screen, so each level halves exactly.
+class HiZPyramid {
+  GLuint texture_ = 0;
+  int width_ = 0, height_ = 0, levels_ = 0;
+  glm::mat4 view_projection_ = glm::mat4(1.0f);
+
+public:
+  ~HiZPyramid() {
+    if (texture_) glDeleteTextures(1, &texture_);
+  }
+
+  GLuint texture() const { return texture_; }
+  bool empty() const { return texture_ == 0; }
+  // Camera the pyramid was built with, cull.comp projects the bounds with it
+  const glm::mat4& view_projection() const { return view_projection_; }
+
+  void Build(const ComputeShader& shader, GLuint depth_texture, int screen_width, int screen_height,
+             const glm::mat4& view_projection) {
+    int width = 1, height = 1;
+    while (width * 2 <= screen_width) width *= 2;
+    while (height * 2 <= screen_height) height *= 2;
+    if (width != width_ || height != height_) Allocate(width, height);
+    view_projection_ = view_projection;
+
+    shader.use();
+    glUniform1i(shader.location("source"), 0);
+    int source_width = screen_width, source_height = screen_height;
+    for (int level = 0; level < levels_; level++) {
+      int level_width = std::max(width_ >> level, 1), level_height = std::max(height_ >> level, 1);
+      glBindTextureUnit(0, level ? texture_ : depth_texture);
+      glBindImageTexture(0, texture_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+      glUniform1i(shader.location("sourceLevel"), level ? level - 1 : 0);
+      glUniform2i(shader.location("sourceSize"), source_width, source_height);
+      glUniform2i(shader.location("destinationSize"), level_width, level_height);
+      glDispatchCompute((level_width + 7) / 8, (level_height + 7) / 8, 1);
+      glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+      source_width = level_width;
+      source_height = level_height;
+    }
+    glBindTextureUnit(0, 0);
+  }
+
+private:
+  void Allocate(int width, int height) {
+    if (texture_) glDeleteTextures(1, &texture_);
+    width_ = width;
+    height_ = height;
+    levels_ = 1;
+    while ((std::max(width, height) >> levels_) > 0) levels_++;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture_);
+    glTextureStorage2D(texture_, levels_, GL_R32F, width_, height_);
+    glTextureParameteri(texture_, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(texture_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(texture_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+};
+
+// INDIRECT BATCH
+//=-----------------------------=
+// GPU-culled version of a RenderQueue. Every mesh draw becomes a candidate,
+// cull.comp tests it against one or more view-projections and writes the
+// survivors as indirect commands. Draws are grouped into buckets, a run of
+// one material in the sorted queue, so textures are still bound per batch
+// and each bucket is one multi-draw. Commands of view v start at
+// v * candidate count, bucket b of view v counts in counts[v * buckets + b].
+//
+// glMultiDrawElementsIndirectCount needs GL 4.6 (Mesa's llvmpipe exposes
+// 4.5). Without it every candidate keeps its slot and culled ones get
+// instanceCount 0, drawn with glMultiDrawElementsIndirect.
+class IndirectBatch {
+  GLuint candidate_ssbo_ = 0, bucket_ssbo_ = 0, command_buffer_ = 0, count_buffer_ = 0;
+  size_t candidate_capacity_ = 0, bucket_capacity_ = 0, command_capacity_ = 0, count_capacity_ = 0;
+
+  std::vector<CullCandidate> candidates_;
+  std::vector<glm::uvec2> buckets_;        // x - first candidate, y - candidate count
+  std::vector<const Material*> materials_; // per bucket
+  unsigned int views_ = 0;
+  bool compact_ = true;
+
+public:
+  ~IndirectBatch() {
+    GLuint buffers[] = { candidate_ssbo_, bucket_ssbo_, command_buffer_, count_buffer_ };
+    for (GLuint buffer : buffers)
+      if (buffer) glDeleteBuffers(1, &buffer);
+  }
+
+  bool empty() const { return candidates_.empty(); }
+  size_t size() const { return candidates_.size(); }
+
+  // Rebuilds the candidate list, buffers are written only when it changed.
+  // Without by_material the whole queue is one bucket (depth-only passes).
+  void Build(const RenderQueue& queue, bool by_material) {
+    compact_ = glMultiDrawElementsIndirectCount != nullptr;
+
+    std::vector<CullCandidate> candidates;
+    std::vector<glm::uvec2> buckets;
+    materials_.clear();
+    candidates.reserve(queue.size());
+    for (const DrawItem& item : queue.items()) {
+      if (buckets.empty() || (by_material && item.material != materials_.back())) {
+        buckets.push_back(glm::uvec2((unsigned int)candidates.size(), 0u));
+        materials_.push_back(item.material);
+      }
+      buckets.back().y++;
+
+      const Mesh* mesh = item.mesh;
+      CullCandidate candidate;
+      candidate.bounds_min = glm::vec4(mesh->bounds_min, 0.0f);
+      candidate.bounds_max = glm::vec4(mesh->bounds_max, 0.0f);
+      candidate.command = glm::uvec4((unsigned int)mesh->indices.size(), mesh->range.first_index,
+                                     (unsigned int)mesh->range.base_vertex, item.draw_index);
+      candidate.info = glm::uvec4((unsigned int)buckets.size() - 1, 0u, 0u, 0u);
+      candidates.push_back(candidate);
+    }
+
+    if (!Same(candidates, candidates_)) {
+      candidates_.swap(candidates);
+      Upload(candidate_ssbo_, candidate_capacity_, candidates_);
+    }
+    if (!Same(buckets, buckets_)) {
+      buckets_.swap(buckets);
+      Upload(bucket_ssbo_, bucket_capacity_, buckets_);
+    }
+  }
+
+  // Culls the candidates against every view, hiz (when given) is tested for
+  // view 0 only. The commands are ready for Draw after the barrier.
+  void Cull(const ComputeShader& shader, const std::vector<glm::mat4>& view_projections,
+            const HiZPyramid* hiz = nullptr) {
+    views_ = (unsigned int)std::min<size_t>(view_projections.size(), MAX_CULL_VIEWS);
+    if (candidates_.empty() || !views_) return;
+
+    Reserve(command_buffer_, command_capacity_, candidates_.size() * views_ * sizeof(DrawCommand));
+    Reserve(count_buffer_, count_capacity_, buckets_.size() * views_ * sizeof(unsigned int));
+    glClearNamedBufferData(count_buffer_, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_CANDIDATE_BINDING, candidate_ssbo_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BUCKET_BINDING, bucket_ssbo_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_COMMAND_BINDING, command_buffer_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_COUNT_BINDING, count_buffer_);
+
+    bool use_hiz = hiz && !hiz->empty();
+    shader.use();
+    glUniform1ui(shader.location("candidateCount"), (GLuint)candidates_.size());
+    glUniform1ui(shader.location("bucketCount"), (GLuint)buckets_.size());
+    glUniformMatrix4fv(shader.location("viewProjections"), views_, GL_FALSE, glm::value_ptr(view_projections[0]));
+    glUniform1i(shader.location("compact"), compact_);
+    glUniform1i(shader.location("useHiZ"), use_hiz);
+    glUniform1i(shader.location("hiZ"), HIZ_TEXTURE_UNIT);
+    if (use_hiz) {
+      glUniformMatrix4fv(shader.location("hiZViewProjection"), 1, GL_FALSE, glm::value_ptr(hiz->view_projection()));
+      glBindTextureUnit(HIZ_TEXTURE_UNIT, hiz->texture());
+    }
+
+    glDispatchCompute((GLuint)(candidates_.size() + 63) / 64, views_, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+
+  // Issues the surviving draws of one view, one multi-draw per bucket
+  void Draw(Shader* shader, unsigned int view, bool bind_materials = true) const {
+    if (candidates_.empty() || view >= views_) return;
+    shader->use();
+    glBindVertexArray(GeometryPool::Get().vao());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    if (compact_) glBindBuffer(GL_PARAMETER_BUFFER, count_buffer_);
+
+    for (size_t b = 0; b < buckets_.size(); b++) {
+      if (bind_materials) materials_[b]->Bind();
+      const void* commands = (const void*)((view * candidates_.size() + buckets_[b].x) * sizeof(DrawCommand));
+      if (compact_) {
+        GLintptr count = (GLintptr)((view * buckets_.size() + b) * sizeof(unsigned int));
+        glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, commands, count,
+                                         buckets_[b].y, sizeof(DrawCommand));
+      }
+      else {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, buckets_[b].y, sizeof(DrawCommand));
+      }
+    }
+
+    if (compact_) glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+  }
+
+private:
+  template<typename T>
+  static bool Same(const std::vector<T>& a, const std::vector<T>& b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+  }
+
+  // Grows a buffer to at least bytes, contents are not kept
+  static void Reserve(GLuint& buffer, size_t& capacity, size_t bytes) {
+    if (buffer && bytes <= capacity) return;
+    if (buffer) glDeleteBuffers(1, &buffer);
+    capacity = std::max<size_t>(bytes * 2, 1024);
+    glCreateBuffers(1, &buffer);
+    glNamedBufferData(buffer, capacity, nullptr, GL_DYNAMIC_DRAW);
+  }
+
+  template<typename T>
+  static void Upload(GLuint& buffer, size_t& capacity, const std::vector<T>& records) {
+    Reserve(buffer, capacity, records.size() * sizeof(T));
+    if (!records.empty()) glNamedBufferSubData(buffer, 0, records.size() * sizeof(T), records.data());
+  }
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef GPU_TIMER_H_
+#define GPU_TIMER_H_
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "profiler.h"
+
+// Passes timed on the GPU, in frame order
+enum GpuPass {
+  GPU_PASS_SHADOW,        // directional light cascades
+  GPU_PASS_LIGHT_SHADOW,  // point and spot light tiles of the shadow atlas
+  GPU_PASS_MAIN,          // prepass, color pass, deferred lighting, outline
+  GPU_PASS_SKYBOX,
+  GPU_PASS_QUAD,          // frame buffer to the default frame buffer
+  GPU_PASS_IMGUI,
+  GPU_PASS_COUNT
+};
+
+inline const char* GpuPassName(int pass) {
+  static const char* names[GPU_PASS_COUNT] = { "Shadows", "Light shadows", "Main", "Skybox", "Quad", "ImGui" };
+  return names[pass];
+}
+
+// Result of one pass, ms is 0 when the pass did not run
+struct GpuPassTiming {
+  float ms = 0.0f;
+  unsigned long long vertices = 0;    // GL_VERTICES_SUBMITTED
+  unsigned long long primitives = 0;  // GL_PRIMITIVES_SUBMITTED
+  unsigned long long fragments = 0;   // GL_FRAGMENT_SHADER_INVOCATIONS
+};
+
+// GPU TIMER
+//=-----------------------------=
+// GL_TIMESTAMP queries around every pass, plus pipeline statistics
+// (ARB_pipeline_statistics_query, core in 4.6) where available. Queries
+// rotate over FRAMES sets and a set is read FRAMES frames later, when its
+// slot comes around again, only once its last query is available, so
+// reading never stalls; a late set is dropped and the previous results
+// stay. Timestamps are mapped to the CPU clock, so
+// passes also show up in profiler captures on a "GPU" track.
+class GpuTimer {
+public:
+  static const int FRAMES = 3;
+
+private:
+  static const int STATISTICS = 3;
+
+  struct FrameQueries {
+    GLuint begin[GPU_PASS_COUNT] = {};
+    GLuint end[GPU_PASS_COUNT] = {};
+    GLuint statistics[GPU_PASS_COUNT][STATISTICS] = {};
+    bool used[GPU_PASS_COUNT] = {};
+    bool pending = false;
+    unsigned int frame = 0;  // frame the queries were issued in
+  };
+
+  FrameQueries frames_[FRAMES];
+  unsigned int frame_ = 0;
+  bool statistics_supported_ = false;
+  int64_t gpu_to_cpu_ns_ = 0;  // profiler::Now() - GL_TIMESTAMP
+  GpuPassTiming results_[GPU_PASS_COUNT];
+  unsigned int result_frame_ = 0;
+
+public:
+  GpuTimer() = default;
+  GpuTimer(const GpuTimer&) = delete;
+  GpuTimer& operator=(const GpuTimer&) = delete;
+
+  ~GpuTimer() {
+    if (!frames_[0].begin[0]) return;
+    for (FrameQueries& frame : frames_) {
+      glDeleteQueries(GPU_PASS_COUNT, frame.begin);
+      glDeleteQueries(GPU_PASS_COUNT, frame.end);
+      if (statistics_supported_) glDeleteQueries(GPU_PASS_COUNT * STATISTICS, &frame.statistics[0][0]);
+    }
+  }
+
+  bool statistics_supported() const { return statistics_supported_; }
+  const GpuPassTiming& result(int pass) const { return results_[pass]; }
+  // Number of the current frame, counted by NewFrame from 1
+  unsigned int frame() const { return frame_; }
+  // Frame the results belong to, 0 before the first one was read
+  unsigned int result_frame() const { return result_frame_; }
+
+  // Reads the oldest set when it is ready and starts a new frame
+  void NewFrame() {
+    if (!frames_[0].begin[0]) Init();
+    frame_++;
+    FrameQueries& frame = frames_[frame_ % FRAMES];
+    if (frame.pending) Read(frame);
+    std::memset(frame.used, 0, sizeof(frame.used));
+    frame.pending = false;
+    frame.frame = frame_;
+  }
+
+  void Begin(GpuPass pass) {
+    FrameQueries& frame = frames_[frame_ % FRAMES];
+    glQueryCounter(frame.begin[pass], GL_TIMESTAMP);
+    if (statistics_supported_) {
+      glBeginQuery(GL_VERTICES_SUBMITTED, frame.statistics[pass][0]);
+      glBeginQuery(GL_PRIMITIVES_SUBMITTED, frame.statistics[pass][1]);
+      glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, frame.statistics[pass][2]);
+    }
+  }
+
+  void End(GpuPass pass) {
+    FrameQueries& frame = frames_[frame_ % FRAMES];
+    if (statistics_supported_) {
+      glEndQuery(GL_VERTICES_SUBMITTED);
+      glEndQuery(GL_PRIMITIVES_SUBMITTED);
+      glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+    }
+    glQueryCounter(frame.end[pass], GL_TIMESTAMP);
+    frame.used[pass] = true;
+    frame.pending = true;
+  }
+
+private:
+  void Init() {
+    statistics_supported_ = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6) ||
+                            HasExtension("GL_ARB_pipeline_statistics_query");
+    for (FrameQueries& frame : frames_) {
+      glGenQueries(GPU_PASS_COUNT, frame.begin);
+      glGenQueries(GPU_PASS_COUNT, frame.end);
+      if (statistics_supported_) glGenQueries(GPU_PASS_COUNT * STATISTICS, &frame.statistics[0][0]);
+    }
+    Calibrate();
+  }
+
+  // One synchronous timestamp read, the clocks drift slowly enough that
+  // this is only repeated when a result is read
+  void Calibrate() {
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    gpu_to_cpu_ns_ = (int64_t)profiler::Now() - (int64_t)gpu_now;
+  }
+
+  void Read(const FrameQueries& frame) {
+    // The last query of the frame decides, results arrive in order
+    int last = -1;
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+      if (frame.used[pass]) last = pass;
+    if (last < 0) return;
+    GLint available = 0;
+    glGetQueryObjectiv(frame.end[last], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return;
+
+    if (profiler::IsCapturing()) Calibrate();
+    result_frame_ = frame.frame;
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+      GpuPassTiming& timing = results_[pass];
+      if (!frame.used[pass]) {
+        timing = GpuPassTiming();
+        continue;
+      }
+      GLuint64 begin = 0, end = 0;
+      glGetQueryObjectui64v(frame.begin[pass], GL_QUERY_RESULT, &begin);
+      glGetQueryObjectui64v(frame.end[pass], GL_QUERY_RESULT, &end);
+      timing.ms = (end - begin) / 1e6f;
+      if (statistics_supported_) {
+        GLuint64 counters[STATISTICS] = {};
+        for (int i = 0; i < STATISTICS; i++)
+          glGetQueryObjectui64v(frame.statistics[pass][i], GL_QUERY_RESULT, &counters[i]);
+        timing.vertices = counters[0];
+        timing.primitives = counters[1];
+        timing.fragments = counters[2];
+      }
+      profiler::RecordGpu(GpuPassName(pass), begin + gpu_to_cpu_ns_, end + gpu_to_cpu_ns_);
+    }
+  }
+
+  static bool HasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+      const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+      if (extension && std::strcmp(extension, name) == 0) return true;
+    }
+    return false;
+  }
+};
+
+#endif
@@ -6,18 +6,22 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "scene.h"
+#include "profiler.h"
+#include "camera_path.h"
 
 static class InputHandler {
   Scene* scene_ = nullptr;
   float MovementSpeed = 2.5f;
   float MouseSensitivity = 0.1f;
   bool renderImGUI = 0;
+  unsigned int profilerCaptureFrames = 120;  // frames recorded per F9 capture
 
 public:
   InputHandler() {};
   void SetScene(Scene* scene) { scene_ = scene; };
 
   bool DoImGUI() { return renderImGUI; };
+  void SetProfilerCaptureFrames(unsigned int frames) { profilerCaptureFrames = frames; };
 
   void ProcessMouseMovement(float xoffset,
                          float yoffset,
@@ -64,6 +68,22 @@ public:
     }
     f5PressedLastFrame = f5CurrentlyPressed;
 
+    // Capture a CPU trace (trace.json)
+    static bool f9PressedLastFrame = false;
+    bool f9CurrentlyPressed = (glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS);
+    if (f9CurrentlyPressed && !f9PressedLastFrame) {
+      profiler::RequestCapture(profilerCaptureFrames);
+    }
+    f9PressedLastFrame = f9CurrentlyPressed;
+
+    // Append the camera to the benchmark path (camera_path.txt)
+    static bool f10PressedLastFrame = false;
+    bool f10CurrentlyPressed = (glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS);
+    if (f10CurrentlyPressed && !f10PressedLastFrame && camera) {
+      CameraPath::Append("camera_path.txt", CameraPath::FromCamera(camera));
+    }
+    f10PressedLastFrame = f10CurrentlyPressed;
+
     //// Toggle Debug
     //static bool EPressedLastFrame = false; // Track F5 state
     //bool ECurrentlyPressed = (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS);
@@ -0,0 +1,114 @@
+#ifndef LAYERED_SHADOWS_H_
+#define LAYERED_SHADOWS_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <SHADER/shader_c.h>
+
+#include "mesh.h"
+#include "render_queue.h"
+
+// Binding point of the layer entries in depth_layered.vert
+const unsigned int LAYER_DRAW_BINDING = 17;
+
+// LAYERED SHADOW BATCH
+//=-----------------------------=
+// Draws a queue into several layers of a layered depth target without a
+// geometry shader. Each mesh is tested on the CPU against the matrix of
+// every layer, the layers it touches become a run of (draw record, layer)
+// entries, and the mesh is drawn once with one instance per entry:
+// baseInstance points aDrawIndex at the run, depth_layered.vert picks the
+// matrix and writes gl_Layer. Meshes outside every layer are not drawn.
+//
+// Writing gl_Layer from the vertex shader needs
+// ARB_shader_viewport_layer_array; without it the renderer keeps the
+// geometry shader path (Supported).
+class LayeredShadowBatch {
+  struct Run {
+    const Mesh* mesh;
+    unsigned int first, count;  // entries
+  };
+
+  std::vector<glm::uvec2> entries_;  // x - draw record, y - layer
+  std::vector<Run> runs_;
+  GLuint ssbo_ = 0;
+  size_t capacity_ = 0;  // entries
+
+public:
+  ~LayeredShadowBatch() {
+    if (ssbo_) glDeleteBuffers(1, &ssbo_);
+  }
+
+  static bool Supported() {
+    static const bool supported = HasExtension("GL_ARB_shader_viewport_layer_array");
+    return supported;
+  }
+
+  size_t instances() const { return entries_.size(); }
+
+  // layers - which of matrices to draw into this time
+  void Build(const RenderQueue& queue, const std::vector<glm::mat4>& matrices, const std::vector<bool>& layers) {
+    entries_.clear();
+    runs_.clear();
+    for (const DrawItem& item : queue.items()) {
+      glm::mat4 model = item.model->GetModelMatrix();
+      unsigned int first = (unsigned int)entries_.size();
+      for (size_t layer = 0; layer < matrices.size(); ++layer) {
+        if (layers[layer] && Touches(matrices[layer] * model, item.mesh->bounds_min, item.mesh->bounds_max))
+          entries_.push_back(glm::uvec2(item.draw_index, (unsigned int)layer));
+      }
+      unsigned int count = (unsigned int)entries_.size() - first;
+      if (count) runs_.push_back({ item.mesh, first, count });
+    }
+    if (entries_.empty()) return;
+
+    // aDrawIndex runs up to the last entry
+    DrawIndexBuffer::Reserve((unsigned int)entries_.size());
+    if (!ssbo_ || entries_.size() > capacity_) {
+      if (!ssbo_) glCreateBuffers(1, &ssbo_);
+      capacity_ = std::max(entries_.size(), capacity_ * 2);
+      glNamedBufferData(ssbo_, capacity_ * sizeof(glm::uvec2), nullptr, GL_STREAM_DRAW);
+    }
+    glNamedBufferSubData(ssbo_, 0, entries_.size() * sizeof(glm::uvec2), entries_.data());
+  }
+
+  void Draw(Shader* shader) const {
+    if (runs_.empty()) return;
+    shader->use();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LAYER_DRAW_BINDING, ssbo_);
+    glBindVertexArray(GeometryPool::Get().vao());
+    for (const Run& run : runs_) {
+      const Mesh& mesh = *run.mesh;
+      glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT,
+        (void*)(mesh.range.first_index * sizeof(unsigned int)), run.count, mesh.range.base_vertex, run.first);
+    }
+    glBindVertexArray(0);
+  }
+
+private:
+  // Model-space box against the clip volume of an orthographic matrix
+  static bool Touches(const glm::mat4& matrix, const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+    glm::vec3 half = (bounds_max - bounds_min) * 0.5f;
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((bounds_min + bounds_max) * 0.5f, 1.0f));
+    glm::vec3 extent = glm::abs(glm::vec3(matrix[0])) * half.x + glm::abs(glm::vec3(matrix[1])) * half.y +
+                       glm::abs(glm::vec3(matrix[2])) * half.z;
+    return glm::all(glm::lessThanEqual(glm::abs(center) - extent, glm::vec3(1.0f)));
+  }
+
+  static bool HasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+      const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+      if (extension && std::strcmp(extension, name) == 0) return true;
+    }
+    return false;
+  }
+};
+
+#endif
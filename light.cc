@@ -1,16 +1,57 @@
 #include "light.h"
+#include "light_buffer.h"
+#include "light_clusters.h"
+
+// Brightest channel of a light, decides how far its attenuation reaches
+static float Brightness(const glm::vec3& diffuse, const glm::vec3& specular) {
+  glm::vec3 c = glm::max(diffuse, specular);
+  return glm::max(c.x, glm::max(c.y, c.z));
+}
 
 // AMBIENT LIGHT
 // =-----------------------------=
-
+void AmbientLight::update(LightBuffer& buffer, int index) {
+  buffer.globals.ambient = color.ambient * intensity;
+}
 
 // DIRECTIONAL LIGHT
 // =-----------------------------=
-
+void DirectionalLight::update(LightBuffer& buffer, int index) {
+  buffer.globals.dirDirection = direction;
+  buffer.globals.dirDiffuse = color.diffuse * intensity;
+  buffer.globals.dirSpecular = color.specular * intensity;
+}
 
 // POINT LIGHT
 // =-----------------------------=
-
+void PointLight::update(LightBuffer& buffer, int index) {
+  PointLightData& data = buffer.point_lights[index];
+  data.position = transforms.position;
+  data.diffuse = color.diffuse * intensity;
+  data.specular = color.specular * intensity;
+  data.constant = constant;
+  data.linear = linear;
+  data.quadratic = quadratic;
+  data.farPlane = far_plane;
+  data.shadowIndex = -1;  // until the shadow atlas gives it tiles
+  data.radius = AttenuationRadius(constant, linear, quadratic,
+                                  Brightness(data.diffuse, data.specular));
+}
 
 // SPOT LIGHT
-// =-----------------------------=
\ No newline at end of file
+// =-----------------------------=
+void SpotLight::update(LightBuffer& buffer, int index) {
+  SpotLightData& data = buffer.spot_lights[index];
+  data.position = transforms.position;
+  data.direction = direction;
+  data.diffuse = color.diffuse * intensity;
+  data.specular = color.specular * intensity;
+  data.cutOff = cutOff;
+  data.outerCutOff = outerCutOff;
+  data.constant = constant;
+  data.linear = linear;
+  data.quadratic = quadratic;
+  data.shadowIndex = -1;  // until the shadow atlas gives it a tile
+  data.radius = AttenuationRadius(constant, linear, quadratic,
+                                  Brightness(data.diffuse, data.specular));
+}
@@ -4,6 +4,8 @@
 #include "object.h"
 #include <custom/camera.h>
 
+class LightBuffer;
+
 struct LightColor {
   glm::vec3 ambient;
   glm::vec3 diffuse;
@@ -29,15 +31,21 @@ public:
   float getIntensity() const { return intensity; }
 
   // Setters
-  void setColor(const LightColor& c) { color = c; }
-  void setIntensity(float i) { intensity = i; }
+  void setColor(const LightColor& c) { color = c; MarkDirty(); }
+  void setIntensity(float i) {
+    if (i == intensity) return;
+    intensity = i;
+    MarkDirty();
+  }
 
-  // Override update function
-  virtual void update(Shader* shader, int index) = 0;
+  // Lights don't set uniforms, they write a packed record into the light
+  // buffer at the given index (see light.cc)
+  void update(Shader* shader, int index) override {}
+  virtual void update(LightBuffer& buffer, int index) = 0;
 
   void draw_menu() override {
     if (ImGui::Begin(("Properties - " + name).c_str())) {
-      ImGui::DragFloat("Intensity", &intensity, 0.1f, 0.0f, 10.0f);
+      if (ImGui::DragFloat("Intensity", &intensity, 0.1f, 0.0f, 10.0f)) MarkDirty();
     }
     ImGui::End();
   }
@@ -49,14 +57,11 @@ public:
     color.ambient = am_color;
     intensity = intens;
   }
-  void update(Shader* shader, int index) {
-    shader->use();
-    shader->setVec3("ambient", glm::vec3(color.ambient * intensity));
-  }
+  void update(LightBuffer& buffer, int index) override;
   void draw_menu() override {
     if (ImGui::Begin(("Properties - " + name).c_str())) {
       Light::draw_menu();  // Call base class UI
-      ImGui::ColorEdit3("Light Color", glm::value_ptr(color.ambient));
+      if (ImGui::ColorEdit3("Light Color", glm::value_ptr(color.ambient))) MarkDirty();
     }
     ImGui::End();
   }
@@ -73,10 +78,23 @@ private:
 
   Camera* camera;
 public:
-  const unsigned int SHADOW_WIDTH = 4096, SHADOW_HEIGHT = 4096;
-  unsigned int depthMapFBO;  // Framebuffers for cascades
-  unsigned int depthMap;    // Depth maps
+  // Set by setupDepthBuffers, the maps are made when the renderer first
+  // draws this light's shadows
+  unsigned int SHADOW_WIDTH = 0, SHADOW_HEIGHT = 0;
+  unsigned int depthMapFBO = 0;  // Framebuffers for cascades
+  unsigned int depthMap = 0;    // Depth maps
+  // Static casters only, copied into depthMap before the dynamic ones are
+  // drawn (see ShadowCache)
+  unsigned int staticDepthMapFBO = 0;
+  unsigned int staticDepthMap = 0;
   std::vector<float> shadowCascadeLevels;
+  // Visible view distances the cascades cover, see setDepthRange; 0 - the
+  // camera's near and far plane
+  float depthRangeNear = 0.0f, depthRangeFar = 0.0f;
+  // See setCasterBounds, min above max - no casters known, the depth range
+  // is the cascade's bounding sphere
+  glm::vec3 casterBoundsMin = glm::vec3(1.0f);
+  glm::vec3 casterBoundsMax = glm::vec3(-1.0f);
 
   DirectionalLight(Camera* camera_p, glm::vec3 direction = glm::vec3(-1.0f, -1.0f, -1.0f),
     LightColor color = { glm::vec3(1.0f), glm::vec3(1.0f), glm::vec3(1.0f) },
@@ -84,29 +102,31 @@ public:
     : Light(glm::vec3(0.0f), color, intensity), direction(glm::normalize(direction)) {
     /*setupDepthBuffer();*/
     camera = camera_p;
-    setupDepthBuffers();
+    resetDepthRange();
   }
 
   glm::vec3 getDirection() const { return direction; }
 
-  void setDirection(const glm::vec3& dir) { direction = glm::normalize(dir); }
+  void setDirection(const glm::vec3& dir) { direction = glm::normalize(dir); MarkDirty(); }
   void setCamera(Camera* camera_s) { camera = camera_s; }
 
-  void update(Shader* shader, int index) override {
-    shader->use();
-    shader->setVec3("dirLight.direction", direction);
-    shader->setVec3("dirLight.diffuse", color.diffuse * intensity);
-    shader->setVec3("dirLight.specular", color.specular * intensity);
+  void update(LightBuffer& buffer, int index) override;
 
-    shader->setInt("shadowMap", 3);
+  // (Re)creates the cascade arrays when the resolution changed
+  void setupDepthBuffers(unsigned int resolution) {
+    if (depthMap && SHADOW_WIDTH == resolution) return;
+    SHADOW_WIDTH = SHADOW_HEIGHT = resolution;
+    setupDepthArray(depthMap, depthMapFBO);
+    setupDepthArray(staticDepthMap, staticDepthMapFBO);
   }
 
-  void setupDepthBuffers() {
-    shadowCascadeLevels = std::vector<float>{ camera->getFar() / 150.0f, camera->getFar() / 50.0f, camera->getFar() / 18.0f, camera->getFar() / 5.0f };
-    glGenFramebuffers(1, &depthMapFBO);
+  void setupDepthArray(unsigned int& texture, unsigned int& fbo) {
+    if (texture) glDeleteTextures(1, &texture);
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+    glGenFramebuffers(1, &fbo);
 
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, depthMap);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
     glTexImage3D(
       GL_TEXTURE_2D_ARRAY,
       0,
@@ -127,8 +147,8 @@ public:
     constexpr float bordercolor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
     glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, bordercolor);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
 
@@ -142,14 +162,22 @@ public:
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
   }
 
+  // World AABB of everything that casts a shadow this frame, the depth
+  // range of the cascades is fitted to it
+  void setCasterBounds(const glm::vec3& min, const glm::vec3& max) {
+    casterBoundsMin = min;
+    casterBoundsMax = max;
+  }
+
+  // Cascade of the camera frustum slice between nearPlane and farPlane.
+  // The box is the slice's bounding sphere, so its size does not change
+  // when the camera turns, and it moves in whole shadow map texels, so the
+  // shadows do not shimmer and a still camera gives the same matrix. The
+  // depth range covers the casters between the light and the slice; it
+  // moves in steps of an eighth of the sphere's diameter.
   glm::mat4 getLightSpaceMatrix(const float nearPlane, const float farPlane)
   {
-    const auto proj = glm::perspective(
-      glm::radians(camera->Zoom),
-      (float)camera->screenWidth / (float)camera->screenHeight,
-      nearPlane, farPlane
-    );
-    const auto corners = camera->getFrustumCornersWorldSpace(proj, camera->GetViewMatrix());
+    const auto corners = getSliceCorners(nearPlane, farPlane);
 
     glm::vec3 center(0.0f);
     for (const auto& v : corners)
@@ -158,36 +186,55 @@ public:
     }
     center /= static_cast<float>(corners.size());
 
-    const auto lightView = glm::lookAt(center - direction, center, glm::vec3(0.0f, 1.0f, 0.0f));
-
-    float minX = std::numeric_limits<float>::max();
-    float maxX = std::numeric_limits<float>::lowest();
-    float minY = std::numeric_limits<float>::max();
-    float maxY = std::numeric_limits<float>::lowest();
-    float minZ = std::numeric_limits<float>::max();
-    float maxZ = std::numeric_limits<float>::lowest();
-
+    float radius = 0.0f;
     for (const auto& v : corners)
     {
-      const auto trf = lightView * v;
-      minX = std::min(minX, trf.x);
-      maxX = std::max(maxX, trf.x);
-      minY = std::min(minY, trf.y);
-      maxY = std::max(maxY, trf.y);
-      minZ = std::min(minZ, trf.z);
-      maxZ = std::max(maxZ, trf.z);
+      radius = std::max(radius, glm::length(glm::vec3(v) - center));
     }
+    radius = std::ceil(radius * 16.0f) / 16.0f;
 
-    // Define fixed scene bounds (10x10x10)
-    constexpr float SCENE_BOUND = 10.0f; // Half-size for 5 units
-    minX = std::min(minX, -SCENE_BOUND);
-    maxX = std::max(maxX, SCENE_BOUND);
-    minY = std::min(minY, -SCENE_BOUND);
-    maxY = std::max(maxY, SCENE_BOUND);
-    minZ = std::min(minZ, -SCENE_BOUND);
-    maxZ = std::max(maxZ, SCENE_BOUND);
+    // Fixed origin, only the rotation of the light, so snapping below works
+    // on a grid that does not move with the camera
+    glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    const auto lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
 
-    const glm::mat4 lightProjection = glm::ortho(minX, maxX, minY, maxY, minZ, maxZ);
+    glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+    if (SHADOW_WIDTH > 0)
+    {
+      float texel = 2.0f * radius / (float)SHADOW_WIDTH;
+      lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+      lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+    }
+
+    // Light space looks down -z: maxZ is the side facing the light
+    float minZ = lightCenter.z - radius;
+    float maxZ = lightCenter.z + radius;
+    if (casterBoundsMin.x <= casterBoundsMax.x)
+    {
+      float casterMinZ = std::numeric_limits<float>::max();
+      float casterMaxZ = std::numeric_limits<float>::lowest();
+      for (int i = 0; i < 8; ++i)
+      {
+        glm::vec3 corner(i & 1 ? casterBoundsMax.x : casterBoundsMin.x,
+                         i & 2 ? casterBoundsMax.y : casterBoundsMin.y,
+                         i & 4 ? casterBoundsMax.z : casterBoundsMin.z);
+        float z = (lightView * glm::vec4(corner, 1.0f)).z;
+        casterMinZ = std::min(casterMinZ, z);
+        casterMaxZ = std::max(casterMaxZ, z);
+      }
+      // Casters behind the light's side of the slice still shadow it;
+      // receivers past the last caster are lit (depth over 1 in the shaders)
+      maxZ = std::max(casterMaxZ, minZ);
+      minZ = std::max(minZ, std::min(casterMinZ, maxZ));
+    }
+    float step = radius * 0.25f;
+    maxZ = std::ceil(maxZ / step) * step;
+    minZ = std::min(std::floor(minZ / step) * step, maxZ - step);
+
+    const glm::mat4 lightProjection = glm::ortho(
+      lightCenter.x - radius, lightCenter.x + radius,
+      lightCenter.y - radius, lightCenter.y + radius,
+      -maxZ, -minZ);
     return lightProjection * lightView;
   }
 
@@ -196,29 +243,74 @@ public:
     std::vector<glm::mat4> ret;
     for (size_t i = 0; i < shadowCascadeLevels.size() + 1; ++i)
     {
-      if (i == 0)
-      {
-        ret.push_back(getLightSpaceMatrix(camera->getNear(), shadowCascadeLevels[i]));
-      }
-      else if (i < shadowCascadeLevels.size())
-      {
-        ret.push_back(getLightSpaceMatrix(shadowCascadeLevels[i - 1], shadowCascadeLevels[i]));
-      }
-      else
-      {
-        ret.push_back(getLightSpaceMatrix(shadowCascadeLevels[i - 1], camera->getFar()));
-      }
+      float nearPlane, farPlane;
+      getCascadeRange(i, nearPlane, farPlane);
+      ret.push_back(getLightSpaceMatrix(nearPlane, farPlane));
     }
     return ret;
   }
 
+  // View distances cascade i covers
+  void getCascadeRange(size_t i, float& nearPlane, float& farPlane) const
+  {
+    nearPlane = i > 0 ? shadowCascadeLevels[i - 1] : depthRangeFar > 0.0f ? depthRangeNear : camera->getNear();
+    farPlane = i < shadowCascadeLevels.size() ? shadowCascadeLevels[i]
+      : depthRangeFar > 0.0f ? depthRangeFar : camera->getFar();
+  }
+
+  // Fits the cascades to the view distances that were actually visible
+  // (see DepthBounds) instead of fixed fractions of the far plane. The
+  // range is widened to whole quarter octaves, so the splits only move when
+  // it changes noticeably, and split mostly logarithmically.
+  void setDepthRange(float nearDepth, float farDepth)
+  {
+    const float SPLIT_LAMBDA = 0.75f;  // 0 - uniform splits, 1 - logarithmic
+    nearDepth = std::max(std::exp2(std::floor(std::log2(std::max(nearDepth, 1e-4f)) * 4.0f) / 4.0f), camera->getNear());
+    farDepth = std::min(std::exp2(std::ceil(std::log2(std::max(farDepth, 1e-4f)) * 4.0f) / 4.0f), camera->getFar());
+    if (farDepth <= nearDepth * 1.01f) farDepth = std::min(nearDepth * 2.0f, camera->getFar());
+    if (farDepth <= nearDepth)
+    {
+      resetDepthRange();
+      return;
+    }
+
+    depthRangeNear = nearDepth;
+    depthRangeFar = farDepth;
+    shadowCascadeLevels.resize(CASCADE_COUNT);
+    for (unsigned int i = 0; i < CASCADE_COUNT; ++i)
+    {
+      float p = (i + 1) / float(CASCADE_COUNT + 1);
+      float logarithmic = nearDepth * std::pow(farDepth / nearDepth, p);
+      float uniform = nearDepth + (farDepth - nearDepth) * p;
+      shadowCascadeLevels[i] = uniform + (logarithmic - uniform) * SPLIT_LAMBDA;
+    }
+  }
+
+  // Back to the fixed splits over the whole camera range
+  void resetDepthRange()
+  {
+    depthRangeNear = depthRangeFar = 0.0f;
+    shadowCascadeLevels = std::vector<float>{ camera->getFar() / 150.0f, camera->getFar() / 50.0f, camera->getFar() / 18.0f, camera->getFar() / 5.0f };
+  }
+
+  // World corners of the camera frustum between two view distances
+  std::vector<glm::vec4> getSliceCorners(const float nearPlane, const float farPlane) const
+  {
+    const auto proj = glm::perspective(
+      glm::radians(camera->Zoom),
+      (float)camera->screenWidth / (float)camera->screenHeight,
+      nearPlane, farPlane
+    );
+    return camera->getFrustumCornersWorldSpace(proj, camera->GetViewMatrix());
+  }
+
 
   void draw_menu() override {
     if (ImGui::Begin(("Properties - " + name).c_str())) {
       Light::draw_menu();  // Call base class UI
-      ImGui::ColorEdit3("Light Color Diffuse", glm::value_ptr(color.diffuse));
-      ImGui::ColorEdit3("Light Color Specular", glm::value_ptr(color.specular));
-      ImGui::DragFloat3("Direction", glm::value_ptr(direction), 0.1f);
+      if (ImGui::ColorEdit3("Light Color Diffuse", glm::value_ptr(color.diffuse))) MarkDirty();
+      if (ImGui::ColorEdit3("Light Color Specular", glm::value_ptr(color.specular))) MarkDirty();
+      if (ImGui::DragFloat3("Direction", glm::value_ptr(direction), 0.1f)) MarkDirty();
     }
     ImGui::End();
   }
@@ -247,16 +339,13 @@ public:
     : Light(position, color, intensity), constant(constant), linear(linear), quadratic(quadratic) {
     camera = camera_p;
   }
-  void update(Shader* shader, int index) override {
-    std::string prefix = "pointLights[" + std::to_string(index) + "]";
-
-    shader->use();
-    shader->setVec3(prefix + ".position", transforms.position);
-    shader->setVec3(prefix + ".diffuse", color.diffuse * intensity);
-    shader->setVec3(prefix + ".specular", color.specular * intensity);
-    shader->setFloat(prefix + ".constant", constant);
-    shader->setFloat(prefix + ".linear", linear);
-    shader->setFloat(prefix + ".quadratic", quadratic);
+  void update(LightBuffer& buffer, int index) override;
+
+  void setAttenuation(float constant_v, float linear_v, float quadratic_v) {
+    constant = constant_v;
+    linear = linear_v;
+    quadratic = quadratic_v;
+    MarkDirty();
   }
 
   std::vector<glm::mat4> getLightSpaceMatrix(unsigned int shadow_resolution) {
@@ -277,11 +366,11 @@ public:
     if (ImGui::Begin(("Properties - " + name).c_str())) {
       Object::draw_menu();
       Light::draw_menu();  // Call base class UI
-      ImGui::ColorEdit3("Light Color Diffuse", glm::value_ptr(color.diffuse));
-      ImGui::ColorEdit3("Light Color Specular", glm::value_ptr(color.specular));
-      ImGui::DragFloat("Constant", &constant, 0.1f, 0.0f, 10.0f);
-      ImGui::DragFloat("Linear", &linear, 0.001f, 0.0f, 1.0f);
-      ImGui::DragFloat("Quadratic", &quadratic, 0.0001f, 0.0f, 0.1f);
+      if (ImGui::ColorEdit3("Light Color Diffuse", glm::value_ptr(color.diffuse))) MarkDirty();
+      if (ImGui::ColorEdit3("Light Color Specular", glm::value_ptr(color.specular))) MarkDirty();
+      if (ImGui::DragFloat("Constant", &constant, 0.1f, 0.0f, 10.0f)) MarkDirty();
+      if (ImGui::DragFloat("Linear", &linear, 0.001f, 0.0f, 1.0f)) MarkDirty();
+      if (ImGui::DragFloat("Quadratic", &quadratic, 0.0001f, 0.0f, 0.1f)) MarkDirty();
     }
     ImGui::End();
   }
@@ -323,24 +412,22 @@ public:
   float getOuterCutOff() const { return outerCutOff; }
 
   // Setters
-  void setDirection(const glm::vec3& dir) { direction = glm::normalize(dir); }
-  void setCutOff(float cutOffValue) { cutOff = cutOffValue; }
-  void setOuterCutOff(float outerCutOffValue) { outerCutOff = outerCutOffValue; }
-
-  void update(Shader* shader, int index) override {
-    std::string prefix = "spotLights[" + std::to_string(index) + "]";
-
-    shader->use();
-    shader->setVec3(prefix + ".position", transforms.position);
-    shader->setVec3(prefix + ".direction", direction);
-    shader->setVec3(prefix + ".diffuse", color.diffuse * intensity);
-    shader->setVec3(prefix + ".specular", color.specular * intensity);
-    shader->setFloat(prefix + ".cutOff", cutOff);
-    shader->setFloat(prefix + ".outerCutOff", outerCutOff);
-    shader->setFloat(prefix + ".constant", constant);
-    shader->setFloat(prefix + ".linear", linear);
-    shader->setFloat(prefix + ".quadratic", quadratic);
+  void setDirection(const glm::vec3& dir) {
+    glm::vec3 normalized = glm::normalize(dir);
+    if (normalized == direction) return;
+    direction = normalized;
+    MarkDirty();
+  }
+  void setCutOff(float cutOffValue) { cutOff = cutOffValue; MarkDirty(); }
+  void setOuterCutOff(float outerCutOffValue) { outerCutOff = outerCutOffValue; MarkDirty(); }
+  void setAttenuation(float constant_v, float linear_v, float quadratic_v) {
+    constant = constant_v;
+    linear = linear_v;
+    quadratic = quadratic_v;
+    MarkDirty();
   }
+
+  void update(LightBuffer& buffer, int index) override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,235 @@
+#ifndef LIGHT_BUFFER_H_
+#define LIGHT_BUFFER_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "object.h"
+#include "light.h"
+
+// Binding points of the light SSBOs in the shaders
+const unsigned int LIGHT_GLOBALS_BINDING = 6;
+const unsigned int POINT_LIGHT_BUFFER_BINDING = 7;
+const unsigned int SPOT_LIGHT_BUFFER_BINDING = 8;
+
+const unsigned int MAX_CASCADES = 16;
+
+// std430 records, must match the structs in shader.frag
+struct LightGlobalsData {
+  glm::vec3 ambient;        int numPointLights;
+  glm::vec3 dirDirection;   int numSpotLights;
+  glm::vec3 dirDiffuse;     int cascadeCount;
+  glm::vec3 dirSpecular;    float dirFarPlane;
+  float cascadePlaneDistances[MAX_CASCADES];
+};
+
+struct PointLightData {
+  glm::vec3 position;  float constant;
+  glm::vec3 diffuse;   float linear;
+  glm::vec3 specular;  float quadratic;
+  float farPlane;
+  int shadowIndex;     // -1 when the light has no shadow map
+  float radius;        // distance where the light fades out
+  float pad;
+};
+
+struct SpotLightData {
+  glm::vec3 position;  float constant;
+  glm::vec3 direction; float linear;
+  glm::vec3 diffuse;   float quadratic;
+  glm::vec3 specular;  float cutOff;
+  float outerCutOff;
+  int shadowIndex;     // -1 when the light has no shadow map
+  float radius;        // range of the cone
+  float pad;
+};
+
+static_assert(sizeof(LightGlobalsData) == 128, "LightGlobalsData must match std430 layout");
+static_assert(sizeof(PointLightData) == 64, "PointLightData must match std430 layout");
+static_assert(sizeof(SpotLightData) == 80, "SpotLightData must match std430 layout");
+
+// LIGHT BUFFER
+//=-----------------------------=
+// Packs every light of the scene into std430 SSBOs. A light's update() is
+// only called when its revision changed or it moved to another slot, and
+// only the dirty range of each buffer is uploaded.
+class LightBuffer {
+  // Tracks which light wrote each slot of one record array
+  struct Slots {
+    std::vector<const Object*> owners;
+    std::vector<unsigned int> revisions;
+    size_t dirty_begin = SIZE_MAX, dirty_end = 0;
+
+    // True when the light has to rewrite its record
+    bool Claim(size_t index, const Object* light) {
+      if (index >= owners.size()) {
+        owners.resize(index + 1, nullptr);
+        revisions.resize(index + 1, 0);
+      }
+      if (owners[index] == light && revisions[index] == light->GetRevision()) return false;
+      owners[index] = light;
+      revisions[index] = light->GetRevision();
+      dirty_begin = std::min(dirty_begin, index);
+      dirty_end = index + 1;
+      return true;
+    }
+    // Marks a record patched outside of Update
+    void Touch(size_t index) {
+      dirty_begin = std::min(dirty_begin, index);
+      dirty_end = std::max(dirty_end, index + 1);
+    }
+    void Resize(size_t count) {
+      owners.resize(count);
+      revisions.resize(count);
+    }
+    bool Dirty() const { return dirty_begin < dirty_end; }
+    void Reset() { dirty_begin = SIZE_MAX; dirty_end = 0; }
+  };
+
+  Slots global_slots_;  // 0 - ambient light, 1 - directional light
+  Slots point_slots_;
+  Slots spot_slots_;
+  bool globals_dirty_ = true;
+
+  unsigned int globals_ssbo_ = 0;
+  unsigned int point_ssbo_ = 0;
+  unsigned int spot_ssbo_ = 0;
+  size_t point_capacity_ = 0;
+  size_t spot_capacity_ = 0;
+
+public:
+  LightGlobalsData globals{};
+  std::vector<PointLightData> point_lights;
+  std::vector<SpotLightData> spot_lights;
+
+  ~LightBuffer() {
+    if (globals_ssbo_) glDeleteBuffers(1, &globals_ssbo_);
+    if (point_ssbo_) glDeleteBuffers(1, &point_ssbo_);
+    if (spot_ssbo_) glDeleteBuffers(1, &spot_ssbo_);
+  }
+
+  // Cascade splits of the directional light, uploaded right away when they
+  // change (they are known only after the light buffer update)
+  void SetCascades(float far_plane, const std::vector<float>& levels) {
+    int count = (int)std::min<size_t>(levels.size(), MAX_CASCADES);
+    bool changed = globals.dirFarPlane != far_plane || globals.cascadeCount != count;
+    for (int i = 0; i < count; i++) changed |= globals.cascadePlaneDistances[i] != levels[i];
+    if (!changed) return;
+    globals.dirFarPlane = far_plane;
+    globals.cascadeCount = count;
+    for (int i = 0; i < count; i++) globals.cascadePlaneDistances[i] = levels[i];
+    globals_dirty_ = true;
+    if (globals_ssbo_) {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, globals_ssbo_);
+      glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(LightGlobalsData), &globals);
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+      globals_dirty_ = false;
+    }
+  }
+
+  // Shadow tiles are placed after Update: the records whose tile changed
+  // are patched, then UploadShadows sends the patched ranges
+  void SetPointShadow(size_t light, int shadow_index) {
+    if (point_lights[light].shadowIndex == shadow_index) return;
+    point_lights[light].shadowIndex = shadow_index;
+    point_slots_.Touch(light);
+  }
+  void SetSpotShadow(size_t light, int shadow_index) {
+    if (spot_lights[light].shadowIndex == shadow_index) return;
+    spot_lights[light].shadowIndex = shadow_index;
+    spot_slots_.Touch(light);
+  }
+  void UploadShadows() {
+    if (point_slots_.Dirty()) Upload(point_ssbo_, point_capacity_, point_lights, point_slots_);
+    if (spot_slots_.Dirty()) Upload(spot_ssbo_, spot_capacity_, spot_lights, spot_slots_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+
+  void Update(const std::vector<Object*>& objects) {
+    size_t points = 0, spots = 0;
+    bool has_ambient = false, has_directional = false;
+
+    for (auto obj : objects) {
+      if (auto light = dynamic_cast<PointLight*>(obj)) {
+        if (point_slots_.Claim(points, light)) {
+          point_lights.resize(std::max(point_lights.size(), points + 1));
+          light->update(*this, (int)points);
+        }
+        points++;
+      }
+      else if (auto light = dynamic_cast<SpotLight*>(obj)) {
+        if (spot_slots_.Claim(spots, light)) {
+          spot_lights.resize(std::max(spot_lights.size(), spots + 1));
+          light->update(*this, (int)spots);
+        }
+        spots++;
+      }
+      else if (auto light = dynamic_cast<AmbientLight*>(obj)) {
+        // Only the first ambient and directional lights are used
+        if (has_ambient) continue;
+        has_ambient = true;
+        if (global_slots_.Claim(0, light)) light->update(*this, 0);
+      }
+      else if (auto light = dynamic_cast<DirectionalLight*>(obj)) {
+        if (has_directional) continue;
+        has_directional = true;
+        if (global_slots_.Claim(1, light)) light->update(*this, 0);
+      }
+    }
+    point_lights.resize(points);
+    spot_lights.resize(spots);
+    point_slots_.Resize(points);
+    spot_slots_.Resize(spots);
+
+    if (globals.numPointLights != (int)points || globals.numSpotLights != (int)spots) {
+      globals.numPointLights = (int)points;
+      globals.numSpotLights = (int)spots;
+      globals_dirty_ = true;
+    }
+    globals_dirty_ |= global_slots_.Dirty();
+
+    if (!globals_ssbo_) {
+      glGenBuffers(1, &globals_ssbo_);
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, globals_ssbo_);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(LightGlobalsData), nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (globals_dirty_) {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, globals_ssbo_);
+      glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(LightGlobalsData), &globals);
+      globals_dirty_ = false;
+    }
+    Upload(point_ssbo_, point_capacity_, point_lights, point_slots_);
+    Upload(spot_ssbo_, spot_capacity_, spot_lights, spot_slots_);
+    global_slots_.Reset();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_GLOBALS_BINDING, globals_ssbo_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POINT_LIGHT_BUFFER_BINDING, point_ssbo_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SPOT_LIGHT_BUFFER_BINDING, spot_ssbo_);
+  }
+
+private:
+  // Grows the buffer when needed, otherwise uploads the dirty range only
+  template<typename T>
+  static void Upload(unsigned int& ssbo, size_t& capacity, const std::vector<T>& records, Slots& slots) {
+    if (!ssbo) glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    if (capacity < records.size() || !capacity) {
+      capacity = std::max<size_t>(records.size() * 2, 16);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+      if (!records.empty()) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, records.size() * sizeof(T), records.data());
+    }
+    else if (slots.Dirty() && slots.dirty_begin < records.size()) {
+      size_t end = std::min(slots.dirty_end, records.size());
+      glBufferSubData(GL_SHADER_STORAGE_BUFFER, slots.dirty_begin * sizeof(T),
+                      (end - slots.dirty_begin) * sizeof(T), &records[slots.dirty_begin]);
+    }
+    slots.Reset();
+  }
+};
+
+#endif
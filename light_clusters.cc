@@ -0,0 +1,277 @@
+#include "light_clusters.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Bounds of the padding entries, never inside any sphere
+static const float kEmptyBound = 1e18f;
+
+// Below this many light/cluster pairs waking the workers costs more than it saves
+static const size_t kThreadingThreshold = 1 << 16;
+
+// LIGHT RADIUS
+//=-----------------------------=
+float AttenuationRadius(float constant, float linear, float quadratic, float brightness) {
+  // constant + linear * d + quadratic * d^2 = brightness / LIGHT_CUTOFF
+  float c = constant - brightness / LIGHT_CUTOFF;
+  if (c >= 0.0f) return 0.0f;
+  if (quadratic > 0.0f) {
+    float discriminant = linear * linear - 4.0f * quadratic * c;
+    return (-linear + std::sqrt(discriminant)) / (2.0f * quadratic);
+  }
+  if (linear > 0.0f) return -c / linear;
+  return std::numeric_limits<float>::max();
+}
+
+ClusterLight SpotBoundingSphere(const glm::vec3& position, const glm::vec3& direction,
+                                float range, float cos_angle) {
+  glm::vec3 dir = glm::normalize(direction);
+  cos_angle = glm::clamp(cos_angle, 1e-4f, 1.0f);
+  // Wide cones: the sphere around the cap base, narrow ones: the
+  // circumsphere through the apex and the cap rim
+  if (cos_angle < 0.70710678f) {
+    float sin_angle = std::sqrt(1.0f - cos_angle * cos_angle);
+    return { position + dir * (cos_angle * range), sin_angle * range };
+  }
+  float radius = range / (2.0f * cos_angle);
+  return { position + dir * radius, radius };
+}
+
+// WORKER POOL
+//=-----------------------------=
+LightClusters::~LightClusters() {
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    quit_ = true;
+  }
+  work_ready_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+void LightClusters::RunJob(unsigned int threads, const std::function<void(unsigned int)>& job) {
+  // Workers start with the current generation, so they wait for the next job
+  while (workers_.size() + 1 < threads) {
+    unsigned int index = (unsigned int)workers_.size() + 1;
+    workers_.emplace_back(&LightClusters::WorkerLoop, this, index, generation_);
+  }
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    job_ = &job;
+    job_threads_ = threads;
+    job_pending_ = threads - 1;
+    generation_++;
+  }
+  work_ready_.notify_all();
+  job(0);
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  work_done_.wait(lock, [this]() { return job_pending_ == 0; });
+}
+
+void LightClusters::WorkerLoop(unsigned int index, unsigned int generation) {
+  PROFILE_THREAD("Light clusters");
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  while (true) {
+    work_ready_.wait(lock, [&]() { return quit_ || generation_ != generation; });
+    if (quit_) return;
+    generation = generation_;
+    if (index >= job_threads_) continue;
+    lock.unlock();
+    (*job_)(index);
+    lock.lock();
+    if (--job_pending_ == 0) work_done_.notify_one();
+  }
+}
+
+// LIGHT CLUSTERS
+//=-----------------------------=
+void LightClusters::SetGrid(unsigned int x, unsigned int y, unsigned int z) {
+  x = std::max(x, 1u);
+  y = std::max(y, 1u);
+  z = std::max(z, 1u);
+  if (x == grid_x_ && y == grid_y_ && z == grid_z_) return;
+  grid_x_ = x;
+  grid_y_ = y;
+  grid_z_ = z;
+  far_ = 0.0f;  // rebuild the bounds on the next Build
+}
+
+void LightClusters::BuildBounds(const glm::mat4& projection, float near_plane, float far_plane) {
+  projection_ = projection;
+  near_ = near_plane;
+  far_ = far_plane;
+
+  size_t tiles = (size_t)grid_x_ * grid_y_;
+  slice_stride_ = (tiles + 3) & ~(size_t)3;
+  size_t total = slice_stride_ * grid_z_;
+  for (auto bounds : { &min_x_, &min_y_, &min_z_ }) bounds->assign(total, kEmptyBound);
+  for (auto bounds : { &max_x_, &max_y_, &max_z_ }) bounds->assign(total, kEmptyBound);
+
+  // Exponential slices keep clusters roughly cubic along the view ray
+  slice_near_.resize(grid_z_ + 1);
+  for (unsigned int z = 0; z <= grid_z_; z++) {
+    slice_near_[z] = near_plane * std::pow(far_plane / near_plane, (float)z / grid_z_);
+  }
+
+  // Tile corners on the near plane, each one is a ray from the eye
+  glm::mat4 inverse = glm::inverse(projection);
+  std::vector<glm::vec3> rays((grid_x_ + 1) * (grid_y_ + 1));
+  for (unsigned int y = 0; y <= grid_y_; y++) {
+    for (unsigned int x = 0; x <= grid_x_; x++) {
+      glm::vec4 p = inverse * glm::vec4(-1.0f + 2.0f * x / grid_x_, -1.0f + 2.0f * y / grid_y_, -1.0f, 1.0f);
+      glm::vec3 v = glm::vec3(p) / p.w;
+      rays[y * (grid_x_ + 1) + x] = v / -v.z;  // point at view depth 1
+    }
+  }
+
+  for (unsigned int z = 0; z < grid_z_; z++) {
+    float depths[2] = { slice_near_[z], slice_near_[z + 1] };
+    for (unsigned int y = 0; y < grid_y_; y++) {
+      for (unsigned int x = 0; x < grid_x_; x++) {
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(-std::numeric_limits<float>::max());
+        for (unsigned int corner = 0; corner < 4; corner++) {
+          const glm::vec3& ray = rays[(y + (corner >> 1)) * (grid_x_ + 1) + x + (corner & 1)];
+          for (float depth : depths) {
+            lo = glm::min(lo, ray * depth);
+            hi = glm::max(hi, ray * depth);
+          }
+        }
+        size_t i = z * slice_stride_ + y * grid_x_ + x;
+        min_x_[i] = lo.x; min_y_[i] = lo.y; min_z_[i] = lo.z;
+        max_x_[i] = hi.x; max_y_[i] = hi.y; max_z_[i] = hi.z;
+      }
+    }
+  }
+}
+
+void LightClusters::Build(const glm::mat4& view, const glm::mat4& projection, float near_plane, float far_plane,
+                          const std::vector<ClusterLight>& points, const std::vector<ClusterLight>& spots) {
+  if (far_ != far_plane || near_ != near_plane || projection_ != projection) {
+    BuildBounds(projection, near_plane, far_plane);
+  }
+
+  // Light spheres in view space
+  std::vector<glm::vec4> view_points(points.size()), view_spots(spots.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    view_points[i] = glm::vec4(glm::vec3(view * glm::vec4(points[i].position, 1.0f)), points[i].radius);
+  }
+  for (size_t i = 0; i < spots.size(); i++) {
+    view_spots[i] = glm::vec4(glm::vec3(view * glm::vec4(spots[i].position, 1.0f)), spots[i].radius);
+  }
+
+  size_t count = cluster_count();
+  point_counts_.assign(count, 0);
+  spot_counts_.assign(count, 0);
+  point_scratch_.resize(count * MAX_LIGHTS_PER_CLUSTER);
+  spot_scratch_.resize(count * MAX_LIGHTS_PER_CLUSTER);
+
+  // Every thread owns a range of depth slices, so no cluster is shared
+  unsigned int threads = threads_ ? threads_ : std::max(std::thread::hardware_concurrency(), 1u);
+  threads = std::min(threads, grid_z_);
+  if ((points.size() + spots.size()) * count < kThreadingThreshold) threads = 1;
+
+  std::vector<size_t> dropped(threads, 0);
+  auto bin = [&](unsigned int t) {
+    dropped[t] = BinSlices(grid_z_ * t / threads, grid_z_ * (t + 1) / threads, view_points, view_spots);
+  };
+  if (threads > 1) RunJob(threads, bin);
+  else bin(0);
+
+  dropped_ = 0;
+  for (size_t d : dropped) dropped_ += d;
+
+  // Compact the scratch lists into one index list
+  clusters_.resize(count);
+  indices_.clear();
+  for (size_t i = 0; i < count; i++) {
+    const unsigned int* point_list = &point_scratch_[i * MAX_LIGHTS_PER_CLUSTER];
+    const unsigned int* spot_list = &spot_scratch_[i * MAX_LIGHTS_PER_CLUSTER];
+    clusters_[i] = { (unsigned int)indices_.size(), point_counts_[i], spot_counts_[i], 0 };
+    indices_.insert(indices_.end(), point_list, point_list + point_counts_[i]);
+    indices_.insert(indices_.end(), spot_list, spot_list + spot_counts_[i]);
+  }
+}
+
+size_t LightClusters::BinSlices(unsigned int z_begin, unsigned int z_end,
+                                const std::vector<glm::vec4>& points, const std::vector<glm::vec4>& spots) {
+  PROFILE_SCOPE("LightClusters::BinSlices");
+  size_t dropped = 0;
+  float log_scale = grid_z_ / std::log(far_ / near_);
+
+  auto bin = [&](const std::vector<glm::vec4>& lights,
+                 std::vector<unsigned int>& scratch, std::vector<unsigned int>& counts) {
+    for (unsigned int i = 0; i < lights.size(); i++) {
+      const glm::vec4& sphere = lights[i];
+      float depth_min = -sphere.z - sphere.w;
+      float depth_max = -sphere.z + sphere.w;
+      if (depth_max < near_ || depth_min > far_) continue;
+
+      // Slices touched by the sphere's depth range
+      unsigned int z_lo = depth_min <= near_ ? 0u
+        : (unsigned int)std::min<float>(std::log(depth_min / near_) * log_scale, (float)grid_z_ - 1);
+      unsigned int z_hi = depth_max >= far_ ? grid_z_ - 1
+        : (unsigned int)std::min<float>(std::log(depth_max / near_) * log_scale, (float)grid_z_ - 1);
+
+      for (unsigned int z = std::max(z_lo, z_begin); z <= z_hi && z < z_end; z++) {
+        dropped += BinLight(z, i, sphere, scratch, counts);
+      }
+    }
+  };
+  bin(points, point_scratch_, point_counts_);
+  bin(spots, spot_scratch_, spot_counts_);
+  return dropped;
+}
+
+size_t LightClusters::BinLight(unsigned int z, unsigned int light, const glm::vec4& sphere,
+                               std::vector<unsigned int>& scratch, std::vector<unsigned int>& counts) {
+  size_t dropped = 0;
+  size_t base = z * slice_stride_;
+  size_t first_cluster = (size_t)z * grid_x_ * grid_y_;
+  size_t tiles = (size_t)grid_x_ * grid_y_;
+
+  auto append = [&](size_t tile) {
+    size_t cluster = first_cluster + tile;
+    if (counts[cluster] < MAX_LIGHTS_PER_CLUSTER) {
+      scratch[cluster * MAX_LIGHTS_PER_CLUSTER + counts[cluster]++] = light;
+    }
+    else dropped++;
+  };
+
+  // Squared distance from the sphere center to each AABB against radius^2
+#ifdef LIGHT_CLUSTERS_SSE
+  const __m128 cx = _mm_set1_ps(sphere.x);
+  const __m128 cy = _mm_set1_ps(sphere.y);
+  const __m128 cz = _mm_set1_ps(sphere.z);
+  const __m128 r2 = _mm_set1_ps(sphere.w * sphere.w);
+  const __m128 zero = _mm_setzero_ps();
+  for (size_t i = 0; i < tiles; i += 4) {
+    __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_x_[base + i]), cx), zero),
+                           _mm_max_ps(_mm_sub_ps(cx, _mm_loadu_ps(&max_x_[base + i])), zero));
+    __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_y_[base + i]), cy), zero),
+                           _mm_max_ps(_mm_sub_ps(cy, _mm_loadu_ps(&max_y_[base + i])), zero));
+    __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_z_[base + i]), cz), zero),
+                           _mm_max_ps(_mm_sub_ps(cz, _mm_loadu_ps(&max_z_[base + i])), zero));
+    __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    int mask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+    for (int lane = 0; mask; lane++, mask >>= 1) {
+      if ((mask & 1) && i + lane < tiles) append(i + lane);
+    }
+  }
+#else
+  const float r2 = sphere.w * sphere.w;
+  for (size_t i = 0; i < tiles; i++) {
+    float dx = std::max(min_x_[base + i] - sphere.x, 0.0f) + std::max(sphere.x - max_x_[base + i], 0.0f);
+    float dy = std::max(min_y_[base + i] - sphere.y, 0.0f) + std::max(sphere.y - max_y_[base + i], 0.0f);
+    float dz = std::max(min_z_[base + i] - sphere.z, 0.0f) + std::max(sphere.z - max_z_[base + i], 0.0f);
+    if (dx * dx + dy * dy + dz * dz <= r2) append(i);
+  }
+#endif
+  return dropped;
+}
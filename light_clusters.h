@@ -0,0 +1,123 @@
+#ifndef LIGHT_CLUSTERS_H_
+#define LIGHT_CLUSTERS_H_
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Binding points of the cluster SSBOs in the shaders
+const unsigned int LIGHT_CLUSTER_BINDING = 9;
+const unsigned int LIGHT_INDEX_BINDING = 10;
+
+// Lights stored in one cluster, the rest is dropped (per light type)
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+
+// Attenuation below this is treated as no light (about 1/256 of full range)
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// Distance where constant + linear * d + quadratic * d^2 reaches
+// brightness / LIGHT_CUTOFF, used as the radius of influence of a light
+float AttenuationRadius(float constant, float linear, float quadratic, float brightness);
+
+// Bounding sphere of a light volume in world space
+struct ClusterLight {
+  glm::vec3 position;
+  float radius;
+};
+
+// Tight bounding sphere of a spot light cone (cos_angle - cosine of the outer cone)
+ClusterLight SpotBoundingSphere(const glm::vec3& position, const glm::vec3& direction,
+                                float range, float cos_angle);
+
+// Per-cluster header, std430 (must match the LightClusters block in shader.frag)
+struct ClusterData {
+  unsigned int offset;       // first entry in the index list
+  unsigned int point_count;  // point light indices start at offset
+  unsigned int spot_count;   // spot light indices follow the point lights
+  unsigned int pad;
+};
+
+// LIGHT CLUSTERS
+//=-----------------------------=
+// Splits the view frustum into grid_x * grid_y screen tiles and grid_z
+// exponential depth slices and bins light spheres into them. Cluster
+// bounds are rebuilt only when the projection changes, binning runs on
+// worker threads split over depth slices and tests four clusters at once
+// with SSE. The result is plain data, uploading it is up to the caller.
+// The workers are started on the first Build that needs them and sleep
+// between builds until the object is destroyed.
+class LightClusters {
+  unsigned int grid_x_ = 16, grid_y_ = 9, grid_z_ = 24;
+  unsigned int threads_ = 0;  // 0 - hardware concurrency
+
+  // Worker pool, worker t runs job(t) for t < job_threads_, the caller
+  // runs job(0). Everything below the mutex is guarded by it.
+  std::vector<std::thread> workers_;
+  std::mutex pool_mutex_;
+  std::condition_variable work_ready_, work_done_;
+  const std::function<void(unsigned int)>* job_ = nullptr;
+  unsigned int job_threads_ = 0;
+  unsigned int job_pending_ = 0;
+  unsigned int generation_ = 0;  // bumped for every job
+  bool quit_ = false;
+
+  // Projection the bounds were built for
+  glm::mat4 projection_ = glm::mat4(0.0f);
+  float near_ = 0.0f, far_ = 0.0f;
+
+  // View-space AABBs of the clusters of one slice, SoA and padded to a
+  // multiple of 4 for the SIMD test, slice after slice
+  size_t slice_stride_ = 0;
+  std::vector<float> min_x_, min_y_, min_z_, max_x_, max_y_, max_z_;
+  std::vector<float> slice_near_;  // view depth where each slice starts, grid_z + 1 entries
+
+  // Scratch lists, MAX_LIGHTS_PER_CLUSTER entries per cluster
+  std::vector<unsigned int> point_scratch_, spot_scratch_;
+  std::vector<unsigned int> point_counts_, spot_counts_;
+
+  std::vector<ClusterData> clusters_;
+  std::vector<unsigned int> indices_;
+  size_t dropped_ = 0;
+
+public:
+  LightClusters() = default;
+  ~LightClusters();
+  LightClusters(const LightClusters&) = delete;
+  LightClusters& operator=(const LightClusters&) = delete;
+
+  void SetGrid(unsigned int x, unsigned int y, unsigned int z);
+  void SetThreads(unsigned int threads) { threads_ = threads; }
+
+  unsigned int grid_x() const { return grid_x_; }
+  unsigned int grid_y() const { return grid_y_; }
+  unsigned int grid_z() const { return grid_z_; }
+  size_t cluster_count() const { return (size_t)grid_x_ * grid_y_ * grid_z_; }
+
+  // Bins the lights, indices in the lists refer to positions in points/spots
+  void Build(const glm::mat4& view, const glm::mat4& projection, float near_plane, float far_plane,
+             const std::vector<ClusterLight>& points, const std::vector<ClusterLight>& spots);
+
+  // Cluster x, y, z is at (z * grid_y + y) * grid_x + x
+  const std::vector<ClusterData>& clusters() const { return clusters_; }
+  const std::vector<unsigned int>& indices() const { return indices_; }
+  // Light references lost to MAX_LIGHTS_PER_CLUSTER in the last Build
+  size_t dropped() const { return dropped_; }
+
+private:
+  // Runs job(0) ... job(threads - 1) in parallel and waits for all of them
+  void RunJob(unsigned int threads, const std::function<void(unsigned int)>& job);
+  void WorkerLoop(unsigned int index, unsigned int generation);
+
+  void BuildBounds(const glm::mat4& projection, float near_plane, float far_plane);
+  // Returns the number of dropped light references
+  size_t BinSlices(unsigned int z_begin, unsigned int z_end,
+                   const std::vector<glm::vec4>& points, const std::vector<glm::vec4>& spots);
+  size_t BinLight(unsigned int z, unsigned int light, const glm::vec4& sphere,
+                  std::vector<unsigned int>& scratch, std::vector<unsigned int>& counts);
+};
+
+#endif
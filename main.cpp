@@ -6,112 +6,79 @@
 #include "window.h"
 #include "input_handler.h"
 #include "renderer.h"
+#include "default_scene.h"
+#include "stress_scene.h"
 
 // standart libraries
 #include <iostream>
 #include <string.h>
+#include <cstdlib>
 #include <vector>
 
-Model* createPlaneModel(const std::string& textureFile, const std::string& path) {
-  vector<Vertex> vertices = {
-    // Positions          // Normals        // Texture Coords
-    {{-0.5f, 0.0f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}}, // Bottom-left
-    {{0.5f, 0.0f, -0.5f},  {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}}, // Bottom-right
-    {{0.5f, 0.0f, 0.5f},   {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}}, // Top-right
-    {{-0.5f, 0.0f, 0.5f},  {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}}  // Top-left
-  };
-
-  vector<unsigned int> indices = {
-      2, 1, 0, // First triangle
-      0, 3, 2 // Second triangle
-  };
-
-  vector<Texture> textures;
-  Texture texture;
-  texture.id = TextureFromFile(textureFile.c_str(), path.c_str()); // Load texture
-  texture.type = "texture_diffuse";
-  texture.path = textureFile;
-  textures.push_back(texture);
-
-  return new Model(Mesh(vertices, indices, textures));
-}
+int main(int argc, char** argv) {
+  // --capture N: CPU trace of startup (asset loading) and the first N
+  // frames, N is also the length of the F9 captures
+  unsigned int capture_frames = 0;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--capture") == 0) capture_frames = (unsigned int)std::strtoul(argv[i + 1], nullptr, 10);
+  }
+  // --stress-*: procedural models and lights on top of the default scene
+  StressSceneOptions stress_options;
+  for (int i = 1; i < argc; i++) {
+    int used = ParseStressSceneArg(argc, argv, i, stress_options);
+    if (used > 0) i += used - 1;
+  }
+  PROFILE_THREAD("Main");
+  if (capture_frames) {
+    profiler::RequestCapture(capture_frames + 1);
+    PROFILE_FRAME();
+  }
 
-int main() {
   Window window(4, 5);
   InputHandler input_handler;
   window.SetInputHandler(&input_handler);
+  if (capture_frames) input_handler.SetProfilerCaptureFrames(capture_frames);
 
   Scene scene;
   input_handler.SetScene(&scene);
 
-  // Adding camera object
-  Camera* camera = scene.AddCamera(glm::vec3(0.0f, 0.0f, 3.0f));
-
-  // Adding ambient light object
-  AmbientLight* ambientLight = scene.AddAmbientLight(glm::vec3(0.3f, 0.3f, 0.3f));
-
-  // Add directional light to scene
-  DirectionalLight* directionLight = scene.AddDirectionalLight(camera, glm::vec3(-0.2f, -0.5f, -0.3f), "Sun");
-
-  // Create point lights and add to scene
-  PointLight* pointLight = scene.AddPointLight(camera, glm::vec3(3.0f, 2.0f, 2.0f));
-  //pointLight->setIntensity(1.0f);
-
-  //PointLight* pointLight1 = scene.AddPointLight(camera, glm::vec3(2.0f, 2.0f, 2.0f));
-
-  //PointLight* pointLight2 = scene.AddPointLight(camera, glm::vec3(1.0f, 2.0f, 2.0f));
-
-  SpotLight* spotLight = scene.AddSpotLight("Flashlight");
-
-  // Set path to cube object
-  char path_cube[] = "resources/models/default/CUBE/default_cube.obj";
-
-  // Add first cube to scene
-  Model* default_cube_1 = scene.AddModel(path_cube, "Default_cube1");
-  default_cube_1->setSelection(false);
-  default_cube_1->setPosition(glm::vec3(0.0f, 0.0f, 0.0f));
-  default_cube_1->scale_texture = true;
-
-  // Add second cube to scene
-  Model* default_cube_2 = scene.AddModel(path_cube, "Default_cube2");
-  default_cube_2->setSelection(false);
-  default_cube_2->setPosition(glm::vec3(3.0f, 2.0f, 0.0f));
-  default_cube_2->scale_texture = true;
-
-  // Add plane to scene
-  Model* plane = createPlaneModel("concrete_diffuse.png", "resources/textures/default");
-  scene.AddModel(plane, "Plane");
-  plane->setSelection(false);
-  plane->setPosition(glm::vec3(1.5f, -1.0001f, 0.0f));
-  plane->setSize(glm::vec3(20.0f));
-  plane->scale_texture = true;
-
-  // Add Skybox to scene
-  Skybox* skybox = scene.AddSkybox();
-
-  char path[] = "resources/models/backpack/backpack.obj";
-  Model* backpack = scene.AddModel(path);
-  backpack->setPosition(glm::vec3(-3.0, 1.0, 1.0));
+  DefaultScene default_scene = BuildDefaultScene(scene);
+  Camera* camera = default_scene.camera;
+  SpotLight* spotLight = default_scene.flashlight;
+  StressScene stress_scene;
+  if (stress_options.enabled()) stress_scene.Build(scene, camera, stress_options);
 
   unsigned int light_texture = TextureFromFile("lightb.png", "resources/textures/default");
 
   // Setting up the renderer
   Renderer renderer(&window, &scene);
 
+  // --stats-log FILE: per-frame stats for soak tests, .json for JSON lines, CSV otherwise
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], "--stats-log") == 0 && !renderer.stats_logger_.Open(argv[i + 1]))
+      std::cout << "Could not open " << argv[i + 1] << std::endl;
+  }
+
   camera->screenHeight = window.GetScreenHeight();
   camera->screenWidth = window.GetScreenWidth();
   // RENDER LOOP
   // =--------------------------------------------------=
   while (!glfwWindowShouldClose(window.GetWindowPTR())) {
+    PROFILE_FRAME();
+
     // INITIAL PARAMETERS
     //=------------------=
     spotLight->setPosition(camera->getPosition());
     spotLight->setDirection(camera->Front);
+    stress_scene.Animate((float)glfwGetTime());
 
     // INPUT HANDLING
     //=-------------=
-    input_handler.processInput(window.GetWindowPTR(), renderer.deltaTime);
-    input_handler.toggle_flashlight(window.GetWindowPTR(), *spotLight);
+    {
+      PROFILE_SCOPE("Input");
+      input_handler.processInput(window.GetWindowPTR(), renderer.deltaTime);
+      input_handler.toggle_flashlight(window.GetWindowPTR(), *spotLight);
+    }
 
 
     // RENDER_SCENE
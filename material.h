@@ -0,0 +1,173 @@
+#ifndef MATERIAL_H_
+#define MATERIAL_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Binding point of the Materials SSBO in the shaders
+const unsigned int MATERIAL_BUFFER_BINDING = 4;
+
+// Texture units of the binding table (layout(binding = N) in shader.frag)
+enum MaterialTextureSlot {
+  MATERIAL_TEXTURE_DIFFUSE = 0,
+  MATERIAL_TEXTURE_SPECULAR = 1,
+  MATERIAL_TEXTURE_COUNT
+};
+
+// Material constants on the GPU, std430 (must match MaterialData in the shaders)
+struct MaterialData {
+  glm::vec4 diffuse;   // rgb - diffuse
+  glm::vec4 specular;  // rgb - specular, a - shininess
+};
+
+// MATERIAL CLASS
+//=-----------------------------=
+// Shared material asset. Constants live in a slot of the material buffer
+// (slot == id) and textures in a prebuilt binding table, so binding a
+// material is a single glBindTextures call.
+class Material {
+  friend class MaterialLibrary;
+
+  unsigned int id_ = 0;
+  bool dirty_ = true;
+  glm::vec3 diffuse_ = glm::vec3(1.0f);
+  glm::vec3 specular_ = glm::vec3(1.0f);
+  float shininess_ = 128.0f;
+  std::array<unsigned int, MATERIAL_TEXTURE_COUNT> textures_{};
+
+public:
+  unsigned int GetID() const { return id_; }
+
+  glm::vec3 getDiffuse() const { return diffuse_; }
+  glm::vec3 getSpecular() const { return specular_; }
+  float getShininess() const { return shininess_; }
+  unsigned int getTexture(MaterialTextureSlot slot) const { return textures_[slot]; }
+
+  void setDiffuse(const glm::vec3& diffuse) { diffuse_ = diffuse; dirty_ = true; }
+  void setSpecular(const glm::vec3& specular) { specular_ = specular; dirty_ = true; }
+  void setShininess(float shininess) { shininess_ = shininess; dirty_ = true; }
+
+  void Bind() const {
+    glBindTextures(0, MATERIAL_TEXTURE_COUNT, textures_.data());
+  }
+
+  MaterialData GetData() const {
+    return { glm::vec4(diffuse_, 0.0f), glm::vec4(specular_, shininess_) };
+  }
+};
+
+// MATERIAL LIBRARY
+//=-----------------------------=
+// Owns every material. Meshes with the same textures share one material,
+// per-instance overrides are clones with their own constants slot.
+class MaterialLibrary {
+  std::vector<std::unique_ptr<Material>> materials_;  // indexed by id
+  std::vector<unsigned int> free_ids_;
+  std::map<std::pair<unsigned int, unsigned int>, Material*> shared_;
+
+  unsigned int ssbo_ = 0;
+  size_t capacity_ = 0;
+
+public:
+  static MaterialLibrary& Get() {
+    static MaterialLibrary library;
+    return library;
+  }
+
+  // Shared material for a diffuse/specular texture pair
+  Material* GetShared(unsigned int diffuse_texture, unsigned int specular_texture) {
+    auto key = std::make_pair(diffuse_texture, specular_texture);
+    auto it = shared_.find(key);
+    if (it != shared_.end()) return it->second;
+
+    Material* material = Allocate();
+    material->textures_[MATERIAL_TEXTURE_DIFFUSE] = diffuse_texture;
+    material->textures_[MATERIAL_TEXTURE_SPECULAR] = specular_texture;
+    shared_[key] = material;
+    return material;
+  }
+
+  // Per-instance override: same textures, own constants
+  Material* Clone(const Material* base) {
+    Material* material = Allocate();
+    material->diffuse_ = base->diffuse_;
+    material->specular_ = base->specular_;
+    material->shininess_ = base->shininess_;
+    material->textures_ = base->textures_;
+    return material;
+  }
+
+  void Release(Material* material) {
+    if (!material) return;
+    for (auto it = shared_.begin(); it != shared_.end(); ++it) {
+      if (it->second == material) {
+        shared_.erase(it);
+        break;
+      }
+    }
+    unsigned int id = material->id_;
+    materials_[id].reset();
+    free_ids_.push_back(id);
+  }
+
+  size_t size() const { return materials_.size(); }
+
+  // Uploads constants of materials changed since the last call
+  void Update() {
+    if (!ssbo_) glGenBuffers(1, &ssbo_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo_);
+
+    bool reallocate = capacity_ < materials_.size() || !capacity_;
+    if (reallocate) {
+      capacity_ = std::max<size_t>(materials_.size() * 2, 64);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof(MaterialData), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    size_t dirty_begin = materials_.size(), dirty_end = 0;
+    for (size_t i = 0; i < materials_.size(); i++) {
+      if (materials_[i] && (materials_[i]->dirty_ || reallocate)) {
+        dirty_begin = std::min(dirty_begin, i);
+        dirty_end = i + 1;
+      }
+    }
+    if (dirty_begin < dirty_end) {
+      std::vector<MaterialData> data(dirty_end - dirty_begin, MaterialData{});
+      for (size_t i = dirty_begin; i < dirty_end; i++) {
+        if (!materials_[i]) continue;
+        data[i - dirty_begin] = materials_[i]->GetData();
+        materials_[i]->dirty_ = false;
+      }
+      glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirty_begin * sizeof(MaterialData),
+                      data.size() * sizeof(MaterialData), data.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, ssbo_);
+  }
+
+private:
+  MaterialLibrary() = default;
+
+  Material* Allocate() {
+    unsigned int id;
+    if (!free_ids_.empty()) {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    }
+    else {
+      id = (unsigned int)materials_.size();
+      materials_.emplace_back();
+    }
+    materials_[id] = std::make_unique<Material>();
+    materials_[id]->id_ = id;
+    return materials_[id].get();
+  }
+};
+
+#endif
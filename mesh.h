@@ -6,10 +6,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "material.h"
+
 using std::string, std::vector, std::cout, std::endl;
 
 struct Vertex {
@@ -24,17 +28,138 @@ struct Texture {
   string path;
 };
 
+// DRAW INDEX BUFFER
+//=-----------------------------=
+// Vertex attribute 3 of every mesh is fed from this identity buffer
+// (0, 1, 2, ...) with divisor 1. A draw issued with baseInstance = N and one
+// instance therefore reads aDrawIndex = N, which the shaders use to fetch the
+// per-draw record (object and material) without any per-draw uniforms.
+class DrawIndexBuffer {
+public:
+  static unsigned int Get() {
+    Reserve(1024);
+    return buffer();
+  }
+
+  // Grows the buffer in place, VAOs keep referencing the same buffer name
+  static void Reserve(unsigned int count) {
+    if (count <= capacity()) return;
+    unsigned int new_capacity = capacity() ? capacity() : 1024;
+    while (new_capacity < count) new_capacity *= 2;
+
+    vector<unsigned int> indices(new_capacity);
+    for (unsigned int i = 0; i < new_capacity; i++) indices[i] = i;
+
+    if (!buffer()) glGenBuffers(1, &buffer());
+    glBindBuffer(GL_ARRAY_BUFFER, buffer());
+    glBufferData(GL_ARRAY_BUFFER, new_capacity * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    capacity() = new_capacity;
+  }
+
+private:
+  static unsigned int& buffer() { static unsigned int id = 0; return id; }
+  static unsigned int& capacity() { static unsigned int count = 0; return count; }
+};
+
+// GEOMETRY POOL
+//=-----------------------------=
+// Vertices and indices of every mesh live in one vertex and one index
+// buffer behind a single VAO, so a whole pass can be issued as
+// multi-draw-indirect commands. A mesh addresses its range with
+// firstIndex and baseVertex.
+class GeometryPool {
+  unsigned int vao_ = 0, vbo_ = 0, ebo_ = 0;
+  size_t vertex_count_ = 0, vertex_capacity_ = 0;
+  size_t index_count_ = 0, index_capacity_ = 0;
+
+public:
+  struct Range {
+    unsigned int first_index;
+    int base_vertex;
+  };
+
+  static GeometryPool& Get() {
+    static GeometryPool pool;
+    return pool;
+  }
+
+  unsigned int vao() {
+    Init();
+    return vao_;
+  }
+
+  Range Add(const vector<Vertex>& vertices, const vector<unsigned int>& indices) {
+    Init();
+    Grow(vbo_, vertex_capacity_, vertex_count_, vertex_count_ + vertices.size(), sizeof(Vertex));
+    Grow(ebo_, index_capacity_, index_count_, index_count_ + indices.size(), sizeof(unsigned int));
+    glVertexArrayVertexBuffer(vao_, 0, vbo_, 0, sizeof(Vertex));
+    glVertexArrayElementBuffer(vao_, ebo_);
+
+    if (!vertices.empty())
+      glNamedBufferSubData(vbo_, vertex_count_ * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+    if (!indices.empty())
+      glNamedBufferSubData(ebo_, index_count_ * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+
+    Range range = { (unsigned int)index_count_, (int)vertex_count_ };
+    vertex_count_ += vertices.size();
+    index_count_ += indices.size();
+    return range;
+  }
+
+private:
+  GeometryPool() = default;
+
+  void Init() {
+    if (vao_) return;
+    glCreateVertexArrays(1, &vao_);
+    // vertex positions, normals, texture coords
+    glVertexArrayAttribFormat(vao_, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
+    glVertexArrayAttribFormat(vao_, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
+    glVertexArrayAttribFormat(vao_, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords));
+    for (unsigned int attrib = 0; attrib < 3; attrib++) {
+      glVertexArrayAttribBinding(vao_, attrib, 0);
+      glEnableVertexArrayAttrib(vao_, attrib);
+    }
+    // draw index (per instance, see DrawIndexBuffer)
+    glVertexArrayAttribIFormat(vao_, 3, 1, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(vao_, 3, 1);
+    glEnableVertexArrayAttrib(vao_, 3);
+    glVertexArrayBindingDivisor(vao_, 1, 1);
+    glVertexArrayVertexBuffer(vao_, 1, DrawIndexBuffer::Get(), 0, sizeof(unsigned int));
+  }
+
+  // Moves the contents into a bigger buffer, the VAO is re-pointed by Add
+  static void Grow(unsigned int& buffer, size_t& capacity, size_t used, size_t needed, size_t stride) {
+    if (buffer && needed <= capacity) return;
+    size_t new_capacity = std::max<size_t>(capacity, 1 << 16);
+    while (new_capacity < needed) new_capacity *= 2;
+
+    unsigned int grown;
+    glCreateBuffers(1, &grown);
+    glNamedBufferData(grown, new_capacity * stride, nullptr, GL_STATIC_DRAW);
+    if (buffer) {
+      if (used) glCopyNamedBufferSubData(buffer, grown, 0, 0, used * stride);
+      glDeleteBuffers(1, &buffer);
+    }
+    buffer = grown;
+    capacity = new_capacity;
+  }
+};
+
 class Mesh {
 public:
   // mesh data
   vector<Vertex> vertices;
   vector<unsigned int> indices;
   vector<Texture> textures;
+  Material* material;  // shared, picked from the first diffuse/specular texture
+  GeometryPool::Range range;  // location in the geometry pool
+  glm::vec3 bounds_min = glm::vec3(0.0f), bounds_max = glm::vec3(0.0f);  // model space
   Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
-  void Draw(Shader& shader);
+  // Issues the draw, textures are expected to be bound by the caller
+  void Draw(unsigned int draw_index) const;
 private:
-  // render data
-  unsigned int VAO, VBO, EBO;
   void setupMesh();
 };
 
@@ -42,52 +167,29 @@ inline Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<
   this->vertices = vertices;
   this->indices = indices;
   this->textures = textures;
+
+  unsigned int diffuse = 0, specular = 0;
+  for (const Texture& texture : textures) {
+    if (texture.type == "texture_diffuse" && !diffuse) diffuse = texture.id;
+    else if (texture.type == "texture_specular" && !specular) specular = texture.id;
+  }
+  material = MaterialLibrary::Get().GetShared(diffuse, specular);
   setupMesh();
 }
 
 inline void Mesh::setupMesh() {
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
-  glBindVertexArray(VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-  // vertex positions
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-  // vertex normals
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-  // vertex texture coords
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-  glBindVertexArray(0);
+  for (size_t i = 0; i < vertices.size(); i++) {
+    bounds_min = i ? glm::min(bounds_min, vertices[i].Position) : vertices[i].Position;
+    bounds_max = i ? glm::max(bounds_max, vertices[i].Position) : vertices[i].Position;
+  }
+  range = GeometryPool::Get().Add(vertices, indices);
 }
 
-inline void Mesh::Draw(Shader& shader)
+inline void Mesh::Draw(unsigned int draw_index) const
 {
-  shader.use();
-  unsigned int diffuseNr = 1;
-  unsigned int specularNr = 1;
-  for (unsigned int i = 0; i < textures.size(); i++)
-  {
-    glActiveTexture(GL_TEXTURE0 + i); // activate texture unit first
-    // retrieve texture number (the N in diffuse_textureN)
-    string number;
-    string name = textures[i].type;
-    if (name == "texture_diffuse")
-      number = std::to_string(diffuseNr++);
-    else if (name == "texture_specular")
-      number = std::to_string(specularNr++);
-    shader.setFloat(("material." + name + number).c_str(), i);
-    glBindTexture(GL_TEXTURE_2D, textures[i].id);
-  }
-  glActiveTexture(GL_TEXTURE0);
-  // draw mesh
-  glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+  glBindVertexArray(GeometryPool::Get().vao());
+  glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT,
+    (void*)(range.first_index * sizeof(unsigned int)), 1, range.base_vertex, draw_index);
   glBindVertexArray(0);
 }
 #endif
\ No newline at end of file
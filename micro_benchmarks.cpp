@@ -0,0 +1,194 @@
+// CPU micro-benchmarks (Google Benchmark) for the per-frame and loading hot
+// paths. GL goes to mock_gl, so they run anywhere and time only our code:
+//
+//   MicroBenchmarks --benchmark_filter=Light --benchmark_repetitions=5
+//
+// Shader sources are read from the working directory like in the editor.
+#include <benchmark/benchmark.h>
+
+#include <assimp/scene.h>
+
+#include "mock_gl.h"
+#include "scene.h"
+#include "object_buffer.h"
+
+// standart libraries
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+// FIXTURES
+//=-----------------------------=
+static Camera MakeCamera() {
+  Camera camera(glm::vec3(0.0f, 1.0f, 5.0f));
+  camera.screenWidth = 1920;
+  camera.screenHeight = 1080;
+  return camera;
+}
+
+// mesh_count grids of side x side vertices with normals and texture
+// coordinates, one material without textures. The root node owns every mesh.
+static std::unique_ptr<aiScene> MakeScene(unsigned int mesh_count, unsigned int side) {
+  auto scene = std::make_unique<aiScene>();
+  scene->mNumMaterials = 1;
+  scene->mMaterials = new aiMaterial*[1]{ new aiMaterial() };
+  scene->mNumMeshes = mesh_count;
+  scene->mMeshes = new aiMesh*[mesh_count];
+  scene->mRootNode = new aiNode();
+  scene->mRootNode->mNumMeshes = mesh_count;
+  scene->mRootNode->mMeshes = new unsigned int[mesh_count];
+
+  for (unsigned int m = 0; m < mesh_count; m++) {
+    aiMesh* mesh = new aiMesh();
+    mesh->mNumVertices = side * side;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+    mesh->mNumUVComponents[0] = 2;
+    for (unsigned int y = 0; y < side; y++) {
+      for (unsigned int x = 0; x < side; x++) {
+        unsigned int i = y * side + x;
+        mesh->mVertices[i] = aiVector3D((float)x, 0.0f, (float)y);
+        mesh->mNormals[i] = aiVector3D(0.0f, 1.0f, 0.0f);
+        mesh->mTextureCoords[0][i] = aiVector3D((float)x / side, (float)y / side, 0.0f);
+      }
+    }
+    mesh->mNumFaces = 2 * (side - 1) * (side - 1);
+    mesh->mFaces = new aiFace[mesh->mNumFaces];
+    unsigned int face = 0;
+    for (unsigned int y = 0; y + 1 < side; y++) {
+      for (unsigned int x = 0; x + 1 < side; x++) {
+        unsigned int i = y * side + x;
+        const unsigned int quad[2][3] = { { i, i + side, i + 1 }, { i + 1, i + side, i + side + 1 } };
+        for (const auto& triangle : quad) {
+          mesh->mFaces[face].mNumIndices = 3;
+          mesh->mFaces[face].mIndices = new unsigned int[3]{ triangle[0], triangle[1], triangle[2] };
+          face++;
+        }
+      }
+    }
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mMaterialIndex = 0;
+    scene->mMeshes[m] = mesh;
+    scene->mRootNode->mMeshes[m] = m;
+  }
+  return scene;
+}
+
+// LIGHTS
+//=-----------------------------=
+static void BM_DirectionalLight_LightSpaceMatrices(benchmark::State& state) {
+  Camera camera = MakeCamera();
+  DirectionalLight light(&camera, glm::vec3(-0.2f, -0.5f, -0.3f));
+  for (auto _ : state) benchmark::DoNotOptimize(light.getLightSpaceMatrices());
+  state.SetItemsProcessed(state.iterations() * (light.shadowCascadeLevels.size() + 1));
+}
+BENCHMARK(BM_DirectionalLight_LightSpaceMatrices);
+
+static void BM_DirectionalLight_LightSpaceMatrix(benchmark::State& state) {
+  Camera camera = MakeCamera();
+  DirectionalLight light(&camera, glm::vec3(-0.2f, -0.5f, -0.3f));
+  for (auto _ : state) benchmark::DoNotOptimize(light.getLightSpaceMatrix(camera.getNear(), 20.0f));
+}
+BENCHMARK(BM_DirectionalLight_LightSpaceMatrix);
+
+static void BM_PointLight_LightSpaceMatrix(benchmark::State& state) {
+  Camera camera = MakeCamera();
+  PointLight light(&camera, glm::vec3(3.0f, 2.0f, 2.0f));
+  for (auto _ : state) benchmark::DoNotOptimize(light.getLightSpaceMatrix(2048));
+}
+BENCHMARK(BM_PointLight_LightSpaceMatrix);
+
+// TRANSFORMS
+//=-----------------------------=
+static void BM_Object_ModelMatrix(benchmark::State& state) {
+  Camera camera = MakeCamera();
+  PointLight object(&camera, glm::vec3(1.0f, 2.0f, 3.0f));
+  object.setRotation(glm::vec3(10.0f, 20.0f, 30.0f));
+  object.setSize(glm::vec3(2.0f));
+  for (auto _ : state) benchmark::DoNotOptimize(object.GetModelMatrix());
+}
+BENCHMARK(BM_Object_ModelMatrix);
+
+// Model and normal matrices of every model, all of them moved each frame
+static void BM_ObjectBuffer_UpdateAllDirty(benchmark::State& state) {
+  auto source = MakeScene(1, 2);
+  std::vector<std::unique_ptr<Model>> models;
+  std::vector<Object*> objects;
+  for (int i = 0; i < state.range(0); i++) {
+    models.push_back(std::make_unique<Model>(source.get(), ""));
+    models.back()->setRotation(glm::vec3(0.0f, (float)i, 0.0f));
+    objects.push_back(models.back().get());
+  }
+  ObjectBuffer buffer;
+  float frame = 0.0f;
+  for (auto _ : state) {
+    frame += 1.0f;
+    for (auto& model : models) model->setPosition(glm::vec3(frame, 0.0f, 0.0f));
+    buffer.Update(objects);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ObjectBuffer_UpdateAllDirty)->Range(64, 16384);
+
+// LOADING
+//=-----------------------------=
+// processNode / processMesh: aiMesh to Vertex conversion, index gathering
+// and the (mocked) geometry pool upload
+static void BM_Model_ProcessMesh(benchmark::State& state) {
+  unsigned int side = (unsigned int)state.range(0);
+  auto source = MakeScene(1, side);
+  for (auto _ : state) {
+    Model model(source.get(), "");
+    benchmark::DoNotOptimize(model.bounds_max);
+  }
+  state.SetItemsProcessed(state.iterations() * side * side);
+}
+BENCHMARK(BM_Model_ProcessMesh)->RangeMultiplier(4)->Range(16, 256);
+
+// SCENE
+//=-----------------------------=
+// Adds count point lights and deletes them in random order
+static void BM_Scene_AddDeleteChurn(benchmark::State& state) {
+  Camera camera = MakeCamera();
+  Scene scene;
+  std::vector<unsigned int> ids((size_t)state.range(0));
+  std::mt19937 random(42);
+  for (auto _ : state) {
+    for (unsigned int& id : ids) id = scene.AddPointLight(&camera, glm::vec3(0.0f))->GetID();
+    std::shuffle(ids.begin(), ids.end(), random);
+    for (unsigned int id : ids) scene.Delete(id);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Scene_AddDeleteChurn)->Range(16, 4096);
+
+// DRAW SUBMISSION
+//=-----------------------------=
+static void BM_Mesh_Draw(benchmark::State& state) {
+  auto source = MakeScene(1, 8);
+  Model model(source.get(), "");
+  const Mesh& mesh = model.GetMeshes()[0];
+  for (auto _ : state) mesh.Draw(0);
+}
+BENCHMARK(BM_Mesh_Draw);
+
+// Material bind plus draw for every mesh of the model
+static void BM_Model_Draw(benchmark::State& state) {
+  Shader shader("shader.vert", "shader.frag");
+  auto source = MakeScene((unsigned int)state.range(0), 4);
+  Model model(source.get(), "");
+  for (auto _ : state) model.Draw(&shader);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Model_Draw)->Range(1, 256);
+
+int main(int argc, char** argv) {
+  mock_gl::Install();
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
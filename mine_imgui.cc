@@ -1,9 +1,17 @@
 #include "mine_imgui.h"
+#include "layered_shadows.h"
+
+#include <cfloat>
 
 bool showPerformanceCounter = false; // Toggle state
+bool dumpFrameGraph = false;
 unsigned int fps_c = 0;
+RenderStats stats_c;
+
+static void ShowFrameStats();
+static void ShowGpuPasses();
 
-void RenderMenuBar() {
+void RenderMenuBar(Scene* scene) {
   if (ImGui::BeginMainMenuBar()) {
     // "File" menu
     if (ImGui::BeginMenu("File")) {
@@ -48,15 +56,59 @@ void RenderMenuBar() {
       ImGui::EndMenu();
     }
 
+    // "Renderer" menu
+    if (ImGui::BeginMenu("Renderer")) {
+      ImGui::MenuItem("Deferred shading", NULL, &scene->properties.deferred_shading);
+      ImGui::MenuItem("Depth prepass", NULL, &scene->properties.depth_prepass);
+      ImGui::MenuItem("Occlusion culling", NULL, &scene->properties.occlusion_culling);
+      ImGui::MenuItem("GPU culling", NULL, &scene->properties.gpu_culling);
+      ImGui::MenuItem("Hi-Z culling", NULL, &scene->properties.hiz_culling, scene->properties.gpu_culling);
+
+      // Render scale, automatic or manual
+      Properties& p = scene->properties;
+      if (ImGui::BeginMenu("Resolution")) {
+        ImGui::MenuItem("Dynamic resolution", NULL, &p.dynamic_resolution);
+        if (p.dynamic_resolution) {
+          ImGui::SliderFloat("GPU target (ms)", &p.gpu_target_ms, 4.0f, 50.0f, "%.1f");
+          ImGui::SliderFloat("Min scale", &p.min_resolution_scale, 0.25f, 1.0f, "%.2f");
+        }
+        else {
+          ImGui::SliderFloat("Scale", &p.resolution_scale, 0.25f, 1.0f, "%.2f");
+        }
+        const char* filters[] = { "Bilinear", "Sharpen" };
+        ImGui::Combo("Upscale", &p.upscale_filter, filters, IM_ARRAYSIZE(filters));
+        if (p.upscale_filter == UPSCALE_SHARPEN) ImGui::SliderFloat("Sharpness", &p.sharpness, 0.0f, 1.0f, "%.2f");
+        ImGui::EndMenu();
+      }
+      if (ImGui::BeginMenu("Shadows")) {
+        ImGui::MenuItem("Cache static casters", NULL, &p.shadow_caching);
+        ImGui::MenuItem("Fit cascades to visible depth", NULL, &p.sdsm);
+        ImGui::MenuItem("Layer in vertex shader", NULL, &p.layered_shadows, LayeredShadowBatch::Supported());
+        for (int i = 0; i <= (int)CASCADE_COUNT; i++) {
+          std::string label = "Cascade " + std::to_string(i) + " every";
+          ImGui::SliderInt(label.c_str(), &p.cascade_update_interval[i], 1, 16, "%d frames");
+        }
+        ImGui::InputInt("Triangle budget", &p.shadow_triangle_budget, 10000, 100000);
+        if (p.shadow_triangle_budget < 0) p.shadow_triangle_budget = 0;
+        ImGui::InputInt("Atlas face budget", &p.shadow_face_budget, 1, 6);
+        if (p.shadow_face_budget < 0) p.shadow_face_budget = 0;
+        ImGui::EndMenu();
+      }
+      if (ImGui::MenuItem("Dump frame graph")) dumpFrameGraph = true;
+
+      ImGui::EndMenu();
+    }
+
     ImGui::EndMainMenuBar(); // End the menu bar
   }
 }
 
-void ShowMyWindow(Scene* scene, unsigned int fps_count) {
+void ShowMyWindow(Scene* scene, unsigned int fps_count, const RenderStats& stats) {
   IM_ASSERT(ImGui::GetCurrentContext() != NULL && "Missing Dear ImGui context. Refer to examples app!");
   IMGUI_CHECKVERSION();
   fps_c = fps_count;
-  RenderMenuBar();
+  stats_c = stats;
+  RenderMenuBar(scene);
   if (showPerformanceCounter) {
     ShowinfoOverlay();
   }
@@ -155,6 +207,97 @@ static void ShowinfoOverlay() {
     ImGui::Text("Overlay\n" "(right-click to change position)");
     ImGui::Separator();
     ImGui::Text("FPS: %d", fps_c);
+    ShowFrameStats();
+    ImGui::Text("Render: %dx%d (scale %.2f)", stats_c.render_width, stats_c.render_height, stats_c.resolution_scale);
+    ImGui::Text("Render targets: %u (%.1f MB)", stats_c.target_textures, stats_c.target_bytes / (1024.0 * 1024.0));
+    const FrameGraphStats& graph = stats_c.frame_graph;
+    ImGui::Text("Frame graph: %u/%u passes, %u transients in %u textures (%.1f MB)", graph.passes - graph.culled,
+                graph.passes, graph.transients, graph.textures, graph.bytes / (1024.0 * 1024.0));
+    const ShadowAtlasStats& atlas = stats_c.shadow_atlas;
+    ImGui::Text("Shadow atlas: %d^2 (%.1f MB, %.0f%% used), %u/%u lights, %u tiles", atlas.size,
+                atlas.bytes / (1024.0 * 1024.0), atlas.used * 100.0f, atlas.shadowed, atlas.requested, atlas.tiles);
+    const ShadowCacheStats& cache = stats_c.shadow_cache;
+    ImGui::Text("Shadow cache: %u views, %u static redraws, %u updates, %u deferred", cache.views,
+                cache.static_renders, cache.live_updates, cache.deferred);
+    const CascadeSchedulerStats& cascades = stats_c.cascades;
+    ImGui::Text("Cascades: %u updated, %u stale, %u deferred (%llu triangles)", cascades.updated, cascades.stale,
+                cascades.deferred, cascades.triangles);
+    if (stats_c.cascade_far > 0.0f)
+      ImGui::Text("Cascade range: %.2f - %.2f (depth bounds)", stats_c.cascade_near, stats_c.cascade_far);
+    ImGui::Separator();
+    ImGui::Text("Overdraw: %.2f (%llu samples)", stats_c.overdraw, stats_c.shaded_samples);
+    ImGui::Text("Occlusion culled: %u (%zu occluder triangles)", stats_c.occlusion_culled, stats_c.occluder_triangles);
+    ImGui::Text("Occlusion queries: %u (%u hidden)", stats_c.occlusion_queries, stats_c.query_hidden);
+    ImGui::Separator();
+    ShowGpuPasses();
   }
   ImGui::End();
-}
\ No newline at end of file
+}
+
+// Per-pass GPU time with a short history, plus the pipeline counters
+static void ShowGpuPasses() {
+  const int HISTORY = 120;
+  static float history[GPU_PASS_COUNT][HISTORY] = {};
+  static int offset = 0;
+  float total = 0.0f;
+  for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+    history[pass][offset] = stats_c.gpu_passes[pass].ms;
+    total += stats_c.gpu_passes[pass].ms;
+  }
+  offset = (offset + 1) % HISTORY;
+
+  ImGui::Text("GPU: %.2f ms", total);
+  int columns = stats_c.pipeline_statistics ? 6 : 3;
+  if (ImGui::BeginTable("GPU passes", columns, ImGuiTableFlags_SizingFixedFit)) {
+    ImGui::TableSetupColumn("Pass");
+    ImGui::TableSetupColumn("ms");
+    ImGui::TableSetupColumn("History");
+    if (stats_c.pipeline_statistics) {
+      ImGui::TableSetupColumn("Vertices");
+      ImGui::TableSetupColumn("Primitives");
+      ImGui::TableSetupColumn("Fragments");
+    }
+    ImGui::TableHeadersRow();
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+      const GpuPassTiming& timing = stats_c.gpu_passes[pass];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(GpuPassName(pass));
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", timing.ms);
+      ImGui::TableNextColumn();
+      ImGui::PushID(pass);
+      ImGui::PlotLines("##history", history[pass], HISTORY, offset, nullptr, 0.0f, FLT_MAX, ImVec2(100, 18));
+      ImGui::PopID();
+      if (stats_c.pipeline_statistics) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", timing.vertices);
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", timing.primitives);
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", timing.fragments);
+      }
+    }
+    ImGui::EndTable();
+  }
+}
+
+// Frame times with percentiles and the counters of the last frame
+static void ShowFrameStats() {
+  ImGui::Text("Frame: %.2f ms (CPU %.2f, GPU %.2f)", stats_c.frame_ms, stats_c.cpu_ms, stats_c.gpu_ms);
+  ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f ms", stats_c.p50, stats_c.p95, stats_c.p99);
+  if (stats_c.frame_times && stats_c.frame_times->size()) {
+    std::vector<float> times = stats_c.frame_times->Ordered();
+    ImGui::PlotLines("##frame times", times.data(), (int)times.size(), 0, "frame ms", 0.0f, stats_c.p99 * 1.5f,
+                     ImVec2(300, 50));
+    std::vector<float> histogram = stats_c.frame_times->Histogram();
+    ImGui::PlotHistogram("##frame histogram", histogram.data(), (int)histogram.size(), 0, "0-50 ms", 0.0f, FLT_MAX,
+                         ImVec2(300, 50));
+  }
+
+  const FrameCounters& c = stats_c.counters;
+  ImGui::Text("Draw calls: %u (%u instanced, %u indirect commands)", c.draw_calls, c.instanced_draws, c.indirect_draws);
+  ImGui::Text("Triangles: %llu  Vertices: %llu", c.triangles, c.vertices);
+  ImGui::Text("Program binds: %u  Texture binds: %u", c.program_binds, c.texture_binds);
+  ImGui::Text("Uploads: %.1f KB", c.upload_bytes / 1024.0);
+}
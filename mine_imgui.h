@@ -12,15 +12,55 @@
 #include "model.h"
 #include <custom/camera.h>
 #include "light.h"
+#include "gpu_timer.h"
+#include "frame_stats.h"
+#include "dynamic_resolution.h"
+#include "frame_graph.h"
+#include "shadow_atlas.h"
+#include "shadow_cache.h"
+#include "cascade_scheduler.h"
+
+// Renderer counters shown in the performance overlay
+struct RenderStats {
+  unsigned long long shaded_samples = 0;  // color pass fragments that passed the depth test
+  float overdraw = 0.0f;                  // shaded_samples per screen pixel
+  unsigned int occlusion_culled = 0;      // models skipped by the occlusion culler
+  size_t occluder_triangles = 0;          // triangles rasterized by the occlusion culler
+  unsigned int occlusion_queries = 0;     // hardware queries issued this frame
+  unsigned int query_hidden = 0;          // queried models hidden in the last results read back
+  GpuPassTiming gpu_passes[GPU_PASS_COUNT];  // from GpuTimer, a few frames old
+  bool pipeline_statistics = false;       // vertex/primitive/fragment counters are valid
+
+  // Previous frame
+  FrameCounters counters;
+  float frame_ms = 0.0f;                  // swap to swap
+  float cpu_ms = 0.0f;                    // RenderScene without the swap
+  float gpu_ms = 0.0f;                    // sum of the timed passes
+  float p50 = 0.0f, p95 = 0.0f, p99 = 0.0f;  // over the last FrameTimeHistory::CAPACITY frames
+  const FrameTimeHistory* frame_times = nullptr;
+
+  // Dynamic resolution
+  float resolution_scale = 1.0f;          // per axis
+  int render_width = 0, render_height = 0;
+  size_t target_bytes = 0;                // RenderTargetPool estimate
+  unsigned int target_textures = 0;
+  FrameGraphStats frame_graph;
+  ShadowAtlasStats shadow_atlas;
+  ShadowCacheStats shadow_cache;
+  CascadeSchedulerStats cascades;
+  float cascade_near = 0.0f, cascade_far = 0.0f;  // visible range the cascades cover, 0 - fixed splits
+};
 
 extern bool showPerformanceCounter; // Toggle state
+extern bool dumpFrameGraph;         // set by the menu, the renderer writes frame_graph.dot and clears it
 extern unsigned int fps_c;
+extern RenderStats stats_c;
 
 static void ShowinfoOverlay();
 
-void RenderMenuBar();
+void RenderMenuBar(Scene* scene);
 
-void ShowMyWindow(Scene* scene, unsigned int fps_count);
+void ShowMyWindow(Scene* scene, unsigned int fps_count, const RenderStats& stats);
 
 static void ShowinfoOverlay();
 
@@ -0,0 +1,140 @@
+#include "mock_gl.h"
+
+#include <glad/glad.h>
+
+namespace mock_gl {
+
+unsigned long long calls = 0;
+
+static GLuint next_name = 1;
+
+static void GenNames(GLsizei n, GLuint* names) {
+  calls++;
+  for (GLsizei i = 0; i < n; i++) names[i] = next_name++;
+}
+
+// OBJECTS
+//=-----------------------------=
+static void APIENTRY GenBuffers(GLsizei n, GLuint* names) { GenNames(n, names); }
+static void APIENTRY CreateBuffers(GLsizei n, GLuint* names) { GenNames(n, names); }
+static void APIENTRY GenTextures(GLsizei n, GLuint* names) { GenNames(n, names); }
+static void APIENTRY GenFramebuffers(GLsizei n, GLuint* names) { GenNames(n, names); }
+static void APIENTRY CreateVertexArrays(GLsizei n, GLuint* names) { GenNames(n, names); }
+static void APIENTRY DeleteBuffers(GLsizei, const GLuint*) { calls++; }
+static void APIENTRY DeleteTextures(GLsizei, const GLuint*) { calls++; }
+
+// BINDINGS
+//=-----------------------------=
+static void APIENTRY BindBuffer(GLenum, GLuint) { calls++; }
+static void APIENTRY BindBufferBase(GLenum, GLuint, GLuint) { calls++; }
+static void APIENTRY BindTexture(GLenum, GLuint) { calls++; }
+static void APIENTRY BindTextures(GLuint, GLsizei, const GLuint*) { calls++; }
+static void APIENTRY BindFramebuffer(GLenum, GLuint) { calls++; }
+static void APIENTRY BindVertexArray(GLuint) { calls++; }
+static void APIENTRY UseProgram(GLuint) { calls++; }
+
+// BUFFERS AND VERTEX ARRAYS
+//=-----------------------------=
+static void APIENTRY BufferData(GLenum, GLsizeiptr, const void*, GLenum) { calls++; }
+static void APIENTRY BufferSubData(GLenum, GLintptr, GLsizeiptr, const void*) { calls++; }
+static void APIENTRY NamedBufferData(GLuint, GLsizeiptr, const void*, GLenum) { calls++; }
+static void APIENTRY NamedBufferSubData(GLuint, GLintptr, GLsizeiptr, const void*) { calls++; }
+static void APIENTRY CopyNamedBufferSubData(GLuint, GLuint, GLintptr, GLintptr, GLsizeiptr) { calls++; }
+static void APIENTRY VertexArrayAttribFormat(GLuint, GLuint, GLint, GLenum, GLboolean, GLuint) { calls++; }
+static void APIENTRY VertexArrayAttribIFormat(GLuint, GLuint, GLint, GLenum, GLuint) { calls++; }
+static void APIENTRY VertexArrayAttribBinding(GLuint, GLuint, GLuint) { calls++; }
+static void APIENTRY EnableVertexArrayAttrib(GLuint, GLuint) { calls++; }
+static void APIENTRY VertexArrayBindingDivisor(GLuint, GLuint, GLuint) { calls++; }
+static void APIENTRY VertexArrayVertexBuffer(GLuint, GLuint, GLuint, GLintptr, GLsizei) { calls++; }
+static void APIENTRY VertexArrayElementBuffer(GLuint, GLuint) { calls++; }
+
+// TEXTURES AND FRAMEBUFFERS
+//=-----------------------------=
+static void APIENTRY TexImage3D(GLenum, GLint, GLint, GLsizei, GLsizei, GLsizei, GLint, GLenum, GLenum,
+                                const void*) { calls++; }
+static void APIENTRY TexParameteri(GLenum, GLenum, GLint) { calls++; }
+static void APIENTRY TexParameterfv(GLenum, GLenum, const GLfloat*) { calls++; }
+static void APIENTRY FramebufferTexture(GLenum, GLenum, GLuint, GLint) { calls++; }
+static void APIENTRY DrawBuffer(GLenum) { calls++; }
+static void APIENTRY ReadBuffer(GLenum) { calls++; }
+static GLenum APIENTRY CheckFramebufferStatus(GLenum) { calls++; return GL_FRAMEBUFFER_COMPLETE; }
+
+// SHADERS
+//=-----------------------------=
+// Compilation and linking always succeed
+static GLuint APIENTRY CreateShader(GLenum) { calls++; return next_name++; }
+static GLuint APIENTRY CreateProgram() { calls++; return next_name++; }
+static void APIENTRY ShaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) { calls++; }
+static void APIENTRY CompileShader(GLuint) { calls++; }
+static void APIENTRY AttachShader(GLuint, GLuint) { calls++; }
+static void APIENTRY LinkProgram(GLuint) { calls++; }
+static void APIENTRY DeleteShader(GLuint) { calls++; }
+static void APIENTRY GetShaderiv(GLuint, GLenum, GLint* value) { calls++; *value = GL_TRUE; }
+static void APIENTRY GetProgramiv(GLuint, GLenum, GLint* value) { calls++; *value = GL_TRUE; }
+static void APIENTRY GetInfoLog(GLuint, GLsizei, GLsizei* length, GLchar* log) {
+  calls++;
+  if (length) *length = 0;
+  if (log) log[0] = '\0';
+}
+static GLint APIENTRY GetUniformLocation(GLuint, const GLchar*) { calls++; return 0; }
+
+// DRAWS
+//=-----------------------------=
+static void APIENTRY DrawElementsInstancedBaseVertexBaseInstance(GLenum, GLsizei, GLenum, const void*, GLsizei,
+                                                                 GLint, GLuint) { calls++; }
+
+void Install() {
+  glad_glGenBuffers = GenBuffers;
+  glad_glCreateBuffers = CreateBuffers;
+  glad_glGenTextures = GenTextures;
+  glad_glGenFramebuffers = GenFramebuffers;
+  glad_glCreateVertexArrays = CreateVertexArrays;
+  glad_glDeleteBuffers = DeleteBuffers;
+  glad_glDeleteTextures = DeleteTextures;
+
+  glad_glBindBuffer = BindBuffer;
+  glad_glBindBufferBase = BindBufferBase;
+  glad_glBindTexture = BindTexture;
+  glad_glBindTextures = BindTextures;
+  glad_glBindFramebuffer = BindFramebuffer;
+  glad_glBindVertexArray = BindVertexArray;
+  glad_glUseProgram = UseProgram;
+
+  glad_glBufferData = BufferData;
+  glad_glBufferSubData = BufferSubData;
+  glad_glNamedBufferData = NamedBufferData;
+  glad_glNamedBufferSubData = NamedBufferSubData;
+  glad_glCopyNamedBufferSubData = CopyNamedBufferSubData;
+  glad_glVertexArrayAttribFormat = VertexArrayAttribFormat;
+  glad_glVertexArrayAttribIFormat = VertexArrayAttribIFormat;
+  glad_glVertexArrayAttribBinding = VertexArrayAttribBinding;
+  glad_glEnableVertexArrayAttrib = EnableVertexArrayAttrib;
+  glad_glVertexArrayBindingDivisor = VertexArrayBindingDivisor;
+  glad_glVertexArrayVertexBuffer = VertexArrayVertexBuffer;
+  glad_glVertexArrayElementBuffer = VertexArrayElementBuffer;
+
+  glad_glTexImage3D = TexImage3D;
+  glad_glTexParameteri = TexParameteri;
+  glad_glTexParameterfv = TexParameterfv;
+  glad_glFramebufferTexture = FramebufferTexture;
+  glad_glDrawBuffer = DrawBuffer;
+  glad_glReadBuffer = ReadBuffer;
+  glad_glCheckFramebufferStatus = CheckFramebufferStatus;
+
+  glad_glCreateShader = CreateShader;
+  glad_glCreateProgram = CreateProgram;
+  glad_glShaderSource = ShaderSource;
+  glad_glCompileShader = CompileShader;
+  glad_glAttachShader = AttachShader;
+  glad_glLinkProgram = LinkProgram;
+  glad_glDeleteShader = DeleteShader;
+  glad_glGetShaderiv = GetShaderiv;
+  glad_glGetProgramiv = GetProgramiv;
+  glad_glGetShaderInfoLog = GetInfoLog;
+  glad_glGetProgramInfoLog = GetInfoLog;
+  glad_glGetUniformLocation = GetUniformLocation;
+
+  glad_glDrawElementsInstancedBaseVertexBaseInstance = DrawElementsInstancedBaseVertexBaseInstance;
+}
+
+}  // namespace mock_gl
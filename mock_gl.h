@@ -0,0 +1,20 @@
+#ifndef MOCK_GL_H_
+#define MOCK_GL_H_
+
+// MOCK GL
+//=-----------------------------=
+// No-op GL for CPU micro-benchmarks. glad calls through function pointers,
+// so Install() points the entry points used by meshes, models, lights and
+// shaders at stubs that only hand out names and count calls; no context or
+// GPU is needed. Entry points outside that set stay null and crash when
+// called, add a stub here when a benchmark needs one.
+namespace mock_gl {
+
+// Every stub call since Install
+extern unsigned long long calls;
+
+void Install();
+
+}  // namespace mock_gl
+
+#endif
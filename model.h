@@ -6,48 +6,128 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "occlusion_culler.h"
 #include <SHADER/shader_c.h>
 #include "stb_image.h"
+#include "profiler.h"
 
-struct Material {
-	glm::vec3 diffuse = glm::vec3(1.0f);;
-	glm::vec3 specular = glm::vec3(1.0f);;
-	float shininess = 128.0f;
+#include <memory>
+
+// CPU side of a loaded model, shared by all its instances. The meshes keep
+// their geometry pool ranges and shared materials.
+struct ModelData {
+	vector<Mesh> meshes;
+	OccluderMesh occluder_mesh;
+	string directory;
+	vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
 };
 
 class Model : public Object{
 public:
-	Material material;
 	bool scale_texture = false;
+	unsigned int object_index = 0; // slot of this model in the object buffer
+	unsigned int draw_index = 0;   // draw record of meshes[0], meshes follow in order
+	bool occluder = false;         // rasterized by the software occlusion culler
+	bool occlusion_query = false;  // drawn only when its bounding box passes a hardware query
+	glm::vec3 bounds_min = glm::vec3(0.0f), bounds_max = glm::vec3(0.0f);  // model space
 	Model(char* path){
 		loadModel(path);
+		ComputeBounds();
 	}
 	Model(Mesh mesh) {
-		this->meshes.push_back(mesh);
+		data->meshes.push_back(mesh);
+		ComputeBounds();
+	}
+	// Scene imported elsewhere (from memory, or built in code), texture paths
+	// are relative to directory
+	Model(const aiScene* scene, const string& directory) {
+		data->directory = directory;
+		processNode(scene->mRootNode, scene);
+		ComputeBounds();
+	}
+	~Model() {
+		for (Material* material : overrides) MaterialLibrary::Get().Release(material);
+	}
+	// Copies would duplicate the meshes and release the overrides twice,
+	// use Instance
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+	// Another instance of the same meshes: the mesh data is shared, the
+	// per-instance material overrides are not copied
+	Model* Instance() const {
+		return new Model(*this, data);
 	}
 	void Draw(Shader* shader);
 	void DrawDepth(Shader* shader);
 	void DrawStencil(Shader* shader);
-	Material getMaterial() { return material; }
-	void setDiffuse(glm::vec3 diffuse) { material.diffuse = diffuse; }
-	void setSpecular(glm::vec3 specular) { material.specular = specular; }
-	void setShininess(float shininess) { material.shininess = shininess; }
+	const vector<Mesh>& GetMeshes() const { return data->meshes; }
+	size_t TriangleCount() const {
+		size_t triangles = 0;
+		for (const Mesh& mesh : data->meshes) triangles += mesh.indices.size() / 3;
+		return triangles;
+	}
+	// Simplified copy of all meshes, built on first use by any instance
+	const OccluderMesh& GetOccluderMesh() {
+		if (data->occluder_mesh.indices.empty()) {
+			std::vector<glm::vec3> positions;
+			std::vector<unsigned int> indices;
+			for (const Mesh& mesh : data->meshes) {
+				unsigned int base = (unsigned int)positions.size();
+				for (const Vertex& vertex : mesh.vertices) positions.push_back(vertex.Position);
+				for (unsigned int index : mesh.indices) indices.push_back(base + index);
+			}
+			data->occluder_mesh = SimplifyOccluder(positions, indices);
+		}
+		return data->occluder_mesh;
+	}
+	// Material used to draw a mesh, the per-instance override if there is one
+	Material* getMaterial(unsigned int mesh) const {
+		return overrides.empty() ? data->meshes[mesh].material : overrides[mesh];
+	}
+	void setDiffuse(glm::vec3 diffuse) { OverrideMaterials(); for (auto m : overrides) m->setDiffuse(diffuse); MarkDirty(); }
+	void setSpecular(glm::vec3 specular) { OverrideMaterials(); for (auto m : overrides) m->setSpecular(specular); MarkDirty(); }
+	void setShininess(float shininess) { OverrideMaterials(); for (auto m : overrides) m->setShininess(shininess); MarkDirty(); }
 private:
 	// model data
-	vector<Mesh> meshes;
-	string directory;
-	vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+	std::shared_ptr<ModelData> data = std::make_shared<ModelData>();
+	vector<Material*> overrides;	// per-instance materials, created on first change
+	// Instance of prototype sharing data, transforms and flags are copied
+	Model(const Model& prototype, std::shared_ptr<ModelData> data)
+		: Object(prototype), scale_texture(prototype.scale_texture), occluder(prototype.occluder),
+		  occlusion_query(prototype.occlusion_query), bounds_min(prototype.bounds_min),
+		  bounds_max(prototype.bounds_max), data(std::move(data)) {
+		MarkDirty();
+	}
 	void loadModel(string path);
 	void processNode(aiNode* node, const aiScene* scene);
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
 	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+	void ComputeBounds() {
+		const vector<Mesh>& meshes = data->meshes;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			bounds_min = i ? glm::min(bounds_min, meshes[i].bounds_min) : meshes[i].bounds_min;
+			bounds_max = i ? glm::max(bounds_max, meshes[i].bounds_max) : meshes[i].bounds_max;
+		}
+	}
+	void OverrideMaterials() {
+		if (!overrides.empty()) return;
+		for (const Mesh& mesh : data->meshes) overrides.push_back(MaterialLibrary::Get().Clone(mesh.material));
+	}
 	void update(Shader* shader, int index) override {};
 	void draw_menu() override {
 		if (ImGui::Begin(("Properties - " + name).c_str())) {
 			Object::draw_menu();
-			ImGui::ColorEdit3("Diffuse", glm::value_ptr(material.diffuse));
-			ImGui::ColorEdit3("Specular", glm::value_ptr(material.specular));
-			ImGui::DragFloat("Shininess", &material.shininess, 1.0f, 500.0f, 10.0f);
+			ImGui::Checkbox("Occluder", &occluder);
+			ImGui::Checkbox("Occlusion query", &occlusion_query);
+			if (!data->meshes.empty()) {
+				const Material* material = getMaterial(0);
+				glm::vec3 diffuse = material->getDiffuse();
+				glm::vec3 specular = material->getSpecular();
+				float shininess = material->getShininess();
+				if (ImGui::ColorEdit3("Diffuse", glm::value_ptr(diffuse))) setDiffuse(diffuse);
+				if (ImGui::ColorEdit3("Specular", glm::value_ptr(specular))) setSpecular(specular);
+				if (ImGui::DragFloat("Shininess", &shininess, 1.0f, 500.0f, 10.0f)) setShininess(shininess);
+			}
 		}
 		ImGui::End();
 	}
@@ -55,67 +135,38 @@ private:
 
 inline void Model::Draw(Shader* shader) {
 	if (visible) {
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, transforms.position);
-		model = glm::rotate(model, glm::radians(transforms.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)); // Rotate around X-axis
-		model = glm::rotate(model, glm::radians(transforms.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate around Y-axis
-		model = glm::rotate(model, glm::radians(transforms.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f)); // Rotate around Z-axis
-		model = glm::scale(model, glm::vec3(transforms.size));
-
 		shader->use();
-		shader->setMat4("model", model);
-		shader->setBool("useTextureScaling", scale_texture);
-		shader->setVec3("material.diffuse", material.diffuse);
-		shader->setVec3("material.specular", material.specular);
-		shader->setFloat("material.shininess", material.shininess);
-
-		// Draw the object
+		// Transforms and material constants come from the object and material
+		// buffers, only the texture table has to be bound here
+		const vector<Mesh>& meshes = data->meshes;
 		for (unsigned int i = 0; i < meshes.size(); i++) {
-			if (scale_texture) {
-				shader->setVec3("objectScale", transforms.size);
-			}
-			meshes[i].Draw(*shader);
+			getMaterial(i)->Bind();
+			meshes[i].Draw(draw_index + i);
 		}
 	}
 }
 
 inline void Model::DrawDepth(Shader* shader) {
 	if (visible) {
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, transforms.position);
-		model = glm::rotate(model, glm::radians(transforms.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)); // Rotate around X-axis
-		model = glm::rotate(model, glm::radians(transforms.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate around Y-axis
-		model = glm::rotate(model, glm::radians(transforms.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f)); // Rotate around Z-axis
-		model = glm::scale(model, glm::vec3(transforms.size));
-
 		shader->use();
-		shader->setMat4("model", model);
-		// Draw the object
+		const vector<Mesh>& meshes = data->meshes;
 		for (unsigned int i = 0; i < meshes.size(); i++) {
-			meshes[i].Draw(*shader);
+			meshes[i].Draw(draw_index + i);
 		}
 	}
 }
 
 inline void Model::DrawStencil(Shader* select_shader){
-	// Draw the outline
-	glm::mat4 model = glm::mat4(1.0f);
-	model = glm::translate(model, transforms.position);
-	model = glm::rotate(model, glm::radians(transforms.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)); // Rotate around X-axis
-	model = glm::rotate(model, glm::radians(transforms.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate around Y-axis
-	model = glm::rotate(model, glm::radians(transforms.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f)); // Rotate around Z-axis
-	model = glm::scale(model, glm::vec3(transforms.size));
-	//model = model + glm::mat4(0.03);
-	model = glm::scale(model, glm::vec3(1.04f)); // Scale up for outline
-
+	// Draw the outline, the shader scales the object up by outlineScale
 	select_shader->use();
-	select_shader->setMat4("model", model);
+	const vector<Mesh>& meshes = data->meshes;
 	for (unsigned int i = 0; i < meshes.size(); i++) {
-		meshes[i].Draw(*select_shader);
+		meshes[i].Draw(draw_index + i);
 	}
 }
 
 inline void Model:: loadModel(string path){
+	PROFILE_SCOPE("Model::loadModel");
 	Assimp::Importer import;
 	const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate |
 		aiProcess_FlipUVs);
@@ -124,7 +175,7 @@ inline void Model:: loadModel(string path){
 		cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
 		return;
 	}
-	directory = path.substr(0, path.find_last_of('/'));
+	data->directory = path.substr(0, path.find_last_of('/'));
 	processNode(scene->mRootNode, scene);
 }
 
@@ -132,7 +183,7 @@ inline void Model::processNode(aiNode* node, const aiScene* scene){
 	// process all the nodes meshes (if any)
 	for (unsigned int i = 0; i < node->mNumMeshes; i++){
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		data->meshes.push_back(processMesh(mesh, scene));
 	}
 	// then do the same for each of its children
 	for (unsigned int i = 0; i < node->mNumChildren; i++){
@@ -203,11 +254,11 @@ inline vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureTyp
 		mat->GetTexture(type, i, &str);
 		// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
 		bool skip = false;
-		for (unsigned int j = 0; j < textures_loaded.size(); j++)
+		for (unsigned int j = 0; j < data->textures_loaded.size(); j++)
 		{
-			if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+			if (std::strcmp(data->textures_loaded[j].path.data(), str.C_Str()) == 0)
 			{
-				textures.push_back(textures_loaded[j]);
+				textures.push_back(data->textures_loaded[j]);
 				skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
 				break;
 			}
@@ -215,11 +266,11 @@ inline vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureTyp
 		if (!skip)
 		{   // if texture hasn't been loaded already, load it
 			Texture texture;
-			texture.id = TextureFromFile(str.C_Str(), this->directory);
+			texture.id = TextureFromFile(str.C_Str(), data->directory);
 			texture.type = typeName;
 			texture.path = str.C_Str();
 			textures.push_back(texture);
-			textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+			data->textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
 		}
 	}
 	return textures;
@@ -227,6 +278,7 @@ inline vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureTyp
 
 inline unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
 {
+	PROFILE_SCOPE("TextureFromFile");
 	string filename = string(path);
 	filename = directory + '/' + filename;
 
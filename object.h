@@ -6,6 +6,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <string>
 
 #include <SHADER/shader_c.h>
@@ -33,9 +34,22 @@ protected:
   bool visible = 1;
   bool selected = 0;
   Transforms transforms;
+  // Bumped on every change that has to reach the GPU. Values are unique
+  // across all objects so a consumer can compare against what it uploaded.
+  unsigned int revision = NextRevision();
+
+  static unsigned int NextRevision() {
+    static unsigned int counter = 0;
+    return ++counter;
+  }
 
 public:
   std::string name = "Object";
+  // Transforms are relative to the parent, which must outlive this object
+  // (Scene::Delete detaches the children of a deleted object)
+  Object* parent = nullptr;
+  // Never moves after creation, set by scene builders
+  bool is_static = false;
   // Constructors
   Object(Transforms t) : transforms(t) {}
   Object(glm::vec3 position = POSITION, glm::vec3 rotation = ROTATION, glm::vec3 size = SIZE) {
@@ -56,14 +70,43 @@ public:
   virtual glm::vec3 getRotation() const { return transforms.rotation; }
   virtual glm::vec3 getSize() const { return transforms.size; }
 
+  // Also changes when any parent changes: revisions only grow, so the
+  // newest one along the chain does
+  unsigned int GetRevision() const {
+    return parent ? std::max(revision, parent->GetRevision()) : revision;
+  }
+  void MarkDirty() { revision = NextRevision(); }
+
+  glm::mat4 GetModelMatrix() const {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, transforms.position);
+    model = glm::rotate(model, glm::radians(transforms.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)); // Rotate around X-axis
+    model = glm::rotate(model, glm::radians(transforms.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate around Y-axis
+    model = glm::rotate(model, glm::radians(transforms.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f)); // Rotate around Z-axis
+    model = glm::scale(model, glm::vec3(transforms.size));
+    return parent ? parent->GetModelMatrix() * model : model;
+  }
+
   // Setters
   virtual void SetID(unsigned int id) { ID = id; }
   virtual void setSelection(bool sel) { selected = sel; }
   virtual void setVisibility(bool vis) { visible = vis; }
 
-  virtual void setPosition(const glm::vec3& pos) { transforms.position = pos; }
-  virtual void setRotation(const glm::vec3& rot) { transforms.rotation = rot; }
-  virtual void setSize(const glm::vec3& s) { transforms.size = s; }
+  virtual void setPosition(const glm::vec3& pos) {
+    if (pos == transforms.position) return;
+    transforms.position = pos;
+    MarkDirty();
+  }
+  virtual void setRotation(const glm::vec3& rot) {
+    if (rot == transforms.rotation) return;
+    transforms.rotation = rot;
+    MarkDirty();
+  }
+  virtual void setSize(const glm::vec3& s) {
+    if (s == transforms.size) return;
+    transforms.size = s;
+    MarkDirty();
+  }
 
 
   // Pure virtual function for child classes
@@ -75,9 +118,9 @@ public:
       ImGui::Checkbox("Visible", &visible);
 
       // Transform controls
-      ImGui::DragFloat3("Position", glm::value_ptr(transforms.position), 0.1f);
-      ImGui::DragFloat3("Rotation", glm::value_ptr(transforms.rotation), 0.1f);
-      ImGui::DragFloat3("Size", glm::value_ptr(transforms.size), 0.1f);
+      if (ImGui::DragFloat3("Position", glm::value_ptr(transforms.position), 0.1f)) MarkDirty();
+      if (ImGui::DragFloat3("Rotation", glm::value_ptr(transforms.rotation), 0.1f)) MarkDirty();
+      if (ImGui::DragFloat3("Size", glm::value_ptr(transforms.size), 0.1f)) MarkDirty();
     }
     ImGui::End();
   }
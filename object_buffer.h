@@ -0,0 +1,139 @@
+#ifndef OBJECT_BUFFER_H_
+#define OBJECT_BUFFER_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "object.h"
+#include "model.h"
+
+// Binding points of the Objects and Draws SSBOs in the shaders
+const unsigned int OBJECT_BUFFER_BINDING = 3;
+const unsigned int DRAW_BUFFER_BINDING = 5;
+
+// Per-object GPU record, std430 (must match ObjectData in the shaders)
+struct ObjectData {
+  glm::mat4 model;
+  glm::mat4 normalMatrix;  // transpose(inverse(model)), precomputed on the CPU
+  glm::vec4 scale;         // xyz - object scale used for texture scaling
+  glm::uvec4 flags;        // x - useTextureScaling
+};
+
+// Per-draw GPU record, one for every mesh of every model. aDrawIndex in the
+// shaders indexes this array.
+struct DrawData {
+  unsigned int object;    // index into Objects
+  unsigned int material;  // index into Materials
+};
+
+// OBJECT BUFFER
+//=-----------------------------=
+// Keeps one ObjectData record per model in a shader storage buffer. Models
+// get a slot in scene order every frame and only records whose owner or
+// revision changed are written and uploaded. Draw records are laid out the
+// same way, meshes of a model are consecutive starting at Model::draw_index.
+class ObjectBuffer {
+  unsigned int ssbo_ = 0;
+  size_t capacity_ = 0;  // records allocated on the GPU
+
+  std::vector<ObjectData> records_;
+  std::vector<const Object*> owners_;     // model that wrote each slot
+  std::vector<unsigned int> revisions_;   // revision uploaded for each slot
+
+  unsigned int draw_ssbo_ = 0;
+  size_t draw_capacity_ = 0;
+  std::vector<DrawData> draws_;
+
+public:
+  ~ObjectBuffer() {
+    if (ssbo_) glDeleteBuffers(1, &ssbo_);
+    if (draw_ssbo_) glDeleteBuffers(1, &draw_ssbo_);
+  }
+
+  size_t size() const { return records_.size(); }
+  size_t draw_count() const { return draws_.size(); }
+
+  void Update(const std::vector<Object*>& objects) {
+    size_t count = 0;
+    size_t dirty_begin = SIZE_MAX, dirty_end = 0;
+    size_t draw_count = 0;
+    size_t draw_dirty_begin = SIZE_MAX, draw_dirty_end = 0;
+
+    for (auto obj : objects) {
+      auto model = dynamic_cast<Model*>(obj);
+      if (!model) continue;
+
+      if (count == records_.size()) {
+        records_.emplace_back();
+        owners_.push_back(nullptr);
+        revisions_.push_back(0);
+      }
+      if (owners_[count] != model || revisions_[count] != model->GetRevision()) {
+        Write(records_[count], *model);
+        owners_[count] = model;
+        revisions_[count] = model->GetRevision();
+        dirty_begin = std::min(dirty_begin, count);
+        dirty_end = count + 1;
+      }
+      model->object_index = (unsigned int)count;
+
+      model->draw_index = (unsigned int)draw_count;
+      for (unsigned int i = 0; i < model->GetMeshes().size(); i++) {
+        DrawData draw = { (unsigned int)count, model->getMaterial(i)->GetID() };
+        if (draw_count == draws_.size()) draws_.push_back({ ~0u, ~0u });
+        if (draws_[draw_count].object != draw.object || draws_[draw_count].material != draw.material) {
+          draws_[draw_count] = draw;
+          draw_dirty_begin = std::min(draw_dirty_begin, draw_count);
+          draw_dirty_end = draw_count + 1;
+        }
+        draw_count++;
+      }
+      count++;
+    }
+    records_.resize(count);
+    owners_.resize(count);
+    revisions_.resize(count);
+    draws_.resize(draw_count);
+
+    DrawIndexBuffer::Reserve((unsigned int)draw_count);
+    Upload(draw_ssbo_, draw_capacity_, draws_, draw_dirty_begin, draw_dirty_end);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BUFFER_BINDING, draw_ssbo_);
+
+    Upload(ssbo_, capacity_, records_, dirty_begin, dirty_end);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, ssbo_);
+  }
+
+private:
+  // Uploads the dirty range, or everything when the buffer has to grow
+  template<typename T>
+  static void Upload(unsigned int& ssbo, size_t& capacity, const std::vector<T>& records,
+                     size_t dirty_begin, size_t dirty_end) {
+    if (!ssbo) glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    if (capacity < records.size() || !capacity) {
+      capacity = std::max<size_t>(records.size() * 2, 64);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+      if (!records.empty()) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, records.size() * sizeof(T), records.data());
+    }
+    else if (dirty_begin < dirty_end) {
+      glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                      dirty_begin * sizeof(T),
+                      (dirty_end - dirty_begin) * sizeof(T),
+                      &records[dirty_begin]);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+
+  static void Write(ObjectData& data, const Model& model) {
+    data.model = model.GetModelMatrix();
+    data.normalMatrix = glm::transpose(glm::inverse(data.model));
+    data.scale = glm::vec4(model.getSize(), 0.0f);
+    data.flags = glm::uvec4(model.scale_texture ? 1u : 0u, 0u, 0u, 0u);
+  }
+};
+
+#endif
@@ -0,0 +1,17 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;   // unit cube corner
+
+layout (std140) uniform Matrices
+{
+    mat4 projection;
+    mat4 view;
+};
+
+uniform mat4 model;
+uniform vec3 boundsMin;
+uniform vec3 boundsMax;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(mix(boundsMin, boundsMax, aPos), 1.0);
+}
@@ -0,0 +1,221 @@
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_CULLER_SSE 1
+#include <emmintrin.h>
+#endif
+
+// OCCLUDER SIMPLIFICATION
+//=-----------------------------=
+OccluderMesh SimplifyOccluder(const std::vector<glm::vec3>& positions,
+                              const std::vector<unsigned int>& indices,
+                              unsigned int grid) {
+  OccluderMesh out;
+  if (positions.empty() || grid == 0) return out;
+
+  glm::vec3 lo = positions[0], hi = positions[0];
+  for (const glm::vec3& p : positions) {
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+  glm::vec3 cell = glm::max((hi - lo) / (float)grid, glm::vec3(1e-6f));
+
+  // Output vertex of every occupied cell, in order of first use
+  std::unordered_map<unsigned int, unsigned int> clusters;
+  std::vector<unsigned int> remap(positions.size());
+  std::vector<unsigned int> counts;
+  for (size_t i = 0; i < positions.size(); i++) {
+    glm::uvec3 c = glm::min(glm::uvec3((positions[i] - lo) / cell), glm::uvec3(grid - 1));
+    unsigned int key = (c.x * grid + c.y) * grid + c.z;
+    auto it = clusters.emplace(key, (unsigned int)out.vertices.size());
+    if (it.second) {
+      out.vertices.push_back(glm::vec3(0.0f));
+      counts.push_back(0);
+    }
+    unsigned int index = it.first->second;
+    out.vertices[index] += positions[i];
+    counts[index]++;
+    remap[i] = index;
+  }
+  for (size_t i = 0; i < out.vertices.size(); i++) out.vertices[i] /= (float)counts[i];
+
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+    if (a == b || b == c || a == c) continue;
+    out.indices.insert(out.indices.end(), { a, b, c });
+  }
+  return out;
+}
+
+// OCCLUSION CULLER
+//=-----------------------------=
+void OcclusionCuller::Resize(int width, int height) {
+  width_ = std::max((width + TILE - 1) / TILE, 1) * TILE;
+  height_ = std::max((height + TILE - 1) / TILE, 1) * TILE;
+  tiles_x_ = width_ / TILE;
+  tiles_y_ = height_ / TILE;
+}
+
+void OcclusionCuller::Begin(const glm::mat4& view_projection) {
+  view_projection_ = view_projection;
+  depth_.assign((size_t)width_ * height_, 1.0f);
+  tile_max_.assign((size_t)tiles_x_ * tiles_y_, 1.0f);
+  triangles_ = 0;
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const glm::mat4& model) {
+  glm::mat4 mvp = view_projection_ * model;
+  clip_.resize(mesh.vertices.size());
+  for (size_t i = 0; i < mesh.vertices.size(); i++) clip_[i] = mvp * glm::vec4(mesh.vertices[i], 1.0f);
+
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    const glm::vec4* in[3] = { &clip_[mesh.indices[i]], &clip_[mesh.indices[i + 1]], &clip_[mesh.indices[i + 2]] };
+
+    // Clip against the near plane (z >= -w), a triangle becomes at most a quad
+    glm::vec4 polygon[4];
+    int count = 0;
+    for (int e = 0; e < 3; e++) {
+      const glm::vec4& cur = *in[e];
+      const glm::vec4& next = *in[(e + 1) % 3];
+      float d_cur = cur.z + cur.w, d_next = next.z + next.w;
+      if (d_cur >= 0.0f) polygon[count++] = cur;
+      if ((d_cur >= 0.0f) != (d_next >= 0.0f)) polygon[count++] = cur + (next - cur) * (d_cur / (d_cur - d_next));
+    }
+    if (count < 3) continue;
+
+    glm::vec3 screen[4];
+    for (int v = 0; v < count; v++) {
+      glm::vec3 ndc = glm::vec3(polygon[v]) / polygon[v].w;
+      screen[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * width_, (ndc.y * 0.5f + 0.5f) * height_, ndc.z);
+    }
+    for (int v = 1; v + 1 < count; v++) RasterizeTriangle(screen[0], screen[v], screen[v + 1]);
+    triangles_++;
+  }
+}
+
+void OcclusionCuller::RasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+  glm::vec3 a = v0, b = v1, c = v2;
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  if (!(area != 0.0f)) return;
+  // Occluders are rasterized two-sided, make the winding counter-clockwise
+  if (area < 0.0f) {
+    std::swap(b, c);
+    area = -area;
+  }
+
+  int min_x = std::max((int)std::floor(std::min({ a.x, b.x, c.x })), 0);
+  int max_x = std::min((int)std::ceil(std::max({ a.x, b.x, c.x })), width_ - 1);
+  int min_y = std::max((int)std::floor(std::min({ a.y, b.y, c.y })), 0);
+  int max_y = std::min((int)std::ceil(std::max({ a.y, b.y, c.y })), height_ - 1);
+  if (min_x > max_x || min_y > max_y) return;
+  min_x &= ~3;
+
+  // Edge functions A * x + B * y + C, positive inside, one per vertex
+  // (zero on the opposite edge). Depth is their weighted sum.
+  float ea_a = b.y - c.y, ea_b = c.x - b.x, ea_c = -(ea_a * b.x + ea_b * b.y);
+  float eb_a = c.y - a.y, eb_b = a.x - c.x, eb_c = -(eb_a * c.x + eb_b * c.y);
+  float ec_a = a.y - b.y, ec_b = b.x - a.x, ec_c = -(ec_a * a.x + ec_b * a.y);
+  float inv_area = 1.0f / area;
+  float dzdx = (ea_a * a.z + eb_a * b.z + ec_a * c.z) * inv_area;
+  float dzdy = (ea_b * a.z + eb_b * b.z + ec_b * c.z) * inv_area;
+  float z0 = (ea_c * a.z + eb_c * b.z + ec_c * c.z) * inv_area;
+
+#ifdef OCCLUSION_CULLER_SSE
+  const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  for (int y = min_y; y <= max_y; y++) {
+    float py = y + 0.5f;
+    __m128 row_a = _mm_set1_ps(ea_b * py + ea_c);
+    __m128 row_b = _mm_set1_ps(eb_b * py + eb_c);
+    __m128 row_c = _mm_set1_ps(ec_b * py + ec_c);
+    __m128 row_z = _mm_set1_ps(dzdy * py + z0);
+    float* row = &depth_[(size_t)y * width_];
+    for (int x = min_x; x <= max_x; x += 4) {
+      __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+      __m128 wa = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea_a), px), row_a);
+      __m128 wb = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(eb_a), px), row_b);
+      __m128 wc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ec_a), px), row_c);
+      __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(wa, zero), _mm_cmpge_ps(wb, zero)), _mm_cmpge_ps(wc, zero));
+      if (!_mm_movemask_ps(inside)) continue;
+
+      __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), row_z);
+      __m128 old = _mm_loadu_ps(row + x);
+      __m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(closer, z), _mm_andnot_ps(closer, old)));
+    }
+  }
+#else
+  for (int y = min_y; y <= max_y; y++) {
+    float py = y + 0.5f;
+    float* row = &depth_[(size_t)y * width_];
+    for (int x = min_x; x <= max_x; x++) {
+      float px = x + 0.5f;
+      if (ea_a * px + ea_b * py + ea_c < 0.0f) continue;
+      if (eb_a * px + eb_b * py + eb_c < 0.0f) continue;
+      if (ec_a * px + ec_b * py + ec_c < 0.0f) continue;
+      float z = dzdx * px + dzdy * py + z0;
+      if (z < row[x]) row[x] = z;
+    }
+  }
+#endif
+}
+
+void OcclusionCuller::Finish() {
+  for (int ty = 0; ty < tiles_y_; ty++) {
+    for (int tx = 0; tx < tiles_x_; tx++) {
+      float farthest = -FLT_MAX;
+      for (int y = ty * TILE; y < (ty + 1) * TILE; y++) {
+        const float* row = &depth_[(size_t)y * width_ + tx * TILE];
+        for (int x = 0; x < TILE; x++) farthest = std::max(farthest, row[x]);
+      }
+      tile_max_[ty * tiles_x_ + tx] = farthest;
+    }
+  }
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::mat4& model) const {
+  glm::mat4 mvp = view_projection_ * model;
+  float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+  float nearest = FLT_MAX;
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner((i & 1) ? bounds_max.x : bounds_min.x,
+                     (i & 2) ? bounds_max.y : bounds_min.y,
+                     (i & 4) ? bounds_max.z : bounds_min.z);
+    glm::vec4 p = mvp * glm::vec4(corner, 1.0f);
+    // Crossing the near plane, nothing sensible to test
+    if (p.z + p.w <= 0.0f || p.w <= 0.0f) return true;
+    glm::vec3 ndc = glm::vec3(p) / p.w;
+    float sx = (ndc.x * 0.5f + 0.5f) * width_;
+    float sy = (ndc.y * 0.5f + 0.5f) * height_;
+    min_x = std::min(min_x, sx); max_x = std::max(max_x, sx);
+    min_y = std::min(min_y, sy); max_y = std::max(max_y, sy);
+    nearest = std::min(nearest, ndc.z);
+  }
+
+  int x0 = std::max((int)std::floor(min_x), 0), x1 = std::min((int)std::ceil(max_x), width_ - 1);
+  int y0 = std::max((int)std::floor(min_y), 0), y1 = std::min((int)std::ceil(max_y), height_ - 1);
+  // Off screen, frustum culling is not done here
+  if (x0 > x1 || y0 > y1) return true;
+
+  for (int ty = y0 / TILE; ty <= y1 / TILE; ty++) {
+    for (int tx = x0 / TILE; tx <= x1 / TILE; tx++) {
+      // Whole tile in front of the box
+      if (tile_max_[ty * tiles_x_ + tx] < nearest) continue;
+
+      int px0 = std::max(x0, tx * TILE), px1 = std::min(x1, tx * TILE + TILE - 1);
+      int py0 = std::max(y0, ty * TILE), py1 = std::min(y1, ty * TILE + TILE - 1);
+      for (int y = py0; y <= py1; y++) {
+        const float* row = &depth_[(size_t)y * width_];
+        for (int x = px0; x <= px1; x++) {
+          if (row[x] >= nearest) return true;
+        }
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,65 @@
+#ifndef OCCLUSION_CULLER_H_
+#define OCCLUSION_CULLER_H_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Triangle soup used to rasterize an occluder, in model space
+struct OccluderMesh {
+  std::vector<glm::vec3> vertices;
+  std::vector<unsigned int> indices;
+};
+
+// Vertex clustering: vertices are merged per cell of a grid^3 lattice over
+// the mesh bounds and collapsed triangles are dropped. The surface moves
+// by at most one cell, so keep the grid fine for thin occluders.
+OccluderMesh SimplifyOccluder(const std::vector<glm::vec3>& positions,
+                              const std::vector<unsigned int>& indices,
+                              unsigned int grid = 16);
+
+// OCCLUSION CULLER
+//=-----------------------------=
+// Rasterizes occluders into a small CPU depth buffer (NDC depth, 1 - far)
+// four pixels at a time with SSE, then keeps the farthest depth of every
+// TILE x TILE block. Bounds are tested against the tiles first and only
+// the partly covered ones per pixel. Single threaded and free of GL, the
+// same input always gives the same result.
+class OcclusionCuller {
+public:
+  static const int TILE = 8;
+
+private:
+  int width_ = 256, height_ = 144;
+  int tiles_x_ = 256 / TILE, tiles_y_ = 144 / TILE;
+  std::vector<float> depth_;
+  std::vector<float> tile_max_;
+  glm::mat4 view_projection_ = glm::mat4(1.0f);
+  size_t triangles_ = 0;
+
+  std::vector<glm::vec4> clip_;  // scratch, occluder vertices in clip space
+
+public:
+  // Sizes are rounded up to whole tiles
+  void Resize(int width, int height);
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // Clears the depth buffer for a new frame
+  void Begin(const glm::mat4& view_projection);
+  void AddOccluder(const OccluderMesh& mesh, const glm::mat4& model);
+  // Builds the tile bounds, call after the last occluder
+  void Finish();
+
+  // False when the box is behind the occluders on every pixel it covers
+  bool IsVisible(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::mat4& model) const;
+
+  const std::vector<float>& depth() const { return depth_; }
+  size_t triangle_count() const { return triangles_; }
+
+private:
+  // Screen-space x, y in pixels and NDC z
+  void RasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+};
+
+#endif
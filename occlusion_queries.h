@@ -0,0 +1,158 @@
+#ifndef OCCLUSION_QUERIES_H_
+#define OCCLUSION_QUERIES_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+
+#include <SHADER/shader_c.h>
+
+#include "model.h"
+
+// OCCLUSION QUERIES
+//=-----------------------------=
+// Hardware visibility test for models that opted in (Model::occlusion_query).
+// The bounding box is drawn against the depth already in the buffer under a
+// GL_ANY_SAMPLES_PASSED_CONSERVATIVE query and the real draw is wrapped in a
+// GL_QUERY_NO_WAIT conditional render, so the GPU skips it when the box was
+// hidden and draws it when the result is not ready yet.
+//
+// Results are also read back on the CPU one frame late, never waiting. A
+// model last seen visible is drawn without a query for the next
+// VISIBLE_INTERVAL frames, which saves the box draw where it rarely pays off.
+class OcclusionQueries {
+public:
+  static const unsigned int VISIBLE_INTERVAL = 8;
+  // Entries of models not tested for this many frames are released
+  static const unsigned int EXPIRE_FRAMES = 120;
+
+private:
+  struct Entry {
+    GLuint queries[2] = {};        // alternate between frames
+    unsigned int issued[2] = {};   // frame each query was issued in, 0 - result read
+    bool visible = true;           // last result read back
+    unsigned int last_query = 0;   // frame of the last issued query
+    unsigned int last_used = 0;
+  };
+
+  std::unordered_map<const Model*, Entry> entries_;
+  unsigned int frame_ = 0;
+  unsigned int issued_ = 0;  // queries issued this frame
+  unsigned int hidden_ = 0;  // models hidden in the last result read back
+
+  GLuint box_vao_ = 0, box_vbo_ = 0, box_ebo_ = 0;
+
+public:
+  ~OcclusionQueries() {
+    for (auto& it : entries_) glDeleteQueries(2, it.second.queries);
+    if (box_vao_) glDeleteVertexArrays(1, &box_vao_);
+    if (box_vbo_) glDeleteBuffers(1, &box_vbo_);
+    if (box_ebo_) glDeleteBuffers(1, &box_ebo_);
+  }
+
+  unsigned int issued() const { return issued_; }
+  unsigned int hidden() const { return hidden_; }
+
+  // Reads back every finished query and drops stale entries, once per frame
+  void NewFrame() {
+    frame_++;
+    issued_ = 0;
+    hidden_ = 0;
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      Entry& entry = it->second;
+      if (frame_ - entry.last_used > EXPIRE_FRAMES) {
+        glDeleteQueries(2, entry.queries);
+        it = entries_.erase(it);
+        continue;
+      }
+      // Older query first, so the newest available result wins
+      for (int i = 0; i < 2; i++) {
+        int slot = (frame_ + i) & 1;
+        if (!entry.issued[slot]) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(entry.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint passed = 0;
+        glGetQueryObjectuiv(entry.queries[slot], GL_QUERY_RESULT, &passed);
+        entry.visible = passed != 0;
+        entry.issued[slot] = 0;
+      }
+      if (!entry.visible) hidden_++;
+      ++it;
+    }
+  }
+
+  // Draws the model's bounding box under a query when it needs one. Returns
+  // the query the real draw is conditioned on, 0 to draw it unconditionally.
+  // Color and depth writes are expected to be off.
+  GLuint Test(Shader* box_shader, const Model* model, const glm::vec3& camera_position) {
+    Entry& entry = entries_[model];
+    entry.last_used = frame_;
+    if (!entry.queries[0]) glGenQueries(2, entry.queries);
+
+    // The box is clipped away with the camera inside it
+    glm::mat4 matrix = model->GetModelMatrix();
+    glm::vec3 eye = glm::vec3(glm::inverse(matrix) * glm::vec4(camera_position, 1.0f));
+    glm::vec3 margin = (model->bounds_max - model->bounds_min) * 0.05f;
+    if (glm::all(glm::greaterThanEqual(eye, model->bounds_min - margin)) &&
+        glm::all(glm::lessThanEqual(eye, model->bounds_max + margin))) {
+      entry.visible = true;
+      return 0;
+    }
+    if (entry.visible && frame_ - entry.last_query < VISIBLE_INTERVAL) return 0;
+
+    int slot = frame_ & 1;
+    box_shader->use();
+    box_shader->setMat4("model", matrix);
+    box_shader->setVec3("boundsMin", model->bounds_min);
+    box_shader->setVec3("boundsMax", model->bounds_max);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, entry.queries[slot]);
+    DrawBox();
+    glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+    entry.issued[slot] = frame_;
+    entry.last_query = frame_;
+    issued_++;
+    return entry.queries[slot];
+  }
+
+  static void BeginConditional(GLuint query) {
+    if (query) glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+  }
+
+  static void EndConditional(GLuint query) {
+    if (query) glEndConditionalRender();
+  }
+
+private:
+  // Unit cube, occlusion_box.vert stretches it over the bounds
+  void DrawBox() {
+    if (!box_vao_) {
+      const float vertices[] = {
+        0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,
+        0, 0, 1,  1, 0, 1,  0, 1, 1,  1, 1, 1
+      };
+      const unsigned char indices[] = {
+        0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  // -z, +z
+        0, 1, 4, 1, 5, 4,  2, 6, 3, 3, 6, 7,  // -y, +y
+        0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5   // -x, +x
+      };
+      glGenVertexArrays(1, &box_vao_);
+      glGenBuffers(1, &box_vbo_);
+      glGenBuffers(1, &box_ebo_);
+      glBindVertexArray(box_vao_);
+      glBindBuffer(GL_ARRAY_BUFFER, box_vbo_);
+      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, box_ebo_);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+      glEnableVertexAttribArray(0);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+      glBindVertexArray(0);
+    }
+    glBindVertexArray(box_vao_);
+    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+    glBindVertexArray(0);
+  }
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace profiler {
+
+// Events are stored in fixed chunks so appending never moves old events
+static const size_t kChunkSize = 4096;
+static const size_t kMaxChunks = 1024;  // 4M events per thread and capture
+
+// THREAD BUFFER
+//=-----------------------------=
+// Written only by its thread. count is published with release, so the
+// exporter sees every event and chunk below it.
+struct ThreadBuffer {
+  std::unique_ptr<Event[]> chunks[kMaxChunks];
+  std::atomic<size_t> count{ 0 };
+  uint32_t thread_id = 0;
+  std::string name;
+  bool retired = false;  // thread exited, the next new thread appends to it
+};
+
+static std::atomic<bool> capturing{ false };
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> registry;  // buffers are never freed, threads may outlive a capture
+
+// Capture state, main thread only (FrameMark, RequestCapture)
+static unsigned int frames_requested = 0;
+static unsigned int frames_left = 0;
+static std::string capture_path;
+static uint64_t capture_begin_ns = 0;
+
+// Short-lived threads hand their buffer back on exit and the next new thread
+// takes it over, events and all, so the registry only grows with the number
+// of threads alive at once. Its old owner was joined, so their zones share
+// the track without overlapping.
+struct LocalSlot {
+  ThreadBuffer* buffer = nullptr;
+  ~LocalSlot() {
+    if (!buffer) return;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffer->retired = true;
+  }
+};
+
+static ThreadBuffer& LocalBuffer() {
+  thread_local LocalSlot slot;
+  if (!slot.buffer) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& buffer : registry) {
+      if (buffer->retired) {
+        buffer->retired = false;
+        slot.buffer = buffer.get();
+        break;
+      }
+    }
+    if (!slot.buffer) {
+      registry.push_back(std::make_unique<ThreadBuffer>());
+      slot.buffer = registry.back().get();
+      slot.buffer->thread_id = (uint32_t)registry.size();
+    }
+  }
+  return *slot.buffer;
+}
+
+uint64_t Now() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool IsCapturing() {
+  return capturing.load(std::memory_order_relaxed);
+}
+
+void SetThreadName(const char* name) {
+  ThreadBuffer& buffer = LocalBuffer();
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  buffer.name = name;
+}
+
+static void Append(ThreadBuffer& buffer, const char* name, uint64_t begin_ns, uint64_t end_ns) {
+  size_t index = buffer.count.load(std::memory_order_relaxed);
+  size_t chunk = index / kChunkSize;
+  if (chunk >= kMaxChunks) return;  // full, the rest of the capture is lost
+  if (!buffer.chunks[chunk]) buffer.chunks[chunk].reset(new Event[kChunkSize]);
+  buffer.chunks[chunk][index % kChunkSize] = { name, begin_ns, end_ns };
+  buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void Record(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+  if (!IsCapturing()) return;
+  Append(LocalBuffer(), name, begin_ns, end_ns);
+}
+
+void RecordGpu(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+  if (!IsCapturing()) return;
+  static ThreadBuffer* gpu = [] {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(std::make_unique<ThreadBuffer>());
+    ThreadBuffer* buffer = registry.back().get();
+    buffer->thread_id = (uint32_t)registry.size();
+    buffer->name = "GPU";
+    return buffer;
+  }();
+  Append(*gpu, name, begin_ns, end_ns);
+}
+
+void RequestCapture(unsigned int frames_to_capture, const std::string& path) {
+  if (frames_requested || IsCapturing() || !frames_to_capture) return;
+  frames_requested = frames_to_capture;
+  capture_path = path;
+}
+
+void FrameMark() {
+  if (IsCapturing()) {
+    Record("Frame", capture_begin_ns, Now());
+    if (--frames_left == 0) {
+      capturing.store(false, std::memory_order_relaxed);
+      if (WriteChromeTrace(capture_path)) std::printf("Profiler: trace written to %s\n", capture_path.c_str());
+      else std::printf("Profiler: could not write %s\n", capture_path.c_str());
+    }
+  }
+  if (frames_requested) {
+    // Recording threads are joined or idle at the frame boundary, so clearing is safe
+    {
+      std::lock_guard<std::mutex> lock(registry_mutex);
+      for (auto& buffer : registry) buffer->count.store(0, std::memory_order_relaxed);
+    }
+    frames_left = frames_requested;
+    frames_requested = 0;
+    capturing.store(true, std::memory_order_relaxed);
+  }
+  capture_begin_ns = Now();
+}
+
+// CHROME TRACE EXPORT
+//=-----------------------------=
+static void WriteEscaped(FILE* file, const char* text) {
+  for (const char* c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') std::fputc('\\', file);
+    if ((unsigned char)*c >= 0x20) std::fputc(*c, file);
+  }
+}
+
+bool WriteChromeTrace(const std::string& path) {
+  FILE* file = std::fopen(path.c_str(), "w");
+  if (!file) return false;
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  uint64_t origin = UINT64_MAX;
+  for (auto& buffer : registry) {
+    size_t count = buffer->count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+      const Event& event = buffer->chunks[i / kChunkSize][i % kChunkSize];
+      if (event.begin_ns < origin) origin = event.begin_ns;
+    }
+  }
+
+  // Complete ("X") events, timestamps in microseconds from the first event
+  std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+  bool first = true;
+  for (auto& buffer : registry) {
+    if (!buffer->name.empty()) {
+      std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                   first ? "" : ",\n", buffer->thread_id);
+      WriteEscaped(file, buffer->name.c_str());
+      std::fputs("\"}}", file);
+      first = false;
+    }
+    size_t count = buffer->count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+      const Event& event = buffer->chunks[i / kChunkSize][i % kChunkSize];
+      std::fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+      WriteEscaped(file, event.name);
+      std::fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                   buffer->thread_id, (event.begin_ns - origin) / 1000.0, (event.end_ns - event.begin_ns) / 1000.0);
+      first = false;
+    }
+  }
+  std::fputs("\n]}\n", file);
+  return std::fclose(file) == 0;
+}
+
+}  // namespace profiler
@@ -0,0 +1,89 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <cstdint>
+#include <string>
+
+// CPU PROFILER
+//=-----------------------------=
+// Scoped zones recorded into per-thread buffers and written out as a Chrome
+// trace (chrome://tracing, ui.perfetto.dev). Only the owning thread appends
+// to a buffer, so recording takes no lock: two clock reads and a store.
+// Outside of a capture a zone costs one relaxed atomic load.
+//
+// Captures start and end at frame boundaries (PROFILE_FRAME on the main
+// thread), threads that record must be joined or idle by then, like the
+// light clustering workers waiting for their next job. Without
+// ENABLE_PROFILER the macros expand to nothing.
+namespace profiler {
+
+// Zone names must outlive the capture, string literals or __func__
+struct Event {
+  const char* name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+// Steady clock in nanoseconds
+uint64_t Now();
+
+bool IsCapturing();
+
+// Records frames_to_capture frames starting with the next frame and writes
+// them to path when done. Ignored while a capture is running.
+void RequestCapture(unsigned int frames_to_capture, const std::string& path = "trace.json");
+
+// Frame boundary, starts and finishes pending captures
+void FrameMark();
+
+// Names the calling thread in the trace
+void SetThreadName(const char* name);
+
+// Appends a finished zone of the calling thread
+void Record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+// Appends a zone to the "GPU" track, timestamps already on the Now() clock.
+// Main thread only.
+void RecordGpu(const char* name, uint64_t begin_ns, uint64_t end_ns);
+
+// Writes every recorded event as Chrome trace JSON, false on I/O errors
+bool WriteChromeTrace(const std::string& path);
+
+class Zone {
+  const char* name_;
+  uint64_t begin_;
+
+public:
+  explicit Zone(const char* name) : name_(name), begin_(IsCapturing() ? Now() : 0) {}
+  ~Zone() { End(); }
+  // Ends the zone before the scope does
+  void End() {
+    if (begin_) Record(name_, begin_, Now());
+    begin_ = 0;
+  }
+  Zone(const Zone&) = delete;
+  Zone& operator=(const Zone&) = delete;
+};
+
+}  // namespace profiler
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) profiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+// Named zone for sections that do not match a scope, closed with PROFILE_END
+#define PROFILE_ZONE(zone, name) profiler::Zone zone(name)
+#define PROFILE_END(zone) zone.End()
+#define PROFILE_FRAME() profiler::FrameMark()
+#define PROFILE_THREAD(name) profiler::SetThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_ZONE(zone, name) ((void)0)
+#define PROFILE_END(zone) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+#endif
@@ -2,8 +2,37 @@
 out vec4 FragColor;
 in vec2 TexCoords;
 uniform sampler2D screenTexture;
-const float offset = 1.0 / 300.0;
+
+// Dynamic resolution: the frame was rendered into the lower left
+// renderSize texels of screenTexture and is stretched over the window
+uniform vec2 renderSize;
+uniform int upscaleFilter;  // 0 - bilinear, 1 - sharpen (UpscaleFilter)
+uniform float sharpness;
+
+// Bilinear tap inside the rendered area, never blends in stale texels
+vec3 Tap(vec2 texel)
+{
+	vec2 size = vec2(textureSize(screenTexture, 0));
+	texel = clamp(texel, vec2(0.5), renderSize - 0.5);
+	return texture(screenTexture, texel / size).rgb;
+}
+
 void main()
 {
-	FragColor = texture(screenTexture, TexCoords);
+	vec2 texel = TexCoords * renderSize;
+	vec3 color = Tap(texel);
+	if (upscaleFilter == 1)
+	{
+		// Unsharp mask over a cross one source texel wide, the result is
+		// clamped to the neighborhood so edges do not ring
+		vec3 n = Tap(texel + vec2(0.0, 1.0));
+		vec3 s = Tap(texel - vec2(0.0, 1.0));
+		vec3 e = Tap(texel + vec2(1.0, 0.0));
+		vec3 w = Tap(texel - vec2(1.0, 0.0));
+		vec3 lo = min(color, min(min(n, s), min(e, w)));
+		vec3 hi = max(color, max(max(n, s), max(e, w)));
+		vec3 sharpened = color + sharpness * (4.0 * color - n - s - e - w);
+		color = clamp(sharpened, lo, hi);
+	}
+	FragColor = vec4(color, 1.0);
 }
@@ -0,0 +1,62 @@
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include <algorithm>
+#include <vector>
+
+#include <SHADER/shader_c.h>
+
+#include "mesh.h"
+#include "material.h"
+#include "model.h"
+
+// One mesh draw, draw_index is the record read by the shaders via aDrawIndex
+struct DrawItem {
+  const Mesh* mesh;
+  const Material* material;
+  unsigned int draw_index;
+  const Model* model;  // for CPU culling of the mesh bounds
+};
+
+// RENDER QUEUE
+//=-----------------------------=
+// Flat list of mesh draws for one pass. Sorting by material id lets Submit
+// bind each texture table once per batch instead of once per mesh.
+class RenderQueue {
+  std::vector<DrawItem> items_;
+
+public:
+  void Clear() { items_.clear(); }
+  bool empty() const { return items_.empty(); }
+  size_t size() const { return items_.size(); }
+  const std::vector<DrawItem>& items() const { return items_; }
+
+  void Add(const Model* model) {
+    const vector<Mesh>& meshes = model->GetMeshes();
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+      items_.push_back({ &meshes[i], model->getMaterial(i), model->draw_index + i, model });
+    }
+  }
+
+  void SortByMaterial() {
+    std::stable_sort(items_.begin(), items_.end(), [](const DrawItem& a, const DrawItem& b) {
+      return a.material->GetID() < b.material->GetID();
+    });
+  }
+
+  // Depth-only passes skip the material binds
+  void Submit(Shader* shader, bool bind_materials = true) const {
+    if (items_.empty()) return;
+    shader->use();
+    const Material* bound = nullptr;
+    for (const DrawItem& item : items_) {
+      if (bind_materials && item.material != bound) {
+        item.material->Bind();
+        bound = item.material;
+      }
+      item.mesh->Draw(item.draw_index);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef RENDER_TARGET_POOL_H_
+#define RENDER_TARGET_POOL_H_
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Everything that makes two render targets interchangeable
+struct RenderTargetDesc {
+  GLenum format = GL_RGBA8;
+  int width = 0, height = 0;
+  GLenum filter = GL_NEAREST;  // min and mag filter
+
+  bool operator==(const RenderTargetDesc& other) const {
+    return format == other.format && width == other.width && height == other.height && filter == other.filter;
+  }
+  bool operator!=(const RenderTargetDesc& other) const { return !(*this == other); }
+};
+
+// RENDER TARGET POOL
+//=-----------------------------=
+// Owns the screen-sized textures of the renderer. Acquire hands out a free
+// texture with the same descriptor when there is one, so passes that need
+// a target of the same kind share it, and a resize back to a size seen a
+// moment ago costs nothing. Released textures stay free for KEEP_FRAMES
+// frames; after that they are retired behind a fence and deleted once the
+// GPU has passed it, so a resize never waits on frames still in flight.
+class RenderTargetPool {
+  struct Entry {
+    GLuint texture;
+    RenderTargetDesc desc;
+    bool in_use;
+    unsigned int released_frame;
+  };
+  // Textures retired in the same frame, deleted when fence signals
+  struct Retired {
+    std::vector<GLuint> textures;
+    GLsync fence;
+  };
+
+  std::vector<Entry> entries_;
+  std::vector<Retired> retired_;
+  unsigned int frame_ = 0;
+
+public:
+  static const unsigned int KEEP_FRAMES = 3;
+
+  RenderTargetPool() = default;
+  RenderTargetPool(const RenderTargetPool&) = delete;
+  RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+  ~RenderTargetPool() {
+    for (const Entry& entry : entries_) glDeleteTextures(1, &entry.texture);
+    for (const Retired& retired : retired_) {
+      glDeleteSync(retired.fence);
+      glDeleteTextures((GLsizei)retired.textures.size(), retired.textures.data());
+    }
+  }
+
+  GLuint Acquire(const RenderTargetDesc& desc) {
+    for (Entry& entry : entries_) {
+      if (!entry.in_use && entry.desc == desc) {
+        entry.in_use = true;
+        return entry.texture;
+      }
+    }
+
+    GLuint texture = 0;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureStorage2D(texture, 1, desc.format, desc.width, desc.height);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, desc.filter);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, desc.filter);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Depth-stencil targets are sampled as depth
+    if (desc.format == GL_DEPTH24_STENCIL8 || desc.format == GL_DEPTH32F_STENCIL8)
+      glTextureParameteri(texture, GL_DEPTH_STENCIL_TEXTURE_MODE, GL_DEPTH_COMPONENT);
+    entries_.push_back({ texture, desc, true, 0 });
+    return texture;
+  }
+
+  void Release(GLuint texture) {
+    for (Entry& entry : entries_) {
+      if (entry.texture == texture) {
+        entry.in_use = false;
+        entry.released_frame = frame_;
+        return;
+      }
+    }
+  }
+
+  // Once per frame, before any Acquire: retires textures that stayed free
+  // too long and deletes the retired ones the GPU is done with
+  void NewFrame() {
+    frame_++;
+    Retired retired;
+    for (size_t i = 0; i < entries_.size();) {
+      const Entry& entry = entries_[i];
+      if (entry.in_use || frame_ - entry.released_frame < KEEP_FRAMES) {
+        i++;
+        continue;
+      }
+      retired.textures.push_back(entry.texture);
+      entries_[i] = entries_.back();
+      entries_.pop_back();
+    }
+    if (!retired.textures.empty()) {
+      retired.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      retired_.push_back(std::move(retired));
+    }
+
+    for (size_t i = 0; i < retired_.size();) {
+      GLenum state = glClientWaitSync(retired_[i].fence, 0, 0);
+      if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED) {
+        i++;
+        continue;
+      }
+      glDeleteSync(retired_[i].fence);
+      glDeleteTextures((GLsizei)retired_[i].textures.size(), retired_[i].textures.data());
+      if (i + 1 < retired_.size()) retired_[i] = std::move(retired_.back());
+      retired_.pop_back();
+    }
+  }
+
+  size_t texture_count() const { return entries_.size(); }
+
+  // Estimated video memory of the pooled textures, retired ones excluded
+  size_t bytes() const {
+    size_t total = 0;
+    for (const Entry& entry : entries_) total += Bytes(entry.desc);
+    return total;
+  }
+
+  static size_t Bytes(const RenderTargetDesc& desc) {
+    return (size_t)desc.width * desc.height * BytesPerTexel(desc.format);
+  }
+
+private:
+  static size_t BytesPerTexel(GLenum format) {
+    switch (format) {
+    case GL_RG16:
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_DEPTH24_STENCIL8:
+    case GL_R32F:
+      return 4;
+    case GL_RGB8:
+      return 3;
+    case GL_RGBA16F:
+    case GL_DEPTH32F_STENCIL8:
+      return 8;
+    default:
+      return 4;
+    }
+  }
+};
+
+#endif
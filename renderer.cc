@@ -14,6 +14,7 @@ void SetupImGUI(Window* window) {
 
 Renderer::Renderer(Window* window, Scene* scene) {
 	SetupImGUI(window);
+	frame_stats::InstallGLHooks();
 
   window_ = window;
   scene_ = scene;
@@ -32,90 +33,37 @@ Renderer::Renderer(Window* window, Scene* scene) {
   single_color_ = new Shader("shader.vert", "single_color.frag");
   skybox_shader_ = new Shader("skybox.vert", "skybox.frag");
   DLdepth_shader_ = new Shader("depthShader.vert", "DLightDepthShader.frag", "DLightDepthShader.geom");
-  PLdepth_shader_ = new Shader("PlightDepthShader.vert", "PLightDepthShader.frag", "PLightDepthShader.geom");
-
-  //GLuint cubeMapArray;
-  glGenTextures(1, &cubeMapArray);
-  glBindTexture(GL_TEXTURE_2D_ARRAY, cubeMapArray);
-  glTexImage3D(
-    GL_TEXTURE_2D_ARRAY,
-    0,
-    GL_DEPTH_COMPONENT16,
-    scene_->properties.PLShadowResolution,
-    scene_->properties.PLShadowResolution,
-    20 * 6,
-    0,
-    GL_DEPTH_COMPONENT,
-    GL_FLOAT,
-    nullptr);
-
-  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-  constexpr float bordercolor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-  glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, bordercolor);
-
-  //GLuint depthMapFBO;
-  glGenFramebuffers(1, &depthMapFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeMapArray, 0);
-  glDrawBuffer(GL_NONE);
-  glReadBuffer(GL_NONE);
-
-  int status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-  if (status != GL_FRAMEBUFFER_COMPLETE)
-  {
-    std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!";
-    throw 0;
+  gbuffer_shader_ = new Shader("shader.vert", "gbuffer.frag");
+  depth_prepass_shader_ = new Shader("depth_prepass.vert", "depth_prepass.frag");
+  occlusion_box_shader_ = new Shader("occlusion_box.vert", "depth_prepass.frag");
+  deferred_shader_ = new Shader("quad.vert", "deferred_lighting.frag");
+  DLdepth_cascade_shader_ = new Shader("depthShader.vert", "DLightDepthShader.frag", "DLightDepthCascade.geom");
+  shadow_atlas_shader_ = new Shader("shadow_atlas.vert", "DLightDepthShader.frag");
+  // Cascades without the geometry shader where the driver lets the vertex
+  // shader write gl_Layer, the geometry shader variants above stay as fallback
+  if (LayeredShadowBatch::Supported()) {
+    layered_depth_shader_ = new Shader("depth_layered.vert", "DLightDepthShader.frag");
+    layered_cascade_shader_ = new Shader("depth_cascade.vert", "DLightDepthShader.frag");
   }
-
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-  //// Create a cube map array
-	//GLuint cubeMapArray;
-	//glGenTextures(1, &cubeMapArray);
-	//GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, cubeMapArray));
-
-	//// Allocate storage for the cube map array
-	//GL_CHECK(glTexStorage3D(
-	//    GL_TEXTURE_CUBE_MAP_ARRAY,
-	//    1,                         
-	//    GL_DEPTH_COMPONENT16,   
-	//    scene.properties.PLShadowResolution, scene.properties.PLShadowResolution,
-	//    20 * 6       
-	//));
-
-	//// Set texture parameters
-	//glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	//glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	//glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	//glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	//glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	//GLuint depthMapFBO;
-	//glGenFramebuffers(1, &depthMapFBO);
-	//glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-
-	//glDrawBuffer(GL_NONE); // No color buffer is drawn to
-	//glReadBuffer(GL_NONE); // No color buffer is read from
-
-	//glBindFramebuffer(GL_FRAMEBUFFER, 0); // Unbind the FBO
-
-	//// Bind the cube map array to a texture unit
-	//glActiveTexture(GL_TEXTURE4);
-	//GL_CHECK(glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, cubeMapArray));
+  cull_shader_ = new ComputeShader("cull.comp");
+  hiz_shader_ = new ComputeShader("hiz.comp");
+  depth_bounds_shader_ = new ComputeShader("depth_bounds.comp");
 
   unsigned int shader_ub = glGetUniformBlockIndex(model_shader_->ID, "Matrices");
   unsigned int light_shader_ub = glGetUniformBlockIndex(light_shader_->ID, "Matrices");
   unsigned int single_color_ub = glGetUniformBlockIndex(single_color_->ID, "Matrices");
   unsigned int skyboxShader_ub = glGetUniformBlockIndex(skybox_shader_->ID, "Matrices");
+  unsigned int gbuffer_ub = glGetUniformBlockIndex(gbuffer_shader_->ID, "Matrices");
+  unsigned int depth_prepass_ub = glGetUniformBlockIndex(depth_prepass_shader_->ID, "Matrices");
+  unsigned int occlusion_box_ub = glGetUniformBlockIndex(occlusion_box_shader_->ID, "Matrices");
 
   glUniformBlockBinding(model_shader_->ID, shader_ub, 0);
   glUniformBlockBinding(light_shader_->ID, light_shader_ub, 0);
   glUniformBlockBinding(single_color_->ID, single_color_ub, 0);
   glUniformBlockBinding(skybox_shader_->ID, skyboxShader_ub, 0);
+  glUniformBlockBinding(gbuffer_shader_->ID, gbuffer_ub, 0);
+  glUniformBlockBinding(depth_prepass_shader_->ID, depth_prepass_ub, 0);
+  glUniformBlockBinding(occlusion_box_shader_->ID, occlusion_box_ub, 0);
 
   //unsigned int uboMatrices;
   glGenBuffers(1, &uboMatrices);
@@ -124,43 +72,12 @@ Renderer::Renderer(Window* window, Scene* scene) {
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
   glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
 
+  single_color_->use();
+  single_color_->setFloat("outlineScale", 1.04f);
+
   model_shader_->use();
-  model_shader_->setInt("PLshadowMapArray", 4); // Use the same texture unit
+  model_shader_->setInt("shadowAtlas", SHADOW_ATLAS_UNIT);
   skybox_shader_->setInt("skybox", 0);
-  // Creating framebuffer
-  //unsigned int fbo;
-  glGenFramebuffers(1, &frame_buffer);
-  glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
-
-  // generate texture
-  //unsigned int texColorBuffer;
-  glGenTextures(1, &texColorBuffer);
-  glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, window->GetScreenWidth(), window->GetScreenHeight(), 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-  float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-  glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  // attach it to currently bound framebuffer object
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
-
-  // Creating renderbuffer
-  unsigned int rbo;
-  glGenRenderbuffers(1, &rbo);
-  glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, window->GetScreenWidth(), window->GetScreenHeight());
-  glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" <<
-    std::endl;
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
   float quadVertices[] = {
     // positions // texCoords
     -1.0f, 1.0f, 0.0f, 1.0f,
@@ -194,7 +111,9 @@ Renderer::Renderer(Window* window, Scene* scene) {
 
   model_shader_->use();
   model_shader_->setInt("DLshadowMap", 3);
-  //shader.setInt("PLshadowMap", 4);
+  deferred_shader_->use();
+  deferred_shader_->setInt("DLshadowMap", 3);
+  deferred_shader_->setInt("shadowAtlas", SHADOW_ATLAS_UNIT);
   // DEBUG QUAD SETUP
   // =----------------------=
   Shader debugDepthQuad("quad.vert", "debug_quad.frag");
@@ -202,16 +121,320 @@ Renderer::Renderer(Window* window, Scene* scene) {
   debugDepthQuad.setInt("depthMap", 0);
 }
 
+// Same projection the camera writes into the Matrices block
+static glm::mat4 CameraProjection(Camera* camera) {
+	return glm::perspective(glm::radians(camera->Zoom),
+		(float)camera->screenWidth / (float)camera->screenHeight, camera->getNear(), camera->getFar());
+}
+
+void Renderer::UpdateLightClusters(Camera* camera) {
+	PROFILE_FUNCTION();
+	std::vector<ClusterLight> points, spots;
+	points.reserve(light_buffer_.point_lights.size());
+	spots.reserve(light_buffer_.spot_lights.size());
+	for (const auto& light : light_buffer_.point_lights) {
+		points.push_back({ light.position, light.radius });
+	}
+	for (const auto& light : light_buffer_.spot_lights) {
+		spots.push_back(SpotBoundingSphere(light.position, light.direction, light.radius, light.outerCutOff));
+	}
+
+	float near_plane = camera->getNear();
+	float far_plane = camera->getFar();
+	glm::mat4 projection = CameraProjection(camera);
+	light_clusters_.Build(camera->GetViewMatrix(), projection, near_plane, far_plane, points, spots);
+
+	// The lists change every frame, orphan and refill
+	const auto& clusters = light_clusters_.clusters();
+	const auto& indices = light_clusters_.indices();
+	if (!cluster_ssbo_) glGenBuffers(1, &cluster_ssbo_);
+	if (!cluster_index_ssbo_) glGenBuffers(1, &cluster_index_ssbo_);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cluster_ssbo_);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, clusters.size() * sizeof(ClusterData), clusters.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cluster_index_ssbo_);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(indices.size(), 1) * sizeof(unsigned int),
+		indices.empty() ? nullptr : indices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTER_BINDING, cluster_ssbo_);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BINDING, cluster_index_ssbo_);
+
+	// Cluster lookup parameters, see main() in shader.frag
+	unsigned int grid_x = light_clusters_.grid_x();
+	unsigned int grid_y = light_clusters_.grid_y();
+	unsigned int grid_z = light_clusters_.grid_z();
+	float log_ratio = std::log(far_plane / near_plane);
+	for (Shader* shader : { model_shader_, deferred_shader_ }) {
+		shader->use();
+		glUniform3ui(glGetUniformLocation(shader->ID, "clusterGrid"), grid_x, grid_y, grid_z);
+		glUniform2f(glGetUniformLocation(shader->ID, "clusterTileScale"),
+			grid_x / (float)render_width_, grid_y / (float)render_height_);
+		glUniform2f(glGetUniformLocation(shader->ID, "clusterDepthScale"),
+			grid_z / log_ratio, grid_z * std::log(near_plane) / log_ratio);
+	}
+}
+
+// World-space box of a model, as center and half extent
+static void WorldBounds(const Model* model, glm::vec3& box_center, glm::vec3& box_half) {
+	glm::mat4 matrix = model->GetModelMatrix();
+	glm::vec3 half = (model->bounds_max - model->bounds_min) * 0.5f;
+	box_center = glm::vec3(matrix * glm::vec4((model->bounds_min + model->bounds_max) * 0.5f, 1.0f));
+	box_half = glm::abs(glm::vec3(matrix[0])) * half.x + glm::abs(glm::vec3(matrix[1])) * half.y +
+		glm::abs(glm::vec3(matrix[2])) * half.z;
+}
+
+// World-space box against the clip volume of an orthographic matrix
+static bool BoundsInClip(const glm::mat4& matrix, const glm::vec3& box_center, const glm::vec3& box_half) {
+	glm::vec3 center = glm::vec3(matrix * glm::vec4(box_center, 1.0f));
+	glm::vec3 half = glm::abs(glm::vec3(matrix[0])) * box_half.x + glm::abs(glm::vec3(matrix[1])) * box_half.y +
+		glm::abs(glm::vec3(matrix[2])) * box_half.z;
+	return glm::all(glm::lessThanEqual(glm::abs(center) - half, glm::vec3(1.0f)));
+}
+
+// World-space box of a model against the clip volume of a perspective
+// matrix, conservative: outside only when all corners are beyond one plane
+static bool BoundsInFrustum(const Model* model, const glm::mat4& view_projection) {
+	glm::mat4 matrix = view_projection * model->GetModelMatrix();
+	int outside[6] = {};
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner(i & 1 ? model->bounds_max.x : model->bounds_min.x,
+			i & 2 ? model->bounds_max.y : model->bounds_min.y,
+			i & 4 ? model->bounds_max.z : model->bounds_min.z);
+		glm::vec4 clip = matrix * glm::vec4(corner, 1.0f);
+		for (int axis = 0; axis < 3; axis++) {
+			outside[axis * 2] += clip[axis] < -clip.w;
+			outside[axis * 2 + 1] += clip[axis] > clip.w;
+		}
+	}
+	for (int plane = 0; plane < 6; plane++)
+		if (outside[plane] == 8) return false;
+	return true;
+}
+
+// World-space box of a model against a sphere
+static bool BoundsTouchSphere(const Model* model, const glm::vec3& center, float radius) {
+	glm::vec3 box_center, box_half;
+	WorldBounds(model, box_center, box_half);
+	glm::vec3 offset = glm::clamp(center, box_center - box_half, box_center + box_half) - center;
+	return glm::dot(offset, offset) <= radius * radius;
+}
+
+void Renderer::UpdateShadowAtlas(Camera* camera) {
+	PROFILE_FUNCTION();
+	const Properties& properties = scene_->properties;
+	shadow_atlas_.max_size = (int)properties.shadow_atlas_size;
+	shadow_atlas_.max_tile = (int)properties.shadow_tile_size;
+	shadow_atlas_.min_tile = (int)properties.min_shadow_tile;
+
+	glm::mat4 view_projection = CameraProjection(camera) * camera->GetViewMatrix();
+	glm::vec3 camera_position = glm::vec3(glm::inverse(camera->GetViewMatrix())[3]);
+	float tan_half_fov = std::tan(glm::radians(camera->Zoom) * 0.5f);
+
+	// Lights in the order of their light buffer records
+	std::vector<const Object*> points, spots;
+	for (auto obj : scene_->getObjects()) {
+		if (dynamic_cast<PointLight*>(obj)) points.push_back(obj);
+		else if (dynamic_cast<SpotLight*>(obj)) spots.push_back(obj);
+	}
+
+	// Only lights whose volume is on screen ask for tiles
+	std::vector<float> point_importance(points.size()), spot_importance(spots.size());
+	shadow_atlas_.Begin();
+	for (size_t i = 0; i < points.size(); i++) {
+		const PointLightData& light = light_buffer_.point_lights[i];
+		point_importance[i] = ShadowImportance(view_projection, camera_position, tan_half_fov, light.position, light.radius);
+		shadow_atlas_.Request(points[i], 6, point_importance[i]);
+	}
+	for (size_t i = 0; i < spots.size(); i++) {
+		const SpotLightData& light = light_buffer_.spot_lights[i];
+		ClusterLight bounds = SpotBoundingSphere(light.position, light.direction, light.radius, light.outerCutOff);
+		spot_importance[i] = ShadowImportance(view_projection, camera_position, tan_half_fov, bounds.position, bounds.radius);
+		shadow_atlas_.Request(spots[i], 1, spot_importance[i]);
+	}
+	shadow_atlas_.Finish();
+
+	// One record per tile, a light's shadowIndex is its first tile
+	shadow_tiles_.clear();
+	shadowed_lights_.clear();
+	auto add_tiles = [&](const Object* light, const glm::mat4* matrices, const glm::vec3& center, float radius,
+		float importance) {
+		const std::vector<ShadowTile>* tiles = shadow_atlas_.tiles(light);
+		if (!tiles) return -1;
+		unsigned int first = (unsigned int)shadow_tiles_.size();
+		for (size_t face = 0; face < tiles->size(); face++) {
+			shadow_tiles_.push_back({ matrices[face], shadow_atlas_.Rect((*tiles)[face]) });
+		}
+		shadowed_lights_.push_back({ light, center, radius, first, (unsigned int)tiles->size(), importance });
+		return (int)first;
+	};
+	for (size_t i = 0; i < points.size(); i++) {
+		const PointLightData& light = light_buffer_.point_lights[i];
+		glm::mat4 faces[6];
+		PointShadowMatrices(light.position, light.radius, faces);
+		light_buffer_.SetPointShadow(i, add_tiles(points[i], faces, light.position, light.radius, point_importance[i]));
+	}
+	for (size_t i = 0; i < spots.size(); i++) {
+		const SpotLightData& light = light_buffer_.spot_lights[i];
+		glm::mat4 matrix = SpotShadowMatrix(light.position, light.direction, light.outerCutOff, light.radius);
+		ClusterLight bounds = SpotBoundingSphere(light.position, light.direction, light.radius, light.outerCutOff);
+		light_buffer_.SetSpotShadow(i, add_tiles(spots[i], &matrix, bounds.position, bounds.radius, spot_importance[i]));
+	}
+	light_buffer_.UploadShadows();
+	ScheduleShadowFaces();
+
+	if (!shadow_tile_ssbo_) glGenBuffers(1, &shadow_tile_ssbo_);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, shadow_tile_ssbo_);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(shadow_tiles_.size(), 1) * sizeof(ShadowTileData),
+		shadow_tiles_.empty() ? nullptr : shadow_tiles_.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOW_TILE_BINDING, shadow_tile_ssbo_);
+	glBindTextureUnit(SHADOW_ATLAS_UNIT, shadow_atlas_.texture());
+	stats_.shadow_atlas = shadow_atlas_.stats();
+}
+
+// Picks the atlas faces to redraw and their casters. Each face gets only
+// the casters in its light's range and its own frustum, and is cached on
+// those (see ShadowCache): a face without casters is cleared once, a face
+// of a still light is redrawn only when one of its static casters changes.
+// Faces that need a redraw are taken most important light first while
+// shadow_face_budget lasts; the rest keep their old map and the matrix it
+// was drawn with, unless their tile moved or they were already deferred for
+// ShadowCache::MAX_DEFERRED_FRAMES frames.
+void Renderer::ScheduleShadowFaces() {
+	PROFILE_FUNCTION();
+	int budget = scene_->properties.shadow_face_budget;
+	int redrawn = 0;
+	face_draw_count_ = 0;
+
+	std::vector<size_t> order(shadowed_lights_.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return shadowed_lights_[a].importance > shadowed_lights_[b].importance;
+	});
+
+	float atlas_size = (float)shadow_atlas_.size();
+	for (size_t index : order) {
+		const ShadowedLight& light = shadowed_lights_[index];
+		light_casters_.clear();
+		for (Model* model : shadow_models_) {
+			if (BoundsTouchSphere(model, light.center, light.radius)) light_casters_.push_back(model);
+		}
+
+		for (unsigned int i = 0; i < light.tile_count; i++) {
+			ShadowTileData& tile = shadow_tiles_[light.first_tile + i];
+			glm::ivec4 texels = glm::ivec4(tile.rect * atlas_size + 0.5f);
+			ShadowCasterKey casters;
+			bool dynamic = false;
+			for (Model* model : light_casters_) {
+				if (!BoundsInFrustum(model, tile.view_projection)) continue;
+				if (model->is_static) casters.Add(model);
+				else dynamic = true;
+			}
+			ShadowUpdate update = shadow_cache_.Peek(light.owner, (int)i, tile.view_projection, texels,
+				shadow_atlas_.generation(), casters.value(), dynamic);
+			if (!update.live) {
+				shadow_cache_.Check(light.owner, (int)i, tile.view_projection, texels, shadow_atlas_.generation(),
+					casters.value(), dynamic);
+				continue;
+			}
+			if (budget > 0 && redrawn >= budget &&
+				shadow_cache_.Defer(light.owner, (int)i, texels, shadow_atlas_.generation(), tile.view_projection))
+				continue;
+			shadow_cache_.Check(light.owner, (int)i, tile.view_projection, texels, shadow_atlas_.generation(),
+				casters.value(), dynamic);
+			redrawn++;
+
+			if (face_draw_count_ == face_draws_.size()) face_draws_.emplace_back();
+			ShadowFaceDraw& draw = face_draws_[face_draw_count_++];
+			draw.tile = light.first_tile + i;
+			draw.static_layer = update.static_layer;
+			draw.static_casters.Clear();
+			draw.dynamic_casters.Clear();
+			for (Model* model : light_casters_) {
+				if (!BoundsInFrustum(model, tile.view_projection)) continue;
+				if (model->is_static) {
+					if (update.static_layer) draw.static_casters.Add(model);
+				}
+				else draw.dynamic_casters.Add(model);
+			}
+		}
+	}
+}
+
+void Renderer::ReadOverdrawQuery() {
+	// The queries of the previous frame, never wait for the GPU
+	const GLuint* previous = overdraw_queries_[(frame_index_ + 1) & 1];
+	if (frame_index_++ == 0) return;
+
+	GLuint64 samples = 0;
+	for (int i = 0; i < 2; i++) {
+		GLint available = 0;
+		glGetQueryObjectiv(previous[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return;
+		GLuint64 part = 0;
+		glGetQueryObjectui64v(previous[i], GL_QUERY_RESULT, &part);
+		samples += part;
+	}
+	stats_.shaded_samples = samples;
+	stats_.overdraw = samples / (float)(render_width_ * render_height_);
+}
+
+void Renderer::UpdateFrameStats() {
+	uint64_t now = profiler::Now();
+	FrameCounters counters = frame_stats::EndFrame();
+	if (frame_begin_ns_) {
+		float frame_ms = (now - frame_begin_ns_) / 1e6f;
+		float gpu_ms = 0.0f;
+		for (const GpuPassTiming& pass : stats_.gpu_passes) gpu_ms += pass.ms;
+		frame_times_.Add(frame_ms);
+
+		stats_.counters = counters;
+		stats_.frame_ms = frame_ms;
+		stats_.cpu_ms = cpu_ms_;
+		stats_.gpu_ms = gpu_ms;
+		stats_.p50 = frame_times_.Percentile(50.0f);
+		stats_.p95 = frame_times_.Percentile(95.0f);
+		stats_.p99 = frame_times_.Percentile(99.0f);
+		stats_.frame_times = &frame_times_;
+		stats_logger_.Write(glfwGetTime(), frame_ms, cpu_ms_, gpu_ms, counters);
+	}
+	frame_begin_ns_ = now;
+}
+
+void Renderer::UpdateRenderScale() {
+	const Properties& properties = scene_->properties;
+	dynamic_resolution_.target_ms = properties.gpu_target_ms;
+	dynamic_resolution_.min_scale = properties.min_resolution_scale;
+
+	// While off the controller follows the manual scale, so switching it on
+	// starts from what is on screen
+	float scale = glm::clamp(properties.resolution_scale, 0.25f, 1.0f);
+	if (properties.dynamic_resolution) scale = dynamic_resolution_.Update(stats_.gpu_ms);
+	else dynamic_resolution_.Reset(scale);
+
+	render_width_ = std::max(1, (int)(window_->GetScreenWidth() * scale + 0.5f));
+	render_height_ = std::max(1, (int)(window_->GetScreenHeight() * scale + 0.5f));
+	stats_.resolution_scale = scale;
+	stats_.render_width = render_width_;
+	stats_.render_height = render_height_;
+}
+
 void Renderer::RenderScene(bool render_imgui) {
+	UpdateFrameStats();
+
+	// Targets follow the window within the frame, the camera keeps its
+	// aspect in step
+	target_pool_.NewFrame();
+	frame_graph_.Reset();
+	if (Camera* camera = scene_->GetCamera()) {
+		camera->screenWidth = window_->GetScreenWidth();
+		camera->screenHeight = window_->GetScreenHeight();
+	}
+	stats_.target_bytes = target_pool_.bytes();
+	stats_.target_textures = (unsigned int)target_pool_.texture_count();
+	UpdateRenderScale();
 	// Gamma correction
 	glEnable(GL_FRAMEBUFFER_SRGB);
 
-	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-	glViewport(0, 0, window_->GetScreenWidth(), window_->GetScreenHeight());
-	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
-
 	glEnable(GL_DEPTH_TEST);
 	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
@@ -222,14 +445,71 @@ void Renderer::RenderScene(bool render_imgui) {
 
 	//if (scene_->getObjects().empty() || active_camera_index >= objects.size()) return;
 
-	unsigned int number_p_lights = 0;
 
-	// Update light !!! WILL BE REMOVED WHEN LIGHTS ARE DONE !!!
+	PROFILE_ZONE(scene_zone, "Scene update");
+	gpu_timer_.NewFrame();
+
+	// Upload per-object records of models that changed since last frame
+	object_buffer_.Update(scene_->getObjects());
+	MaterialLibrary::Get().Update();
+
+	// Software occlusion culling: occluder models are rasterized on the CPU
+	// and the camera queues skip models hidden behind them
+	Camera* camera = scene_->GetCamera();
+	bool occlusion_culling = scene_->properties.occlusion_culling && camera;
+	if (occlusion_culling) {
+		occlusion_culler_.Begin(CameraProjection(camera) * camera->GetViewMatrix());
+		for (const auto& obj : scene_->getObjects()) {
+			auto model = dynamic_cast<Model*>(obj);
+			if (model && model->occluder && model->getVisibility()) {
+				occlusion_culler_.AddOccluder(model->GetOccluderMesh(), model->GetModelMatrix());
+			}
+		}
+		occlusion_culler_.Finish();
+	}
+	stats_.occlusion_culled = 0;
+	stats_.occluder_triangles = occlusion_culling ? occlusion_culler_.triangle_count() : 0;
+
+	// Build the render queues, opaque ones are batched by material
+	opaque_queue_.Clear();
+	selected_queue_.Clear();
+	outline_queue_.Clear();
+	static_shadow_queue_.Clear();
+	dynamic_shadow_queue_.Clear();
+	shadow_models_.clear();
+	queried_models_.clear();
+	ShadowCasterKey static_casters;
+	shadow_cache_.enabled = scene_->properties.shadow_caching;
+	shadow_cache_.NewFrame();
 	for (const auto& obj : scene_->getObjects()) {
-		if (auto* light = dynamic_cast<Light*>(obj)) {
-			light->update(model_shader_, 0);
+		if (auto model = dynamic_cast<Model*>(obj)) {
+			if (model->getSelection()) outline_queue_.Add(model);
+			if (!model->getVisibility()) continue;
+			// Hidden models still cast shadows
+			if (model->is_static) {
+				static_shadow_queue_.Add(model);
+				static_casters.Add(model);
+			}
+			else dynamic_shadow_queue_.Add(model);
+			shadow_models_.push_back(model);
+			if (occlusion_culling &&
+				!occlusion_culler_.IsVisible(model->bounds_min, model->bounds_max, model->GetModelMatrix())) {
+				stats_.occlusion_culled++;
+				continue;
+			}
+			if (model->getSelection()) selected_queue_.Add(model);
+			else if (model->occlusion_query) queried_models_.push_back(model);
+			else opaque_queue_.Add(model);
 		}
 	}
+	opaque_queue_.SortByMaterial();
+	selected_queue_.SortByMaterial();
+
+	// GPU culling replaces the CPU submission of the opaque and shadow queues
+	bool gpu_culling = scene_->properties.gpu_culling && cull_shader_->valid();
+
+	// Pack lights into the light buffers, only changed lights are rewritten
+	light_buffer_.Update(scene_->getObjects());
 
 	// CAMERA
 	//=----------------------------------------------------=
@@ -249,10 +529,18 @@ void Renderer::RenderScene(bool render_imgui) {
 	activeCamera->update_shaders(single_color_);
 	activeCamera->update_shaders(DLdepth_shader_);
 	activeCamera->update_shaders(skybox_shader_);
+	activeCamera->update_shaders(gbuffer_shader_);
+	activeCamera->update_shaders(deferred_shader_);
+
+	// Cluster the lights for the main pass
+	UpdateLightClusters(activeCamera);
+
 
+	PROFILE_END(scene_zone);
 
 	// DIRECTIONAL LIGHT SHADOWS
 	// =--------------------------------------------------=
+	PROFILE_ZONE(csm_zone, "CSM setup");
 
 	DirectionalLight* sun = nullptr;
 
@@ -266,6 +554,28 @@ void Renderer::RenderScene(bool render_imgui) {
 
 	sun->setCamera(activeCamera);
 	if (!activeCamera || !sun) return;
+	sun->setupDepthBuffers(scene_->properties.DLShadowResolution);
+
+	// Sample distribution: the cascades cover the depth range the camera saw
+	// a frame or two ago, reduced after the main pass
+	bool sdsm = scene_->properties.sdsm && depth_bounds_shader_->valid();
+	if (sdsm) depth_bounds_.Update();
+	else depth_bounds_.Reset();
+	if (sdsm && depth_bounds_.valid()) sun->setDepthRange(depth_bounds_.near_distance(), depth_bounds_.far_distance());
+	else sun->resetDepthRange();
+	stats_.cascade_near = sun->depthRangeNear;
+	stats_.cascade_far = sun->depthRangeFar;
+
+	// The cascades' depth range is fitted to the casters
+	glm::vec3 casters_min(std::numeric_limits<float>::max());
+	glm::vec3 casters_max(std::numeric_limits<float>::lowest());
+	for (Model* model : shadow_models_) {
+		glm::vec3 box_center, box_half;
+		WorldBounds(model, box_center, box_half);
+		casters_min = glm::min(casters_min, box_center - box_half);
+		casters_max = glm::max(casters_max, box_center + box_half);
+	}
+	sun->setCasterBounds(casters_min, casters_max);
 
 	glActiveTexture(GL_TEXTURE3);
 	glBindTexture(GL_TEXTURE_2D_ARRAY, sun->depthMap);
@@ -281,9 +591,32 @@ void Renderer::RenderScene(bool render_imgui) {
 	glBindBufferBase(GL_UNIFORM_BUFFER, 1, matricesUBO);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
+	// Far cascades are redrawn every few frames, the rest reuse the matrix
+	// their map was drawn with. Cost of a cascade is the triangles of the
+	// casters in its box.
+	const auto fitted = sun->getLightSpaceMatrices();
+	std::vector<std::vector<glm::vec4>> slices(fitted.size());
+	std::vector<unsigned long long> costs(fitted.size(), 0);
+	for (size_t i = 0; i < fitted.size(); ++i) {
+		float near_plane, far_plane;
+		sun->getCascadeRange(i, near_plane, far_plane);
+		slices[i] = sun->getSliceCorners(near_plane, far_plane);
+	}
+	for (Model* model : shadow_models_) {
+		glm::vec3 box_center, box_half;
+		WorldBounds(model, box_center, box_half);
+		size_t triangles = model->TriangleCount();
+		for (size_t i = 0; i < fitted.size(); ++i) {
+			if (BoundsInClip(fitted[i], box_center, box_half)) costs[i] += triangles;
+		}
+	}
+	cascade_scheduler_.Schedule(fitted, slices, costs, scene_->properties.cascade_update_interval,
+		(unsigned long long)scene_->properties.shadow_triangle_budget, sun->GetRevision(), sun->SHADOW_WIDTH);
+	stats_.cascades = cascade_scheduler_.stats();
+
 	DLdepth_shader_->use();
 	// UBO setup
-	const auto lightMatrices = sun->getLightSpaceMatrices();
+	const std::vector<glm::mat4>& lightMatrices = cascade_scheduler_.matrices();
 	glBindBuffer(GL_UNIFORM_BUFFER, matricesUBO);
 	for (size_t i = 0; i < lightMatrices.size(); ++i)
 	{
@@ -291,176 +624,357 @@ void Renderer::RenderScene(bool render_imgui) {
 	}
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, sun->depthMapFBO);
-	glViewport(0, 0, sun->SHADOW_WIDTH, sun->SHADOW_HEIGHT);
-	glClear(GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	//glCullFace(GL_FRONT);  // peter panning
-
-	for (const auto& obj : scene_->getObjects()) {
-		if (auto model = dynamic_cast<Model*>(obj)) {
-			model->Draw(DLdepth_shader_);
-		}
-	}
-	glCullFace(GL_BACK);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	model_shader_->use();
-	sun->update(model_shader_, 0);
 	// Setting up directional light cascades
-	model_shader_->setFloat("DLfarPlane", activeCamera->getFar());
-	model_shader_->setInt("cascadeCount", sun->shadowCascadeLevels.size());
-	for (size_t i = 0; i < sun->shadowCascadeLevels.size(); ++i)
-	{
-		model_shader_->setFloat("cascadePlaneDistances[" + std::to_string(i) + "]", sun->shadowCascadeLevels[i]);
-	}
+	light_buffer_.SetCascades(activeCamera->getFar(), sun->shadowCascadeLevels);
+	PROFILE_END(csm_zone);
 
-	//// POINT LIGHTS SHADOWS
-	////=-----------------------------------------------------=
-	//unsigned int PLmatricesUBO;
-	//glGenBuffers(1, &PLmatricesUBO);
-	//glBindBuffer(GL_UNIFORM_BUFFER, PLmatricesUBO);
-	//glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4x4) * 6, nullptr, GL_STATIC_DRAW);
-	//glBindBufferBase(GL_UNIFORM_BUFFER, 2, PLmatricesUBO);
-	//glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-	//glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO); // Use the global FBO
-	//// Render the scene to the cube map array layer
-	//glViewport(0, 0, scene_->properties.PLShadowResolution, scene_->properties.PLShadowResolution); // Use global shadow map dimensions
-	////glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeMapArray, 0);
-	//glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	//glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeMapArray, 0);
-
-	//glEnable(GL_DEPTH_TEST);
-	//glEnable(GL_CULL_FACE);
-
-	////glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cubeMapArray, number_p_lights*6);
-
-	//for (auto obj : scene_->getObjects()) {
-	//	if (auto pointLight = dynamic_cast<PointLight*>(obj)) {
-	//		pointLight->update(model_shader_, number_p_lights);
-
-	//		model_shader_->use();
-	//		model_shader_->setFloat("pointLights[" + std::to_string(number_p_lights) + "].PLfarPlane", pointLight->far_plane);
-	//		PLdepth_shader_->use();
-	//		PLdepth_shader_->setFloat("far_plane", pointLight->far_plane);
-	//		PLdepth_shader_->setVec3("lightPos", pointLight->getPosition());
-	//		PLdepth_shader_->setInt("lightIndex", number_p_lights);
-
-	//		// UBO setup
-	//		// Set up the light space matrices
-
-	//		std::vector<glm::mat4> lsMatrices = pointLight->getLightSpaceMatrix(scene_->properties.PLShadowResolution);
-	//		glBindBuffer(GL_UNIFORM_BUFFER, PLmatricesUBO);
-	//		for (size_t i = 0; i < lsMatrices.size(); ++i)
-	//		{
-	//			glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(glm::mat4x4), sizeof(glm::mat4x4), &lsMatrices[i]);
-	//		}
-	//		glBindBuffer(GL_UNIFORM_BUFFER, 0);
-	//		//// Render to each face of the cube map
-	//		//for (unsigned int face = 0; face < 6; ++face) {
-	//		//    // Bind the cube map array layer for this face
-
-	//		//    glFramebufferTextureLayer(
-	//		//        GL_FRAMEBUFFER,              // Target
-	//		//        GL_DEPTH_ATTACHMENT,         // Attachment
-	//		//        cubeMapArray,                // Texture
-	//		//        0,                           // Mipmap level
-	//		//        (number_p_lights * 6) + face // Layer (6 faces per cube map)
-	//		//    );
-
-	//		//    // Check if the framebuffer is complete
-	//		//    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-	//		//        std::cerr << "Framebuffer is not complete!" << std::endl;
-	//		//    }
-
-	//		//    // Set the light space matrix for this face
-	//		//    PLdepth_shader->setMat4("lightSpaceMatrix", lsMatrices[face]);
-
-	//		glClear(GL_DEPTH_BUFFER_BIT);
-
-	//		for (const auto& obj : scene_->getObjects()) {
-	//			if (auto model = dynamic_cast<Model*>(obj)) {
-	//				model->DrawDepth(PLdepth_shader_);
-	//			}
-	//		}
-	//		//}
-
-	//		// Increment the point light counter
-	//		number_p_lights++;
-	//	}
-	//}
-	//// Unbind the framebuffer
-	//glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	//// Set the uniform for the cube map array
-	//model_shader_->use();
-	//model_shader_->setInt("PLshadowMapArray", 4); // Use the same texture unit
+	// Point and spot light tiles in the shadow atlas
+	UpdateShadowAtlas(activeCamera);
 
-	// MAIN RENDER
+	// FRAME GRAPH
 	//=------------------------------------------------------=
-
-	model_shader_->setInt("numPointLights", number_p_lights);
-	model_shader_->setInt("numSpotLights", 1);
-
-	// Restore viewport for main rendering
-	glViewport(0, 0, window_->GetScreenWidth(), window_->GetScreenHeight());
-	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-
-	// Render not selected objects without writing to stencil buffer
-	for (const auto& obj : scene_->getObjects()) {
-		if (auto model = dynamic_cast<Model*>(obj)) {
-			if (!model->getSelection()) {
-				glStencilMask(0x00);
-				model->Draw(model_shader_);
+	// Color and depth are transient and window sized, dynamic resolution
+	// only shrinks the viewport. Passes run in the order they are added.
+	int width = window_->GetScreenWidth();
+	int height = window_->GetScreenHeight();
+	bool deferred = scene_->properties.deferred_shading;
+	bool prepass = scene_->properties.depth_prepass;
+	glm::mat4 view_projection = CameraProjection(activeCamera) * activeCamera->GetViewMatrix();
+	bool hiz_culling = gpu_culling && scene_->properties.hiz_culling && hiz_shader_->valid();
+
+	FrameGraphResource backbuffer = frame_graph_.Import("Backbuffer", 0);
+	FrameGraphResource sun_shadow = frame_graph_.Import("Sun shadow map", sun->depthMap);
+	FrameGraphResource light_shadows = shadowed_lights_.empty() ? -1 : frame_graph_.Import("Shadow atlas", shadow_atlas_.texture());
+	FrameGraphResource color = frame_graph_.Create("Color", { GL_RGB8, width, height, GL_LINEAR });
+	// Depth-stencil, shared with the G-buffer and sampled by the deferred
+	// lighting pass and the Hi-Z build
+	FrameGraphResource depth = frame_graph_.Create("Depth", { GL_DEPTH24_STENCIL8, width, height, GL_NEAREST });
+	gbuffer_ = GBuffer();
+	if (deferred) gbuffer_.Declare(frame_graph_, width, height);
+
+	// The main GPU timing spans the passes from the prepass to the outline.
+	// The prepass and the color pass draw the same culled commands, culled
+	// when the first of them starts; the Hi-Z test uses last frame's pyramid.
+	bool main_started = false, main_timing = false;
+	auto begin_main = [&]() {
+		if (main_started) return;
+		main_started = main_timing = true;
+		gpu_timer_.Begin(GPU_PASS_MAIN);
+		if (gpu_culling) {
+			opaque_batch_.Build(opaque_queue_, true);
+			opaque_batch_.Cull(*cull_shader_, { view_projection }, hiz_culling ? &hiz_ : nullptr);
+		}
+	};
+	auto end_main = [&]() {
+		if (main_timing) gpu_timer_.End(GPU_PASS_MAIN);
+		main_timing = false;
+	};
+	auto bind_target = [&](GLuint fbo) {
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glViewport(0, 0, render_width_, render_height_);
+	};
+
+	// Draws a queue into the marked cascades of the bound layered target.
+	// GPU culling draws one cascade at a time; otherwise the vertex shader
+	// picks the layer of each instance (only the cascades a mesh touches),
+	// or the geometry shader copies every triangle into all cascades.
+	bool layered = scene_->properties.layered_shadows && layered_depth_shader_;
+	Shader* cascade_shader = layered ? layered_cascade_shader_ : DLdepth_cascade_shader_;
+	auto draw_cascades = [&](const RenderQueue& queue, IndirectBatch& batch, LayeredShadowBatch& layered_batch,
+		const std::vector<bool>& layers) {
+		if (queue.empty()) return;
+		bool all = std::find(layers.begin(), layers.end(), false) == layers.end();
+		if (gpu_culling) {
+			batch.Build(queue, false);
+			batch.Cull(*cull_shader_, lightMatrices);
+		}
+		else if (layered) {
+			layered_batch.Build(queue, lightMatrices, layers);
+			layered_batch.Draw(layered_depth_shader_);
+			return;
+		}
+		else if (all) {
+			queue.Submit(DLdepth_shader_, false);
+			return;
+		}
+		cascade_shader->use();
+		for (size_t i = 0; i < layers.size(); ++i) {
+			if (!layers[i]) continue;
+			cascade_shader->setInt("cascadeIndex", (int)i);
+			if (gpu_culling) batch.Draw(cascade_shader, (unsigned int)i, false);
+			else queue.Submit(cascade_shader, false);
+		}
+	};
+
+	// Static casters go into the static layer of a cascade only when the
+	// cache says it is stale; the sampled layer is a copy of it with the
+	// dynamic casters drawn on top
+	frame_graph_.AddPass("Shadows", {}, { sun_shadow }, [&]() {
+		PROFILE_SCOPE("CSM pass");
+		int width = sun->SHADOW_WIDTH, height = sun->SHADOW_HEIGHT;
+		std::vector<bool> static_layers(lightMatrices.size()), live_layers(lightMatrices.size());
+		bool any_static = false, any_live = false;
+		for (size_t i = 0; i < lightMatrices.size(); ++i) {
+			if (!cascade_scheduler_.updated(i)) {
+				shadow_cache_.Touch(sun, (int)i);
+				continue;
 			}
+			ShadowUpdate update = shadow_cache_.Check(sun, (int)i, lightMatrices[i], glm::ivec4(0, 0, width, height),
+				sun->SHADOW_WIDTH, static_casters.value(), !dynamic_shadow_queue_.empty());
+			static_layers[i] = update.static_layer;
+			live_layers[i] = update.live;
+			any_static |= update.static_layer;
+			any_live |= update.live;
 		}
+		if (!any_live) return;
+
+		gpu_timer_.Begin(GPU_PASS_SHADOW);
+		glViewport(0, 0, width, height);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+		//glCullFace(GL_FRONT);  // peter panning
+		if (any_static) {
+			const float far_depth = 1.0f;
+			for (size_t i = 0; i < static_layers.size(); ++i) {
+				if (static_layers[i])
+					glClearTexSubImage(sun->staticDepthMap, 0, 0, 0, (GLint)i, width, height, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &far_depth);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, sun->staticDepthMapFBO);
+			draw_cascades(static_shadow_queue_, static_shadow_batch_, static_layered_batch_, static_layers);
+		}
+		for (size_t i = 0; i < live_layers.size(); ++i) {
+			if (live_layers[i])
+				glCopyImageSubData(sun->staticDepthMap, GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i,
+					sun->depthMap, GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, width, height, 1);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, sun->depthMapFBO);
+		draw_cascades(dynamic_shadow_queue_, dynamic_shadow_batch_, dynamic_layered_batch_, live_layers);
+		glCullFace(GL_BACK);
+		gpu_timer_.End(GPU_PASS_SHADOW);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	});
+
+	// Point and spot lights, the faces picked by ScheduleShadowFaces into
+	// their atlas tiles
+	if (light_shadows >= 0 && face_draw_count_) {
+		frame_graph_.AddPass("Light shadows", {}, { light_shadows }, [&]() {
+			PROFILE_SCOPE("Shadow atlas pass");
+			gpu_timer_.Begin(GPU_PASS_LIGHT_SHADOW);
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_CULL_FACE);
+			glEnable(GL_SCISSOR_TEST);
+			shadow_atlas_shader_->use();
+			float atlas_size = (float)shadow_atlas_.size();
+			for (size_t i = 0; i < face_draw_count_; i++) {
+				const ShadowFaceDraw& draw = face_draws_[i];
+				const ShadowTileData& tile = shadow_tiles_[draw.tile];
+				glm::ivec4 texels = glm::ivec4(tile.rect * atlas_size + 0.5f);
+				glViewport(texels.x, texels.y, texels.z, texels.w);
+				glScissor(texels.x, texels.y, texels.z, texels.w);
+				shadow_atlas_shader_->setMat4("lightSpaceMatrix", tile.view_projection);
+				if (draw.static_layer) {
+					glBindFramebuffer(GL_FRAMEBUFFER, shadow_atlas_.static_framebuffer());
+					glClear(GL_DEPTH_BUFFER_BIT);
+					draw.static_casters.Submit(shadow_atlas_shader_, false);
+				}
+				glCopyImageSubData(shadow_atlas_.static_texture(), GL_TEXTURE_2D, 0, texels.x, texels.y, 0,
+					shadow_atlas_.texture(), GL_TEXTURE_2D, 0, texels.x, texels.y, 0, texels.z, texels.w, 1);
+				if (!draw.dynamic_casters.empty()) {
+					glBindFramebuffer(GL_FRAMEBUFFER, shadow_atlas_.framebuffer());
+					draw.dynamic_casters.Submit(shadow_atlas_shader_, false);
+				}
+			}
+			glDisable(GL_SCISSOR_TEST);
+			gpu_timer_.End(GPU_PASS_LIGHT_SHADOW);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		});
 	}
 
-	// Render selected
-	for (const auto& obj : scene_->getObjects()) {
-		if (auto model = dynamic_cast<Model*>(obj)) {
-			if (model->getSelection()) {
-				glStencilFunc(GL_ALWAYS, 1, 0xFF);
-				glStencilMask(0xFF);
-				model->Draw(model_shader_);
-			}
+	// MAIN RENDER
+	//=------------------------------------------------------=
+	auto submit_opaque = [&](Shader* shader, bool bind_materials) {
+		if (gpu_culling) opaque_batch_.Draw(shader, 0, bind_materials);
+		else opaque_queue_.Submit(shader, bind_materials);
+	};
+
+	// Hardware occlusion queries: bounding boxes are tested against the
+	// depth of the opaque queue, then the models are drawn conditionally
+	occlusion_queries_.NewFrame();
+	glm::vec3 camera_position = glm::vec3(glm::inverse(activeCamera->GetViewMatrix())[3]);
+	auto test_queried = [&]() {
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_FALSE);
+		glDisable(GL_CULL_FACE);
+		query_conditions_.clear();
+		for (Model* model : queried_models_) {
+			query_conditions_.push_back(occlusion_queries_.Test(occlusion_box_shader_, model, camera_position));
 		}
+		glEnable(GL_CULL_FACE);
+		glDepthMask(GL_TRUE);
+	};
+	auto submit_queried = [&](Shader* shader, bool depth_only) {
+		for (size_t i = 0; i < queried_models_.size(); i++) {
+			OcclusionQueries::BeginConditional(query_conditions_[i]);
+			if (depth_only) queried_models_[i]->DrawDepth(shader);
+			else queried_models_[i]->Draw(shader);
+			OcclusionQueries::EndConditional(query_conditions_[i]);
+		}
+	};
+
+	// Depth prepass, position only, so the color pass shades each visible
+	// pixel once
+	if (prepass) {
+		frame_graph_.AddPass("Depth prepass", {}, { depth }, [&]() {
+			begin_main();
+			bind_target(frame_graph_.Framebuffer({}, depth));
+			glEnable(GL_CULL_FACE);
+			glEnable(GL_DEPTH_TEST);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+			glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glStencilMask(0x00);
+			submit_opaque(depth_prepass_shader_, false);
+			test_queried();
+			submit_queried(depth_prepass_shader_, true);
+			selected_queue_.Submit(depth_prepass_shader_, false);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		});
 	}
 
-	// Render selected object with solid color shader
-	for (const auto& obj : scene_->getObjects()) {
-		if (auto model = dynamic_cast<Model*>(obj)) {
-			if (model->getSelection()) {
-				glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-				glStencilMask(0x00);
-				glDisable(GL_DEPTH_TEST);
-				model->DrawStencil(single_color_);
-			}
+	// Color pass: forward shading, or the G-buffer fill in deferred mode.
+	// In deferred mode stale G-buffer texels are masked by depth.
+	FrameGraphResource color_output = deferred ? -1 : color;
+	frame_graph_.AddPass(deferred ? "G-buffer" : "Color", { sun_shadow, light_shadows, prepass ? depth : -1 },
+		{ color_output, depth, gbuffer_.targets[0], gbuffer_.targets[1], gbuffer_.targets[2] }, [&]() {
+		begin_main();
+		if (deferred) bind_target(gbuffer_.Framebuffer(frame_graph_, depth));
+		else bind_target(frame_graph_.Framebuffer({ color }, depth));
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+		glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+		if (prepass) {
+			if (!deferred) glClear(GL_COLOR_BUFFER_BIT);
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
+		else glClear((deferred ? 0 : GL_COLOR_BUFFER_BIT) | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		Shader* color_shader = deferred ? gbuffer_shader_ : model_shader_;
+
+		// Count fragments that pass the depth test to measure overdraw
+		if (!overdraw_queries_[0][0]) glGenQueries(4, &overdraw_queries_[0][0]);
+		const GLuint* overdraw = overdraw_queries_[frame_index_ & 1];
+		glBeginQuery(GL_SAMPLES_PASSED, overdraw[0]);
+
+		// Render not selected objects without writing to stencil buffer
+		glStencilMask(0x00);
+		submit_opaque(color_shader, true);
+		// The box tests are occlusion queries themselves, so the count is
+		// split around them
+		glEndQuery(GL_SAMPLES_PASSED);
+		if (!prepass) {
+			test_queried();
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 		}
+		glBeginQuery(GL_SAMPLES_PASSED, overdraw[1]);
+		submit_queried(color_shader, false);
+		stats_.occlusion_queries = occlusion_queries_.issued();
+		stats_.query_hidden = occlusion_queries_.hidden();
+
+		// Render selected
+		glStencilFunc(GL_ALWAYS, 1, 0xFF);
+		glStencilMask(0xFF);
+		selected_queue_.Submit(color_shader);
+
+		glEndQuery(GL_SAMPLES_PASSED);
+		ReadOverdrawQuery();
+
+		if (prepass) {
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+		}
+	});
+
+	// Depth pyramid for next frame's Hi-Z test, before the outline and
+	// skybox touch the depth buffer. Kept for the next frame, so never culled.
+	if (hiz_culling) {
+		frame_graph_.AddPass("Hi-Z", { depth }, {}, [&]() {
+			hiz_.Build(*hiz_shader_, frame_graph_.texture(depth), render_width_, render_height_, view_projection);
+		}, true);
 	}
 
-	// Render skybox last
-	glStencilMask(0x00);
-	if (scene_->GetSkybox()) scene_->GetSkybox()->Draw(skybox_shader_, activeCamera);
+	// Visible depth range for the cascade fit of a later frame, also kept
+	if (sdsm) {
+		frame_graph_.AddPass("Depth bounds", { depth }, {}, [&]() {
+			depth_bounds_.Reduce(*depth_bounds_shader_, frame_graph_.texture(depth), render_width_, render_height_,
+				CameraProjection(activeCamera));
+		}, true);
+	}
 
-	glStencilMask(0xFF);
-	glStencilFunc(GL_ALWAYS, 1, 0xFF);
-	glEnable(GL_DEPTH_TEST);
+	if (deferred) {
+		// Lighting pass, once per covered pixel
+		frame_graph_.AddPass("Lighting", { gbuffer_.targets[0], gbuffer_.targets[1], gbuffer_.targets[2], depth,
+			sun_shadow, light_shadows }, { color }, [&]() {
+			begin_main();
+			bind_target(frame_graph_.Framebuffer({ color }, depth));
+			glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+			glStencilMask(0x00);
+			glDisable(GL_DEPTH_TEST);
+			deferred_shader_->use();
+			deferred_shader_->setMat4("inverseViewProjection", glm::inverse(view_projection));
+			gbuffer_.BindTextures(frame_graph_, depth);
+			glBindVertexArray(fullquadVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+			glBindVertexArray(0);
+			glEnable(GL_DEPTH_TEST);
+		});
+	}
+
+	// Render selected object with solid color shader
+	if (!outline_queue_.empty()) {
+		frame_graph_.AddPass("Outline", { depth }, { color }, [&]() {
+			begin_main();
+			bind_target(frame_graph_.Framebuffer({ color }, depth));
+			glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+			glStencilMask(0x00);
+			glDisable(GL_DEPTH_TEST);
+			outline_queue_.Submit(single_color_, false);
+		});
+	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0); // back to default
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
-	quadShader->use();
-	glBindVertexArray(fullquadVAO);
-	glDisable(GL_DEPTH_TEST);
-	glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
+	// Render skybox last
+	frame_graph_.AddPass("Skybox", { depth }, { color }, [&]() {
+		end_main();
+		gpu_timer_.Begin(GPU_PASS_SKYBOX);
+		bind_target(frame_graph_.Framebuffer({ color }, depth));
+		glStencilMask(0x00);
+		if (scene_->GetSkybox()) scene_->GetSkybox()->Draw(skybox_shader_, activeCamera);
+		gpu_timer_.End(GPU_PASS_SKYBOX);
+
+		glStencilMask(0xFF);
+		glStencilFunc(GL_ALWAYS, 1, 0xFF);
+		glEnable(GL_DEPTH_TEST);
+	});
+
+	// Upscale to the window
+	frame_graph_.AddPass("Upscale", { color }, { backbuffer }, [&]() {
+		end_main();
+		gpu_timer_.Begin(GPU_PASS_QUAD);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0); // back to default
+		glViewport(0, 0, width, height);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		quadShader->use();
+		glUniform2f(glGetUniformLocation(quadShader->ID, "renderSize"), (float)render_width_, (float)render_height_);
+		quadShader->setInt("upscaleFilter", render_width_ < width ? scene_->properties.upscale_filter : UPSCALE_BILINEAR);
+		quadShader->setFloat("sharpness", scene_->properties.sharpness);
+		glBindVertexArray(fullquadVAO);
+		glDisable(GL_DEPTH_TEST);
+		glBindTexture(GL_TEXTURE_2D, frame_graph_.texture(color));
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		gpu_timer_.End(GPU_PASS_QUAD);
+	}, true);
 
   // DeltaTime calculation
   float currentFrame = glfwGetTime();
@@ -480,21 +994,47 @@ void Renderer::RenderScene(bool render_imgui) {
 
 	// render ImGui
   if (render_imgui) {
-    // Gamma correction
-		glDisable(GL_FRAMEBUFFER_SRGB);
-    // Start the Dear ImGui frame
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
-    //ImGui::ShowDemoWindow(); // Show demo window! :)
-    ShowMyWindow(scene_, fps);
-    // Render ImGUI ontop
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    frame_graph_.AddPass("ImGui", {}, { backbuffer }, [&]() {
+      PROFILE_SCOPE("ImGui");
+      // Gamma correction
+      glDisable(GL_FRAMEBUFFER_SRGB);
+      // Start the Dear ImGui frame
+      ImGui_ImplOpenGL3_NewFrame();
+      ImGui_ImplGlfw_NewFrame();
+      ImGui::NewFrame();
+      //ImGui::ShowDemoWindow(); // Show demo window! :)
+      ShowMyWindow(scene_, fps, stats_);
+      // Render ImGUI ontop
+      ImGui::Render();
+      gpu_timer_.Begin(GPU_PASS_IMGUI);
+      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      gpu_timer_.End(GPU_PASS_IMGUI);
+    }, true);
   }
 
+	PROFILE_ZONE(main_zone, "Frame graph");
+	frame_graph_.Compile();
+	frame_graph_.Execute();
+	PROFILE_END(main_zone);
+
+	// GPU results of a few frames ago
+	for (int pass = 0; pass < GPU_PASS_COUNT; pass++) stats_.gpu_passes[pass] = gpu_timer_.result(pass);
+	stats_.pipeline_statistics = gpu_timer_.statistics_supported();
+	stats_.frame_graph = frame_graph_.stats();
+	stats_.shadow_cache = shadow_cache_.stats();
+
+	// Renderer > Dump frame graph
+	if (dumpFrameGraph) {
+		dumpFrameGraph = false;
+		if (frame_graph_.DumpToFile("frame_graph.dot")) std::cout << "Frame graph written to frame_graph.dot" << std::endl;
+	}
+
   // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
   // -------------------------------------------------------------------------------
-  glfwSwapBuffers(window_->GetWindowPTR());
+  cpu_ms_ = (profiler::Now() - frame_begin_ns_) / 1e6f;
+  {
+    PROFILE_SCOPE("Swap");
+    glfwSwapBuffers(window_->GetWindowPTR());
+  }
   glfwPollEvents();
-}
\ No newline at end of file
+}
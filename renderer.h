@@ -20,8 +20,27 @@
 
 #include "window.h"
 #include "mine_imgui.h"
+#include "object_buffer.h"
+#include "light_buffer.h"
+#include "light_clusters.h"
+#include "render_queue.h"
+#include "render_target_pool.h"
+#include "frame_graph.h"
+#include "gbuffer.h"
+#include "occlusion_culler.h"
+#include "gpu_culler.h"
+#include "occlusion_queries.h"
+#include "profiler.h"
+#include "frame_stats.h"
+#include "dynamic_resolution.h"
+#include "shadow_atlas.h"
+#include "shadow_cache.h"
+#include "cascade_scheduler.h"
+#include "depth_bounds.h"
+#include "layered_shadows.h"
 
 // standart libraries
+#include <algorithm>
 #include <iostream>
 #include <string.h>
 #include <vector>
@@ -37,10 +56,19 @@ public:
 	Shader* single_color_;
 	Shader* skybox_shader_;
 	Shader* DLdepth_shader_;
-	Shader* PLdepth_shader_;
+	Shader* gbuffer_shader_;
+	Shader* deferred_shader_;
+	Shader* depth_prepass_shader_;
+	Shader* occlusion_box_shader_;
+	Shader* DLdepth_cascade_shader_;  // one cascade per draw, for the GPU-culled shadow pass
+	Shader* shadow_atlas_shader_;     // one atlas tile per draw
+	Shader* layered_depth_shader_ = nullptr;    // gl_Layer from the vertex shader, null when unsupported
+	Shader* layered_cascade_shader_ = nullptr;  // same, one cascade per draw
+	ComputeShader* cull_shader_;
+	ComputeShader* hiz_shader_;
+	ComputeShader* depth_bounds_shader_;
 	Shader* quadShader;
 	unsigned int fullquadVAO, fullquadVBO;
-	unsigned int texColorBuffer;
 
 	float deltaTime = 0.0f; // Time between current frame and last frame
 	float lastFrame = 0.0f; // Time of last frame  
@@ -51,15 +79,111 @@ public:
 	int fps = 0;
 	Window* window_;
 
-	GLuint depthMapFBO;
-	GLuint cubeMapArray;
-	GLuint frame_buffer;
 	GLuint uboMatrices;
 
+	ObjectBuffer object_buffer_;
+	LightBuffer light_buffer_;
+	LightClusters light_clusters_;
+	GLuint cluster_ssbo_ = 0;
+	GLuint cluster_index_ssbo_ = 0;
+
+	// Screen-sized targets are transient resources of the frame graph,
+	// backed by the pool and reallocated only when the window size changes
+	RenderTargetPool target_pool_;
+	FrameGraph frame_graph_{ target_pool_ };
+	GBuffer gbuffer_;
+	OcclusionCuller occlusion_culler_;
+
+	// Point and spot light shadows: tiles of the atlas placed each frame by
+	// screen importance, their records and the lights that got them
+	ShadowAtlas shadow_atlas_;
+	std::vector<ShadowTileData> shadow_tiles_;
+	std::vector<ShadowedLight> shadowed_lights_;
+	GLuint shadow_tile_ssbo_ = 0;
+	std::vector<Model*> shadow_models_;  // the models of the shadow queues
+	// Atlas faces to redraw this frame with the casters in their frustum,
+	// the first face_draw_count_ are used (the queues keep their storage)
+	struct ShadowFaceDraw {
+		unsigned int tile;
+		bool static_layer;
+		RenderQueue static_casters;
+		RenderQueue dynamic_casters;
+	};
+	std::vector<ShadowFaceDraw> face_draws_;
+	size_t face_draw_count_ = 0;
+	std::vector<Model*> light_casters_;  // casters in range of one light
+
+	// Static casters of every cascade and tile are kept in a static layer
+	// and redrawn only when they change
+	ShadowCache shadow_cache_;
+	CascadeScheduler cascade_scheduler_;
+
+	// GPU culling: the opaque and shadow queues as indirect batches and the
+	// depth pyramid of the last frame for the Hi-Z test
+	IndirectBatch opaque_batch_;
+	IndirectBatch static_shadow_batch_;
+	IndirectBatch dynamic_shadow_batch_;
+	// Without GPU culling: the shadow queues culled per cascade on the CPU
+	LayeredShadowBatch static_layered_batch_;
+	LayeredShadowBatch dynamic_layered_batch_;
+	HiZPyramid hiz_;
+	DepthBounds depth_bounds_;  // visible depth range the sun cascades are fitted to (Properties::sdsm)
+
+	// Models drawn behind a hardware occlusion query, not in the opaque queue
+	OcclusionQueries occlusion_queries_;
+	std::vector<Model*> queried_models_;
+	std::vector<GLuint> query_conditions_;  // per queried model, 0 - unconditional
+
+	// Timestamps and pipeline statistics of every pass
+	GpuTimer gpu_timer_;
+
+	// Per-frame counters and frame times, see UpdateFrameStats
+	FrameTimeHistory frame_times_;
+	FrameStatsLogger stats_logger_;
+	uint64_t frame_begin_ns_ = 0;
+	float cpu_ms_ = 0.0f;  // RenderScene up to the swap
+
+	// Dynamic resolution: the scene renders into the lower left
+	// render_width_ x render_height_ of the frame buffer targets, the quad
+	// pass stretches it over the window
+	DynamicResolution dynamic_resolution_;
+	int render_width_ = 0, render_height_ = 0;
+
+	// Color pass GL_SAMPLES_PASSED queries, double buffered. Each frame has
+	// two, before and after the occlusion box tests, which cannot run
+	// inside another samples query.
+	GLuint overdraw_queries_[2][2] = {};
+	unsigned int frame_index_ = 0;
+	RenderStats stats_;
+	RenderQueue opaque_queue_;    // visible, not selected, sorted by material
+	RenderQueue selected_queue_;  // visible and selected, writes the stencil
+	RenderQueue outline_queue_;   // selected, drawn with single_color_
+	RenderQueue static_shadow_queue_;   // visible models with is_static, depth only
+	RenderQueue dynamic_shadow_queue_;  // every other visible model
+
 	Renderer(Window* window, Scene* scene);
 
   void RenderScene(bool render_imgui);
 
+	// Bins point and spot lights into view clusters and uploads the lists
+	void UpdateLightClusters(Camera* camera);
+
+	// Places the point and spot light shadow tiles for this frame, writes
+	// the lights' shadowIndex and uploads the tile records
+	void UpdateShadowAtlas(Camera* camera);
+	void ScheduleShadowFaces();
+
+	// Reads last frame's overdraw query into stats_ when it is ready
+	void ReadOverdrawQuery();
+
+	// Closes the counters and times of the previous frame, logs them when
+	// stats_logger_ is open
+	void UpdateFrameStats();
+
+	// Picks this frame's render size, from the controller or the manual
+	// scale in the scene properties
+	void UpdateRenderScale();
+
 	inline void Terminate() {
 
 		//clear ImGUI
@@ -11,8 +11,27 @@
 #include "skybox.h"
 
 struct Properties {
-	unsigned int DLShadowResolution = 4096;
-	unsigned int PLShadowResolution = 2048;
+	unsigned int DLShadowResolution = 2048; // per cascade, cascades are texel-snapped bounding spheres
+	unsigned int shadow_atlas_size = 4096; // largest edge of the point and spot light shadow atlas
+	unsigned int shadow_tile_size = 1024;  // atlas tile of a light filling the screen, per cube face
+	unsigned int min_shadow_tile = 128;
+	bool shadow_caching = true;     // redraw static casters only when they change, see ShadowCache
+	int cascade_update_interval[CASCADE_COUNT + 1] = { 1, 1, 2, 4, 8 }; // frames between redraws of each sun cascade
+	bool layered_shadows = true;    // cascades layered in the vertex shader where supported, see LayeredShadowBatch
+	bool sdsm = false;              // fit the sun cascades to the visible depth range, see DepthBounds
+	int shadow_face_budget = 0;     // atlas faces redrawn per frame, most important lights first, 0 - no limit
+	int shadow_triangle_budget = 0; // sun cascade triangles per frame, 0 - no limit, see CascadeScheduler
+	bool deferred_shading = false;  // G-buffer + one lighting pass instead of forward shading
+	bool depth_prepass = false;     // depth-only pass, then color with GL_EQUAL
+	bool occlusion_culling = false; // test models against CPU-rasterized occluders
+	bool gpu_culling = false;       // frustum cull in cull.comp and draw with multi-draw-indirect
+	bool hiz_culling = false;       // with gpu_culling, also test against last frame's depth pyramid
+	bool dynamic_resolution = false; // render scale follows gpu_target_ms, see DynamicResolution
+	float resolution_scale = 1.0f;  // manual render scale per axis, used while dynamic_resolution is off
+	float gpu_target_ms = 16.0f;
+	float min_resolution_scale = 0.5f;
+	int upscale_filter = 1;         // UpscaleFilter of the quad pass
+	float sharpness = 0.5f;         // UPSCALE_SHARPEN strength, 0 - 1
 };
 
 // SCENE CLASS
@@ -20,18 +39,12 @@ struct Properties {
 class Scene {
 private:
 	std::vector<Object*> objects;  // Single container for all objects
-	Camera* camera;
+	Camera* camera = nullptr;
 	Skybox* skybox = nullptr;
 
 	unsigned int count_models = 0;
 	unsigned int count_lights = 0;
 
-	Shader* model_shader;
-	Shader* outline_shader;
-	Shader* skybox_shader;
-	Shader* DLdepth_shader;
-	Shader* PLdepth_shader;
-
 	int active_camera;
 
 	// Maps IDs to objects
@@ -73,24 +86,11 @@ public:
 
 	Skybox* AddSkybox();
 
-	// SETTING SHADERS
-	//=-------------------------------------=
-	void setModelShader(Shader& shad) { model_shader = &shad; }
-	void setOutlineShader(Shader& shad) { outline_shader = &shad; }
-	void setSkyboxShader(Shader& shad) { skybox_shader = &shad; }
-	void setDLDepthShader(Shader& shad) { DLdepth_shader = &shad; }
-	void setPLDepthShader(Shader& shad) { PLdepth_shader = &shad; }
-
-
 	// Delete an object by ID
 	void Delete(unsigned int id);
 
 	// Clear the scene
 	void Clear();
-
-	void Draw(unsigned int active_camera_index, unsigned int frame_buffer, 
-						unsigned int screenWidth, unsigned int screenHeight, 
-						unsigned int cubeMapArray, unsigned int depthMapFBO);
 };
 
 #endif
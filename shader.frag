@@ -1,12 +1,9 @@
-#version 420 core
+#version 450 core
 out vec4 FragColor;
 
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
+struct MaterialData {
+    vec4 diffuse;   // rgb - diffuse
+    vec4 specular;  // rgb - specular, a - shininess
 };
 
 struct DirLight {
@@ -15,40 +12,44 @@ struct DirLight {
     vec3 specular;
 };
 
+// std430 light records (see light_buffer.h)
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 diffuse;
+    float linear;
     vec3 specular;
+    float quadratic;
 
-    float PLfarPlane;
+    float farPlane;
+    int shadowIndex;    // -1 - no shadow map
+    float radius;       // light fades out to zero here
+    float pad;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-  
     float constant;
+    vec3 direction;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
+    float cutOff;
 
-    vec3 diffuse;
-    vec3 specular;       
+    float outerCutOff;
+    int shadowIndex;    // -1 - no shadow map
+    float radius;
+    float pad;
 };
 
-#define MAX_LIGHTS 20
 #define NUM_CASCADES 4
 
 in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
+    flat uint MaterialIndex;
 } fs_in;
 
 layout (std140, binding = 0) uniform Matrices
@@ -57,35 +58,90 @@ layout (std140, binding = 0) uniform Matrices
     mat4 view;
 };
 
+layout (std430, binding = 4) readonly buffer Materials
+{
+    MaterialData materials[];
+};
+
+// material texture table (see MaterialTextureSlot)
+layout (binding = 0) uniform sampler2D texture_diffuse1;
+layout (binding = 1) uniform sampler2D texture_specular1;
+
+// material constants of the current draw, fetched once in main()
+vec3 matDiffuse;
+vec3 matSpecular;
+float matShininess;
+
 uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[MAX_LIGHTS];
-uniform int numPointLights;
-uniform SpotLight spotLights[MAX_LIGHTS];
-uniform int numSpotLights;
-uniform Material material;
-uniform vec3 ambient;
 
-uniform sampler2DArray DLshadowMap;
-uniform float DLfarPlane;
+layout (std430, binding = 6) readonly buffer LightGlobals
+{
+    vec3 ambient;
+    int numPointLights;
+    vec3 dirDirection;
+    int numSpotLights;
+    vec3 dirDiffuse;
+    int cascadeCount;   // number of frusta - 1
+    vec3 dirSpecular;
+    float dirFarPlane;
+    float cascadePlaneDistances[16];
+};
+
+layout (std430, binding = 7) readonly buffer PointLights
+{
+    PointLight pointLights[];
+};
+
+layout (std430, binding = 8) readonly buffer SpotLights
+{
+    SpotLight spotLights[];
+};
+
+// light clusters (see light_clusters.h), x - offset into lightIndices,
+// y - point lights, z - spot lights following them
+layout (std430, binding = 9) readonly buffer LightClusters
+{
+    uvec4 clusters[];
+};
+
+layout (std430, binding = 10) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
 
-uniform sampler2DArray PLshadowMapArray;
+uniform uvec3 clusterGrid;
+uniform vec2 clusterTileScale;  // clusterGrid.xy / viewport size
+uniform vec2 clusterDepthScale; // slice = log(depth) * x - y
 
+// directional light assembled from LightGlobals in main()
+DirLight dirLight;
 
+uniform sampler2DArray DLshadowMap;
+
+// point and spot light shadow maps, tiles of one atlas (see shadow_atlas.h)
+uniform sampler2D shadowAtlas;
 
+struct ShadowTile {
+    mat4 viewProjection;
+    vec4 rect;          // xy - offset, zw - size, in atlas uv
+};
+
+layout (std430, binding = 15) readonly buffer ShadowTiles
+{
+    ShadowTile shadowTiles[];
+};
 
 layout (std140, binding = 1) uniform LightSpaceMatrices
 {
     mat4 lightSpaceMatrices[16];
 };
-uniform float cascadePlaneDistances[16];
-uniform int cascadeCount;   // number of frusta - 1
 
 uniform samplerCube skybox;
 
 // function prototypes
+float RadiusFalloff(float distance, float radius);
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, unsigned int index);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 float DLShadowCalculation(vec3 fragPosWorldSpace)
@@ -138,7 +194,7 @@ float DLShadowCalculation(vec3 fragPosWorldSpace)
     const float biasModifier = 0.05;
     if (layer == cascadeCount)
     {
-        bias *= 1 / (DLfarPlane * biasModifier);
+        bias *= 1 / (dirFarPlane * biasModifier);
     }
     else
     {
@@ -160,120 +216,98 @@ float DLShadowCalculation(vec3 fragPosWorldSpace)
 
     return shadow;
 }
-//
-//float PLShadowCalculation(vec3 fragPos, PointLight light, unsigned int index)
-//{
-//    // get vector between fragment position and light position
-//    vec3 fragToLight = fragPos - light.position;
-//    // ise the fragment to light vector to sample from the depth map    
-//    float closestDepth = texture(shadowMap, fragToLight).r;
-//    // it is currently in linear range between [0,1], let's re-transform it back to original depth value
-//    closestDepth *= light.PLfarPlane;
-//    // now get current linear depth as the length between the fragment and light position
-//    float currentDepth = length(fragToLight);
-//    // test for shadows
-//    float bias = 0.05; // we use a much larger bias since depth is now in [near_plane, far_plane] range
-//    float shadow = currentDepth -  bias > closestDepth ? 1.0 : 0.0;        
-//    // display closestDepth as debug (to visualize depth cubemap)
-//     //FragColor = vec4(vec3(closestDepth / PLfarPlane), 1.0);    
-//        
-//    return shadow;
-//}
-//
-
-float PLShadowCalculation(vec3 fragPos, PointLight light, uint lightIndex)
-{
-    // Get vector between fragment position and light position
-    vec3 fragToLight = fragPos - light.position;
 
-    // Determine which face of the cube the fragment falls into
-    int faceIndex;
-    vec2 uv;
+// shadow of a light face stored in one tile of the atlas
+float AtlasShadowCalculation(int tileIndex, vec3 fragPos, vec3 normal, float distance)
+{
+    ShadowTile tile = shadowTiles[tileIndex];
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowAtlas, 0));
 
-    vec3 absFragToLight = abs(fragToLight);
+    // Normal bias of about a texel and a half of this tile at this distance
+    float tileTexels = tile.rect.z / texelSize.x;
+    vec4 fragPosLightSpace = tile.viewProjection * vec4(fragPos + normal * (3.0 * distance / tileTexels), 1.0);
+    if (fragPosLightSpace.w <= 0.0)
+        return 0.0;
+    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w * 0.5 + 0.5;
+    if (projCoords.z > 1.0)
+        return 0.0;
 
-    if (absFragToLight.x > absFragToLight.y && absFragToLight.x > absFragToLight.z) {
-        faceIndex = fragToLight.x > 0 ? 0 : 1; // +X or -X
-        uv = vec2(-fragToLight.z, -fragToLight.y) / absFragToLight.x;
-    } else if (absFragToLight.y > absFragToLight.x && absFragToLight.y > absFragToLight.z) {
-        faceIndex = fragToLight.y > 0 ? 2 : 3; // +Y or -Y
-        uv = vec2(fragToLight.x, fragToLight.z) / absFragToLight.y;
-    } else {
-        faceIndex = fragToLight.z > 0 ? 4 : 5; // +Z or -Z
-        uv = vec2(fragToLight.x, -fragToLight.y) / absFragToLight.z;
+    // PCF, taps are clamped inside the tile so they never read a neighbour
+    vec2 uv = tile.rect.xy + clamp(projCoords.xy, 0.0, 1.0) * tile.rect.zw;
+    vec2 uvMin = tile.rect.xy + 0.5 * texelSize;
+    vec2 uvMax = tile.rect.xy + tile.rect.zw - 0.5 * texelSize;
+    const float bias = 0.0001;
+    float shadow = 0.0;
+    for (int x = -1; x <= 1; ++x)
+    {
+        for (int y = -1; y <= 1; ++y)
+        {
+            float pcfDepth = texture(shadowAtlas, clamp(uv + vec2(x, y) * texelSize, uvMin, uvMax)).r;
+            shadow += (projCoords.z - bias) > pcfDepth ? 1.0 : 0.0;
+        }
     }
+    return shadow / 9.0;
+}
 
-    // Convert UV from [-1, 1] to [0, 1]
-    uv = uv * 0.5 + 0.5;
-
-    // Compute the correct layer in the 2D texture array
-    unsigned int layerIndex = (lightIndex * 6) + faceIndex;
-
-    // Sample depth from 2D array
-    float closestDepth = texture(PLshadowMapArray, vec3(uv, layerIndex)).r;
-
-    // Transform the depth value back to the original range [0, farPlane]
-    closestDepth *= light.PLfarPlane;
-
-    // Calculate the current linear depth as the length between the fragment and light position
-    float currentDepth = length(fragToLight);
-
-    // Apply a bias to reduce shadow acne
-    float bias = 0.05; // Adjust this value as needed
+float PLShadowCalculation(vec3 fragPos, vec3 normal, PointLight light)
+{
+    if (light.shadowIndex < 0)
+        return 0.0;
 
-    // Test for shadows
-    float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
+    // Cube face the fragment falls into, tiles follow the +X -X +Y -Y +Z -Z
+    // order of PointShadowMatrices
+    vec3 fragToLight = fragPos - light.position;
+    vec3 absFragToLight = abs(fragToLight);
+    int faceIndex;
+    if (absFragToLight.x >= absFragToLight.y && absFragToLight.x >= absFragToLight.z)
+        faceIndex = fragToLight.x > 0.0 ? 0 : 1;
+    else if (absFragToLight.y >= absFragToLight.z)
+        faceIndex = fragToLight.y > 0.0 ? 2 : 3;
+    else
+        faceIndex = fragToLight.z > 0.0 ? 4 : 5;
 
-    return shadow;
+    return AtlasShadowCalculation(light.shadowIndex + faceIndex, fragPos, normal, length(fragToLight));
 }
 
-
-//float PLShadowCalculation(vec3 fragPos, PointLight light, unsigned int index)
-//{
-//    // Get vector between fragment position and light position
-//    vec3 fragToLight = fragPos - light.position;
-//
-//    // Sample from the cube map array using the fragment-to-light vector and the layer index
-//    float closestDepth = texture(PLshadowMapArray, vec4(fragToLight, index)).r;
-//
-//    // Transform the depth value back to the original range [0, farPlane]
-//    closestDepth *= light.PLfarPlane;
-//
-//    // Calculate the current linear depth as the length between the fragment and light position
-//    float currentDepth = length(fragToLight);
-//
-//    // Apply a bias to reduce shadow acne
-//    float bias = 0.05; // Adjust this value as needed
-//
-//    // Test for shadows
-//    float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
-//
-//    return shadow;
-//}
+float SLShadowCalculation(vec3 fragPos, vec3 normal, SpotLight light)
+{
+    if (light.shadowIndex < 0)
+        return 0.0;
+    return AtlasShadowCalculation(light.shadowIndex, fragPos, normal, length(fragPos - light.position));
+}
 
 void main()
 {    
     // properties
+    MaterialData material = materials[fs_in.MaterialIndex];
+    matDiffuse = material.diffuse.rgb;
+    matSpecular = material.specular.rgb;
+    matShininess = material.specular.a;
+
+    dirLight = DirLight(dirDirection, dirDiffuse, dirSpecular);
+
     vec3 norm = normalize(fs_in.Normal);
     vec3 viewDir = normalize(viewPos - fs_in.FragPos);
 
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
 
+    // only the lights binned into this fragment's cluster
+    float viewDepth = -(view * vec4(fs_in.FragPos, 1.0)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterTileScale), clusterGrid.xy - 1u);
+    uint slice = uint(clamp(log(viewDepth) * clusterDepthScale.x - clusterDepthScale.y, 0.0, float(clusterGrid.z - 1u)));
+    uvec4 cluster = clusters[(slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+
     // phase 2: point lights
-    for(unsigned int i = 0; i < numPointLights; i++){
-        result += CalcPointLight(pointLights[i], norm, fs_in.FragPos, viewDir, i); 
+    for(uint i = 0u; i < cluster.y; i++){
+        result += CalcPointLight(pointLights[lightIndices[cluster.x + i]], norm, fs_in.FragPos, viewDir); 
     }
 
-    //result += CalcPointLight(pointLights[0], norm, fs_in.FragPos, viewDir, PLshadowMap[0], pointLights[0].PLfarPlane); 
-    //result += CalcPointLight(pointLights[1], norm, fs_in.FragPos, viewDir, PLshadowMap[1], pointLights[1].PLfarPlane); 
-    //result += CalcPointLight(pointLights[2], norm, fs_in.FragPos, viewDir, PLshadowMap[2], pointLights[2].PLfarPlane); 
-    
     // phase 3: spot light
-    for(int i = 0; i < numSpotLights; i++)
-        result += CalcSpotLight(spotLights[i], norm, fs_in.FragPos, viewDir); 
+    for(uint i = 0u; i < cluster.z; i++)
+        result += CalcSpotLight(spotLights[lightIndices[cluster.x + cluster.y + i]], norm, fs_in.FragPos, viewDir); 
         
-    result += ambient * vec3(texture(material.texture_diffuse1, fs_in.TexCoords)) * material.diffuse;
+    result += ambient * vec3(texture(texture_diffuse1, fs_in.TexCoords)) * matDiffuse;
     
     FragColor = vec4(result, 1.0);
 }
@@ -286,32 +320,33 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), matShininess);
     // combine results
 
     float shadow = DLShadowCalculation(fs_in.FragPos);
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, fs_in.TexCoords)) * material.diffuse;
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, fs_in.TexCoords)) * material.specular;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, fs_in.TexCoords)) * matDiffuse;
+    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, fs_in.TexCoords)) * matSpecular;
     return (1.0 - shadow) * (diffuse + specular);
 }
 
  //calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, unsigned int index){
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir){
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), matShininess);
     // attenuation
     float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance);    
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    attenuation *= RadiusFalloff(distance, light.radius);
     // combine results
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, fs_in.TexCoords)) * material.diffuse;
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, fs_in.TexCoords)) * material.specular;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, fs_in.TexCoords)) * matDiffuse;
+    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, fs_in.TexCoords)) * matSpecular;
     diffuse *= attenuation;
     specular *= attenuation;
-    float shadow = PLShadowCalculation(fragPos, light, index);
+    float shadow = PLShadowCalculation(fragPos, normal, light);
          
     return (1.0 - shadow) * (diffuse + specular);
 }
@@ -323,18 +358,28 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), matShininess);
     // attenuation
     float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance);    
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    attenuation *= RadiusFalloff(distance, light.radius);
     // spotlight intensity
     float theta = dot(lightDir, normalize(-light.direction)); 
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, fs_in.TexCoords)) * material.diffuse;
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, fs_in.TexCoords)) * material.specular;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, fs_in.TexCoords)) * matDiffuse;
+    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, fs_in.TexCoords)) * matSpecular;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
-    return (diffuse + specular);
+    float shadow = SLShadowCalculation(fragPos, normal, light);
+    return (1.0 - shadow) * (diffuse + specular);
+}
+
+// fades the light to zero at its radius, so the cluster bounds are exact
+float RadiusFalloff(float distance, float radius)
+{
+    float x = distance / radius;
+    float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return window * window;
 }
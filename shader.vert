@@ -1,31 +1,54 @@
-#version 420 core
+#version 450 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in uint aDrawIndex;
 
 out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
+    flat uint MaterialIndex;
 } vs_out;
 
+// the depth prepass computes the same position (depth_prepass.vert)
+invariant gl_Position;
+
 layout (std140) uniform Matrices
 {
     mat4 projection;
     mat4 view;
 };
 
-uniform mat4 model;
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 scale;     // xyz - object scale
+    uvec4 flags;    // x - useTextureScaling
+};
+
+layout (std430, binding = 3) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+layout (std430, binding = 5) readonly buffer Draws
+{
+    uvec2 draws[];  // x - object, y - material
+};
 
-uniform vec3 objectScale;
-uniform bool useTextureScaling;
+// Scale applied in model space, used by the selection outline
+uniform float outlineScale = 1.0;
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
-    if(useTextureScaling){
-        vec3 absScale = abs(objectScale);
+    uvec2 draw = draws[aDrawIndex];
+    ObjectData object = objects[draw.x];
+    vs_out.MaterialIndex = draw.y;
+    vs_out.FragPos = vec3(object.model * vec4(aPos * outlineScale, 1.0));
+    vs_out.Normal = mat3(object.normalMatrix) * aNormal;
+    if(object.flags.x != 0u){
+        vec3 absScale = abs(object.scale.xyz);
         vec3 absNormal = abs(aNormal);// getting dominat axis
         if (absNormal.y > absNormal.x && absNormal.y > absNormal.z) {
             // fro y -> xz
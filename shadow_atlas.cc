@@ -0,0 +1,284 @@
+#include "shadow_atlas.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Near plane of the light frusta, the far plane is the light's range
+static const float SHADOW_NEAR_PLANE = 0.05f;
+
+static int FloorPow2(int value) {
+  int result = 1;
+  while (result * 2 <= value) result *= 2;
+  return result;
+}
+
+glm::mat4 SpotShadowMatrix(const glm::vec3& position, const glm::vec3& direction, float cos_angle, float range) {
+  // Slightly wider than the outer cone so its edge never samples the border
+  float fov = 2.0f * std::acos(glm::clamp(cos_angle, 0.0f, 1.0f)) * 1.05f;
+  fov = glm::clamp(fov, glm::radians(1.0f), glm::radians(170.0f));
+  glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+  glm::mat4 projection = glm::perspective(fov, 1.0f, SHADOW_NEAR_PLANE, std::max(range, SHADOW_NEAR_PLANE * 2.0f));
+  return projection * glm::lookAt(position, position + direction, up);
+}
+
+void PointShadowMatrices(const glm::vec3& position, float range, glm::mat4 faces[6]) {
+  glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE,
+                                          std::max(range, SHADOW_NEAR_PLANE * 2.0f));
+  faces[0] = projection * glm::lookAt(position, position + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+  faces[1] = projection * glm::lookAt(position, position + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+  faces[2] = projection * glm::lookAt(position, position + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  faces[3] = projection * glm::lookAt(position, position + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+  faces[4] = projection * glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+  faces[5] = projection * glm::lookAt(position, position + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+}
+
+float ShadowImportance(const glm::mat4& view_projection, const glm::vec3& camera_position, float tan_half_fov,
+                       const glm::vec3& center, float radius) {
+  // Sphere against the frustum planes (rows of the matrix)
+  for (int i = 0; i < 3; i++) {
+    for (float sign : { 1.0f, -1.0f }) {
+      glm::vec4 plane;
+      for (int c = 0; c < 4; c++) plane[c] = view_projection[c][3] + sign * view_projection[c][i];
+      float length = glm::length(glm::vec3(plane));
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * length) return 0.0f;
+    }
+  }
+
+  float distance = glm::length(center - camera_position);
+  if (distance <= radius) return 1.0f;
+  float projected = radius / std::sqrt(distance * distance - radius * radius);
+  return std::min(projected / tan_half_fov, 1.0f);
+}
+
+ShadowAtlas::~ShadowAtlas() {
+  Resize(0);
+}
+
+void ShadowAtlas::Begin() {
+  requests_.clear();
+}
+
+void ShadowAtlas::Request(const void* owner, int faces, float importance) {
+  if (faces <= 0 || importance <= 0.0f) return;
+  requests_.push_back({ owner, faces, importance });
+}
+
+void ShadowAtlas::Finish() {
+  stats_ = ShadowAtlasStats();
+  stats_.requested = (unsigned int)requests_.size();
+  std::stable_sort(requests_.begin(), requests_.end(), [](const TileRequest& a, const TileRequest& b) {
+    return a.importance > b.importance;
+  });
+
+  // Wanted tile sizes, the atlas is sized for all of them
+  std::vector<int> sizes(requests_.size());
+  size_t area = 0;
+  int largest = 0;
+  for (size_t i = 0; i < requests_.size(); i++) {
+    auto it = allocations_.find(requests_[i].owner);
+    const ShadowTile* current = it != allocations_.end() && !it->second.tiles.empty() ? &it->second.tiles[0] : nullptr;
+    sizes[i] = TileSize(requests_[i].importance, current);
+    area += (size_t)requests_[i].faces * sizes[i] * sizes[i];
+    largest = std::max(largest, sizes[i]);
+  }
+
+  int wanted = 0;
+  if (!requests_.empty()) {
+    wanted = std::max(largest, FloorPow2(std::max(min_tile, 1)));
+    while ((size_t)wanted * wanted < area && wanted < max_size) wanted *= 2;
+    if (grow_ && wanted <= size_) wanted = size_ * 2;
+    wanted = std::min(wanted, FloorPow2(max_size));
+  }
+  grow_ = false;
+  if (wanted > size_) Resize(wanted);
+  else if (wanted < size_) {
+    if (++small_frames_ >= SHRINK_FRAMES) Resize(wanted);
+  }
+  else small_frames_ = 0;
+  if (!size_) return;
+
+  // Tiles of lights that did not ask again or want another size are freed
+  // before anything is placed
+  for (auto& entry : allocations_) entry.second.requested = false;
+  for (size_t i = 0; i < requests_.size(); i++) {
+    auto it = allocations_.find(requests_[i].owner);
+    if (it == allocations_.end()) continue;
+    Allocation& allocation = it->second;
+    allocation.requested = true;
+    if (!allocation.tiles.empty() &&
+        (allocation.tiles[0].size != sizes[i] || (int)allocation.tiles.size() != requests_[i].faces)) {
+      Free(allocation.tiles);
+    }
+  }
+  for (auto it = allocations_.begin(); it != allocations_.end();) {
+    if (it->second.requested) {
+      ++it;
+      continue;
+    }
+    Free(it->second.tiles);
+    it = allocations_.erase(it);
+  }
+
+  size_t used = 0;
+  for (size_t i = 0; i < requests_.size(); i++) {
+    const TileRequest& request = requests_[i];
+    Allocation& allocation = allocations_[request.owner];
+    allocation.requested = true;
+    for (int size = sizes[i]; allocation.tiles.empty() && size >= min_tile; size /= 2) {
+      Allocate(request.faces, size, allocation.tiles);
+    }
+    if (allocation.tiles.empty()) {
+      grow_ = size_ < max_size;
+      allocations_.erase(request.owner);
+      continue;
+    }
+    stats_.shadowed++;
+    stats_.tiles += (unsigned int)allocation.tiles.size();
+    used += allocation.tiles.size() * (size_t)allocation.tiles[0].size * allocation.tiles[0].size;
+  }
+  stats_.size = size_;
+  stats_.bytes = (size_t)size_ * size_ * 4 * 2;
+  stats_.used = used / ((float)size_ * size_);
+}
+
+const std::vector<ShadowTile>* ShadowAtlas::tiles(const void* owner) const {
+  auto it = allocations_.find(owner);
+  if (it == allocations_.end() || it->second.tiles.empty()) return nullptr;
+  return &it->second.tiles;
+}
+
+glm::vec4 ShadowAtlas::Rect(const ShadowTile& tile) const {
+  return glm::vec4(tile.x, tile.y, tile.size, tile.size) / (float)size_;
+}
+
+int ShadowAtlas::TileSize(float importance, const ShadowTile* current) const {
+  int largest = FloorPow2(std::min(max_tile, max_size));
+  int smallest = std::min(FloorPow2(std::max(min_tile, 1)), largest);
+  float octave = std::log2(std::max(importance * largest, 1.0f));
+
+  // A light keeps its size a quarter octave past the rounding point, so
+  // one on the edge between two sizes does not flip every frame
+  if (current && current->size >= smallest && current->size <= largest &&
+      std::abs(std::log2((float)current->size) - octave) < 0.75f) {
+    return current->size;
+  }
+  int size = 1 << (int)std::lround(octave);
+  return std::clamp(size, smallest, largest);
+}
+
+bool ShadowAtlas::Allocate(int faces, int tile_size, std::vector<ShadowTile>& tiles) {
+  int level = Level(tile_size);
+  if (level < 0) return false;
+  for (int face = 0; face < faces; face++) {
+    ShadowTile tile;
+    if (!AllocateNode(level, tile)) {
+      Free(tiles);
+      return false;
+    }
+    tiles.push_back(tile);
+  }
+  return true;
+}
+
+void ShadowAtlas::Free(std::vector<ShadowTile>& tiles) {
+  for (const ShadowTile& tile : tiles) FreeNode(tile);
+  tiles.clear();
+}
+
+bool ShadowAtlas::AllocateNode(int level, ShadowTile& tile) {
+  if (level < 0 || level >= (int)free_.size()) return false;
+  auto& free = free_[level];
+  if (!free.empty()) {
+    // Lowest free node first keeps the used part of the atlas compact
+    tile = { free.begin()->first, free.begin()->second, size_ >> level };
+    free.erase(free.begin());
+    return true;
+  }
+
+  // Split a node of the level above, keep one quadrant and free the rest
+  ShadowTile parent;
+  if (!AllocateNode(level - 1, parent)) return false;
+  int half = parent.size / 2;
+  free.insert({ parent.x + half, parent.y });
+  free.insert({ parent.x, parent.y + half });
+  free.insert({ parent.x + half, parent.y + half });
+  tile = { parent.x, parent.y, half };
+  return true;
+}
+
+void ShadowAtlas::FreeNode(ShadowTile tile) {
+  int level = Level(tile.size);
+  if (level < 0) return;
+
+  // Merge with the three siblings while they are all free
+  while (level > 0) {
+    int parent_size = tile.size * 2;
+    int x = tile.x / parent_size * parent_size;
+    int y = tile.y / parent_size * parent_size;
+    std::pair<int, int> quadrants[4] = { { x, y }, { x + tile.size, y }, { x, y + tile.size },
+                                         { x + tile.size, y + tile.size } };
+    bool siblings_free = true;
+    for (const auto& quadrant : quadrants) {
+      if (quadrant.first == tile.x && quadrant.second == tile.y) continue;
+      siblings_free = siblings_free && free_[level].count(quadrant);
+    }
+    if (!siblings_free) break;
+    for (const auto& quadrant : quadrants) free_[level].erase(quadrant);
+    tile = { x, y, parent_size };
+    level--;
+  }
+  free_[level].insert({ tile.x, tile.y });
+}
+
+int ShadowAtlas::Level(int tile_size) const {
+  int level = 0;
+  int size = size_;
+  while (size > tile_size) {
+    size /= 2;
+    level++;
+  }
+  return size == tile_size && size > 0 ? level : -1;
+}
+
+void ShadowAtlas::Resize(int size) {
+  for (GLuint* fbo : { &fbo_, &static_fbo_ }) {
+    if (*fbo) glDeleteFramebuffers(1, fbo);
+    *fbo = 0;
+  }
+  for (GLuint* texture : { &texture_, &static_texture_ }) {
+    if (*texture) glDeleteTextures(1, texture);
+    *texture = 0;
+  }
+  size_ = size;
+  generation_++;
+  small_frames_ = 0;
+  allocations_.clear();
+  free_.clear();
+  if (!size_) return;
+
+  // Every tile size from the whole atlas down to min_tile has a level
+  free_.resize(Level(std::min(FloorPow2(std::max(min_tile, 1)), size_)) + 1);
+  free_[0].insert({ 0, 0 });
+
+  CreateTarget(size_, texture_, fbo_);
+  CreateTarget(size_, static_texture_, static_fbo_);
+}
+
+void ShadowAtlas::CreateTarget(int size, GLuint& texture, GLuint& fbo) {
+  glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+  glTextureStorage2D(texture, 1, GL_DEPTH_COMPONENT32F, size, size);
+  glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glCreateFramebuffers(1, &fbo);
+  glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, texture, 0);
+  glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+  glNamedFramebufferReadBuffer(fbo, GL_NONE);
+  if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "ERROR::FRAMEBUFFER:: Shadow atlas framebuffer is not complete!" << std::endl;
+}
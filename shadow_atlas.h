@@ -0,0 +1,146 @@
+#ifndef SHADOW_ATLAS_H_
+#define SHADOW_ATLAS_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Binding point of the shadow tile SSBO in the shaders
+const unsigned int SHADOW_TILE_BINDING = 15;
+
+// Texture unit of the atlas, the directional light cascades stay on unit 3
+const unsigned int SHADOW_ATLAS_UNIT = 4;
+
+// Per-tile record, std430 (must match the ShadowTiles block in shader.frag)
+struct ShadowTileData {
+  glm::mat4 view_projection;  // world to the clip space of the tile's light face
+  glm::vec4 rect;             // xy - offset, zw - size, in atlas uv
+};
+
+static_assert(sizeof(ShadowTileData) == 80, "ShadowTileData must match std430 layout");
+
+// Square region of the atlas, in texels
+struct ShadowTile {
+  int x = 0, y = 0, size = 0;
+};
+
+// A light that got tiles this frame and the sphere its casters must touch
+struct ShadowedLight {
+  const void* owner;
+  glm::vec3 center;
+  float radius;
+  unsigned int first_tile;  // into the tile records
+  unsigned int tile_count;
+  float importance;         // see ShadowImportance
+};
+
+struct ShadowAtlasStats {
+  unsigned int requested = 0;  // lights that asked for tiles
+  unsigned int shadowed = 0;   // lights that got them
+  unsigned int tiles = 0;
+  int size = 0;                // atlas edge in texels, 0 - not allocated
+  size_t bytes = 0;            // sampled and static atlas
+  float used = 0.0f;           // fraction of the atlas covered by tiles
+};
+
+// Perspective of a spot light cone and of the six faces of a point light,
+// in the +X -X +Y -Y +Z -Z order the shaders pick faces in
+glm::mat4 SpotShadowMatrix(const glm::vec3& position, const glm::vec3& direction, float cos_angle, float range);
+void PointShadowMatrices(const glm::vec3& position, float range, glm::mat4 faces[6]);
+
+// Screen importance of a light volume: the fraction of the viewport height
+// its bounding sphere covers, 1 with the camera inside, 0 off screen
+float ShadowImportance(const glm::mat4& view_projection, const glm::vec3& camera_position, float tan_half_fov,
+                       const glm::vec3& center, float radius);
+
+// SHADOW ATLAS
+//=-----------------------------=
+// One depth texture shared by the shadow maps of point and spot lights.
+// Each frame the visible lights request one tile per face (6 for a point
+// light, 1 for a spot light), sized from their screen importance as a power
+// of two between min_tile and max_tile. Finish places the requests most
+// important first with a quadtree (buddy) allocator; a light that does not
+// fit is retried at half size down to min_tile, then left unshadowed.
+// A light keeps its tiles while the size it wants stays close to the one it
+// has, so tiles do not move around from frame to frame.
+// The texture is made on the first request and sized to the smallest power
+// of two that holds the requested area, up to max_size; it shrinks again
+// after the area stayed under a quarter for SHRINK_FRAMES frames.
+// A second texture with the same layout holds the static casters of every
+// tile, see ShadowCache.
+class ShadowAtlas {
+  struct TileRequest {
+    const void* owner;
+    int faces;
+    float importance;
+  };
+  struct Allocation {
+    std::vector<ShadowTile> tiles;
+    bool requested;
+  };
+
+  // Free quadtree nodes per level, level 0 is the whole atlas
+  std::vector<std::set<std::pair<int, int>>> free_;
+  std::map<const void*, Allocation> allocations_;
+  std::vector<TileRequest> requests_;
+
+  GLuint texture_ = 0;
+  GLuint fbo_ = 0;
+  GLuint static_texture_ = 0;   // same layout, static casters only (see ShadowCache)
+  GLuint static_fbo_ = 0;
+  int size_ = 0;
+  unsigned int generation_ = 0; // bumped when the textures are recreated
+  bool grow_ = false;           // a request did not fit, try a larger atlas next frame
+  unsigned int small_frames_ = 0;
+  ShadowAtlasStats stats_;
+
+public:
+  static const unsigned int SHRINK_FRAMES = 120;
+
+  int max_size = 4096;
+  int max_tile = 1024;          // tile of a light that fills the screen
+  int min_tile = 128;
+
+  ShadowAtlas() = default;
+  ShadowAtlas(const ShadowAtlas&) = delete;
+  ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+  ~ShadowAtlas();
+
+  void Begin();
+  // importance in [0, 1], see ShadowImportance
+  void Request(const void* owner, int faces, float importance);
+  // Places this frame's requests and frees the tiles of lights that did
+  // not ask again
+  void Finish();
+
+  // Tiles of owner this frame, null when it got none
+  const std::vector<ShadowTile>* tiles(const void* owner) const;
+
+  // Offset and size of a tile in atlas uv
+  glm::vec4 Rect(const ShadowTile& tile) const;
+
+  GLuint texture() const { return texture_; }
+  GLuint framebuffer() const { return fbo_; }
+  GLuint static_texture() const { return static_texture_; }
+  GLuint static_framebuffer() const { return static_fbo_; }
+  unsigned int generation() const { return generation_; }
+  int size() const { return size_; }
+  const ShadowAtlasStats& stats() const { return stats_; }
+
+private:
+  int TileSize(float importance, const ShadowTile* current) const;
+  bool Allocate(int faces, int tile_size, std::vector<ShadowTile>& tiles);
+  void Free(std::vector<ShadowTile>& tiles);
+  bool AllocateNode(int level, ShadowTile& tile);
+  void FreeNode(ShadowTile tile);
+  int Level(int tile_size) const;
+  void Resize(int size);
+  static void CreateTarget(int size, GLuint& texture, GLuint& fbo);
+};
+
+#endif
@@ -0,0 +1,28 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in uint aDrawIndex;
+
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    vec4 scale;
+    uvec4 flags;
+};
+
+layout (std430, binding = 3) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+layout (std430, binding = 5) readonly buffer Draws
+{
+    uvec2 draws[];  // x - object, y - material
+};
+
+// world to the clip space of the light face of the current atlas tile
+uniform mat4 lightSpaceMatrix;
+
+void main()
+{
+    gl_Position = lightSpaceMatrix * objects[draws[aDrawIndex].x].model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,138 @@
+#ifndef SHADOW_CACHE_H_
+#define SHADOW_CACHE_H_
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+
+#include "object.h"
+
+// Identity of a set of static casters: which objects and their revisions.
+// Revisions are unique across objects and include the parents, so any
+// change to a caster or its hierarchy changes the key.
+class ShadowCasterKey {
+  uint64_t hash_ = 14695981039346656037ull;
+  unsigned int count_ = 0;
+
+  void Mix(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+      hash_ ^= (value >> (i * 8)) & 0xFF;
+      hash_ *= 1099511628211ull;
+    }
+  }
+
+public:
+  void Add(const Object* caster) {
+    Mix((uint64_t)(uintptr_t)caster);
+    Mix(caster->GetRevision());
+    count_++;
+  }
+  uint64_t value() const { return hash_ ^ count_; }
+};
+
+// What to redraw for one shadow view this frame
+struct ShadowUpdate {
+  bool static_layer;  // clear and draw the static casters into the static layer
+  bool live;          // copy the static layer into the sampled map, then draw the dynamic casters
+};
+
+struct ShadowCacheStats {
+  unsigned int views = 0;           // cascades and atlas tiles checked this frame
+  unsigned int static_renders = 0;  // static layers redrawn
+  unsigned int live_updates = 0;    // sampled maps rebuilt
+  unsigned int deferred = 0;        // stale views kept for a later frame, see Defer
+};
+
+// SHADOW CACHE
+//=-----------------------------=
+// Remembers how the static layer of every shadow view (a cascade, an atlas
+// tile) was last drawn. The static layer is redrawn only when the view's
+// matrix, its place in the target or its static casters changed; the
+// sampled map is rebuilt from it when the static layer changed, or when
+// dynamic casters are drawn this frame or were drawn last frame (their
+// old shadows have to go). An idle scene without dynamic casters draws
+// nothing. Views not checked for a few frames are forgotten.
+class ShadowCache {
+  struct View {
+    glm::mat4 matrix;
+    glm::ivec4 rect;
+    unsigned int target;
+    uint64_t casters;
+    bool dynamic;
+    unsigned int last_frame;
+    unsigned int deferred;  // frames in a row the view was deferred
+  };
+
+  std::map<std::pair<const void*, int>, View> views_;
+  unsigned int frame_ = 0;
+  ShadowCacheStats stats_;
+
+public:
+  static const unsigned int KEEP_FRAMES = 2;
+  // A view deferred this many frames in a row is redrawn on the next one
+  static const unsigned int MAX_DEFERRED_FRAMES = 8;
+
+  bool enabled = true;  // off - every view is redrawn every frame
+
+  void NewFrame() {
+    frame_++;
+    stats_ = ShadowCacheStats();
+    for (auto it = views_.begin(); it != views_.end();) {
+      if (frame_ - it->second.last_frame > KEEP_FRAMES) it = views_.erase(it);
+      else ++it;
+    }
+  }
+
+  // What Check would return, without remembering anything
+  ShadowUpdate Peek(const void* owner, int view, const glm::mat4& matrix, const glm::ivec4& rect,
+                    unsigned int target, uint64_t static_casters, bool dynamic) const {
+    auto it = views_.find({ owner, view });
+    bool cached = enabled && it != views_.end();
+    ShadowUpdate update;
+    update.static_layer = !cached || it->second.matrix != matrix || it->second.rect != rect ||
+                          it->second.target != target || it->second.casters != static_casters;
+    update.live = update.static_layer || dynamic || it->second.dynamic;
+    return update;
+  }
+
+  // view - cascade or face index of owner; target - changes whenever the
+  // texture behind rect is recreated
+  ShadowUpdate Check(const void* owner, int view, const glm::mat4& matrix, const glm::ivec4& rect,
+                     unsigned int target, uint64_t static_casters, bool dynamic) {
+    stats_.views++;
+    ShadowUpdate update = Peek(owner, view, matrix, rect, target, static_casters, dynamic);
+    views_[{ owner, view }] = { matrix, rect, target, static_casters, dynamic, frame_, 0 };
+    stats_.static_renders += update.static_layer;
+    stats_.live_updates += update.live;
+    return update;
+  }
+
+  // Keeps a view that is deliberately not redrawn this frame (a stale
+  // cascade) from being forgotten
+  void Touch(const void* owner, int view) {
+    auto it = views_.find({ owner, view });
+    if (it != views_.end()) it->second.last_frame = frame_;
+  }
+
+  // Leaves a stale view as it is for now. Only possible while its map is
+  // still at rect in target and for MAX_DEFERRED_FRAMES frames in a row, so
+  // a budget cannot starve a view; matrix is set to the one the map was
+  // drawn with, which the shaders must sample it with.
+  bool Defer(const void* owner, int view, const glm::ivec4& rect, unsigned int target, glm::mat4& matrix) {
+    auto it = views_.find({ owner, view });
+    if (!enabled || it == views_.end() || it->second.rect != rect || it->second.target != target ||
+        it->second.deferred >= MAX_DEFERRED_FRAMES) return false;
+    it->second.last_frame = frame_;
+    it->second.deferred++;
+    matrix = it->second.matrix;
+    stats_.views++;
+    stats_.deferred++;
+    return true;
+  }
+
+  const ShadowCacheStats& stats() const { return stats_; }
+};
+
+#endif
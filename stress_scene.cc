@@ -0,0 +1,181 @@
+#include "stress_scene.h"
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+// Attenuation that reaches the LIGHT_CUTOFF at radius for a light of
+// brightness 1, quadratic only so the falloff is physically shaped
+static float QuadraticForRadius(float radius) {
+  return (1.0f / LIGHT_CUTOFF - 1.0f) / (radius * radius);
+}
+
+static glm::vec3 HueColor(float hue) {
+  return glm::clamp(glm::abs(glm::mod(hue * 6.0f + glm::vec3(0.0f, 4.0f, 2.0f), 6.0f) - 3.0f) - 1.0f, 0.0f, 1.0f);
+}
+
+void StressScene::Build(Scene& scene, Camera* camera, const StressSceneOptions& options) {
+  std::mt19937 random(options.seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  unsigned int side = std::max(1u, (unsigned int)std::ceil(std::sqrt((float)std::max(options.models, 1u))));
+  extent_ = 0.5f * side * options.spacing;
+  center_ = glm::vec3(0.0f);
+
+  // LAYOUT
+  //=------------------=
+  std::vector<glm::vec3> positions(options.models);
+  std::vector<glm::vec3> cluster_centers(std::max(options.clusters, 1u));
+  for (glm::vec3& c : cluster_centers) c = glm::vec3((unit(random) * 2.0f - 1.0f) * extent_, 0.0f,
+                                                      (unit(random) * 2.0f - 1.0f) * extent_);
+  std::normal_distribution<float> spread(0.0f, extent_ / (2.0f * cluster_centers.size()));
+  for (unsigned int i = 0; i < options.models; i++) {
+    switch (options.layout) {
+    case StressLayout::GRID:
+      positions[i] = glm::vec3((i % side) * options.spacing - extent_, 0.0f, (i / side) * options.spacing - extent_);
+      break;
+    case StressLayout::RANDOM:
+      positions[i] = glm::vec3((unit(random) * 2.0f - 1.0f) * extent_, unit(random) * options.spacing,
+                               (unit(random) * 2.0f - 1.0f) * extent_);
+      break;
+    case StressLayout::CLUSTERED: {
+      const glm::vec3& c = cluster_centers[random() % cluster_centers.size()];
+      positions[i] = c + glm::vec3(spread(random), std::abs(spread(random)), spread(random));
+      break;
+    }
+    }
+  }
+
+  // MODELS
+  //=------------------=
+  // One load, the rest are instances of it. Chains of hierarchy_depth
+  // models hang off each other, a child keeps its layout position while its
+  // parents stand still and follows them when they move.
+  Model* prototype = nullptr;
+  Model* previous = nullptr;
+  unsigned int depth = std::max(options.hierarchy_depth, 1u);
+  for (unsigned int i = 0; i < options.models; i++) {
+    Model* model;
+    if (!prototype) {
+      std::vector<char> path(options.model_path.begin(), options.model_path.end());
+      path.push_back('\0');
+      model = prototype = scene.AddModel(path.data(), "Stress");
+    }
+    else {
+      model = scene.AddModel(prototype->Instance(), "Stress");
+    }
+    model->setSelection(false);
+
+    glm::vec3 local = positions[i];
+    if (i % depth) {
+      model->parent = previous;
+      local = positions[i] - positions[i - 1];
+    }
+    model->setPosition(local);
+
+    // Children of a moving model move too, without animating themselves
+    bool moves = unit(random) < options.dynamic_fraction;
+    model->is_static = !moves && (!model->parent || model->parent->is_static);
+    if (moves) movers_.push_back({ model, local, unit(random) * 6.2831853f });
+    previous = model;
+  }
+
+  // LIGHTS
+  //=------------------=
+  auto radius = [&]() {
+    return options.light_radius_min + unit(random) * (options.light_radius_max - options.light_radius_min);
+  };
+  auto light_position = [&]() {
+    return glm::vec3((unit(random) * 2.0f - 1.0f) * extent_, 1.0f + unit(random) * 2.0f,
+                     (unit(random) * 2.0f - 1.0f) * extent_);
+  };
+  for (unsigned int i = 0; i < options.point_lights; i++) {
+    PointLight* light = scene.AddPointLight(camera, light_position(), "StressPoint");
+    glm::vec3 color = HueColor(unit(random));
+    light->setColor({ color * 0.1f, color, color });
+    light->setAttenuation(1.0f, 0.0f, QuadraticForRadius(radius()));
+    light->is_static = true;
+  }
+  for (unsigned int i = 0; i < options.spot_lights; i++) {
+    SpotLight* light = scene.AddSpotLight("StressSpot");
+    glm::vec3 color = HueColor(unit(random));
+    light->setPosition(light_position());
+    light->setDirection(glm::vec3(unit(random) - 0.5f, -1.0f, unit(random) - 0.5f));
+    light->setColor({ glm::vec3(0.0f), color, color });
+    light->setAttenuation(1.0f, 0.0f, QuadraticForRadius(radius()));
+    light->is_static = true;
+  }
+}
+
+void StressScene::Animate(float time) {
+  for (const Mover& mover : movers_) {
+    mover.model->setPosition(mover.base + glm::vec3(0.0f, 0.5f * std::sin(2.0f * time + mover.phase), 0.0f));
+    mover.model->setRotation(glm::vec3(0.0f, std::fmod(45.0f * time + glm::degrees(mover.phase), 360.0f), 0.0f));
+  }
+}
+
+// The whole value has to be a number, "abc" or "12x" are rejected
+static bool ParseUnsigned(const char* value, unsigned int& out) {
+  char* end = nullptr;
+  unsigned long number = std::strtoul(value, &end, 10);
+  if (end == value || *end != '\0' || value[0] == '-') return false;
+  out = (unsigned int)number;
+  return true;
+}
+
+static bool ParseFloat(const char* value, float& out) {
+  char* end = nullptr;
+  float number = std::strtof(value, &end);
+  if (end == value || *end != '\0') return false;
+  out = number;
+  return true;
+}
+
+int ParseStressSceneArg(int argc, char** argv, int i, StressSceneOptions& options) {
+  const char* arg = argv[i];
+  if (strncmp(arg, "--stress-", 9) != 0) return 0;
+  if (i + 1 >= argc) {
+    std::cout << "Missing value for " << arg << std::endl;
+    return -1;
+  }
+  const char* value = argv[i + 1];
+  const char* name = arg + 9;
+  bool valid = true;
+  if (strcmp(name, "models") == 0) valid = ParseUnsigned(value, options.models);
+  else if (strcmp(name, "spacing") == 0) valid = ParseFloat(value, options.spacing);
+  else if (strcmp(name, "clusters") == 0) valid = ParseUnsigned(value, options.clusters);
+  else if (strcmp(name, "dynamic") == 0) valid = ParseFloat(value, options.dynamic_fraction);
+  else if (strcmp(name, "depth") == 0) valid = ParseUnsigned(value, options.hierarchy_depth);
+  else if (strcmp(name, "point-lights") == 0) valid = ParseUnsigned(value, options.point_lights);
+  else if (strcmp(name, "spot-lights") == 0) valid = ParseUnsigned(value, options.spot_lights);
+  else if (strcmp(name, "seed") == 0) valid = ParseUnsigned(value, options.seed);
+  else if (strcmp(name, "model") == 0) options.model_path = value;
+  else if (strcmp(name, "light-radius") == 0) {
+    // min or min:max
+    std::string range = value;
+    size_t colon = range.find(':');
+    std::string min = range.substr(0, colon);
+    valid = ParseFloat(min.c_str(), options.light_radius_min);
+    options.light_radius_max = options.light_radius_min;
+    if (valid && colon != std::string::npos) valid = ParseFloat(value + colon + 1, options.light_radius_max);
+  }
+  else if (strcmp(name, "layout") == 0) {
+    if (strcmp(value, "grid") == 0) options.layout = StressLayout::GRID;
+    else if (strcmp(value, "random") == 0) options.layout = StressLayout::RANDOM;
+    else if (strcmp(value, "clustered") == 0) options.layout = StressLayout::CLUSTERED;
+    else valid = false;
+  }
+  else {
+    std::cout << "Unknown option " << arg << std::endl;
+    return -1;
+  }
+  if (!valid) {
+    std::cout << "Invalid value " << value << " for " << arg << std::endl;
+    return -1;
+  }
+  return 2;
+}
@@ -0,0 +1,70 @@
+#ifndef STRESS_SCENE_H_
+#define STRESS_SCENE_H_
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+enum class StressLayout {
+  GRID,       // square grid, spacing apart
+  RANDOM,     // uniform over the grid's area
+  CLUSTERED   // normal distributions around a few random centers
+};
+
+struct StressSceneOptions {
+  unsigned int models = 0;
+  StressLayout layout = StressLayout::GRID;
+  float spacing = 3.0f;            // grid cell, also sets the area of the other layouts
+  unsigned int clusters = 8;       // CLUSTERED only
+  float dynamic_fraction = 0.1f;   // models moved every frame by Animate, the rest is static
+  unsigned int hierarchy_depth = 1;  // > 1 chains models under parents, depth levels per chain
+  unsigned int point_lights = 0;
+  unsigned int spot_lights = 0;
+  float light_radius_min = 2.0f;   // radius of influence, picked uniformly per light
+  float light_radius_max = 8.0f;
+  unsigned int seed = 1;
+  std::string model_path = "resources/models/default/CUBE/default_cube.obj";
+
+  bool enabled() const { return models || point_lights || spot_lights; }
+};
+
+// STRESS SCENE
+//=-----------------------------=
+// Procedural content for scaling tests: many instances of one model (one
+// load, shared geometry, see Model::Instance) and many lights, added through
+// the regular Scene entry points. The same options and seed always give the
+// same scene, so benchmarks can sweep a count and compare runs.
+class StressScene {
+  struct Mover {
+    Model* model;
+    glm::vec3 base;  // local position
+    float phase;
+  };
+  std::vector<Mover> movers_;
+  glm::vec3 center_ = glm::vec3(0.0f);
+  float extent_ = 0.0f;
+
+public:
+  // Adds the content to scene, point lights get camera like the others
+  void Build(Scene& scene, Camera* camera, const StressSceneOptions& options);
+
+  // Moves the dynamic models, time in seconds
+  void Animate(float time);
+
+  glm::vec3 center() const { return center_; }
+  float extent() const { return extent_; }  // half size of the covered area
+  size_t dynamic_count() const { return movers_.size(); }
+};
+
+// Reads the --stress-* flag at argv[i]. Returns how many arguments it
+// used, 0 when argv[i] is not a stress flag and -1 on errors.
+//   --stress-models N --stress-layout grid|random|clustered
+//   --stress-spacing F --stress-clusters N --stress-dynamic F
+//   --stress-depth N --stress-point-lights N --stress-spot-lights N
+//   --stress-light-radius MIN[:MAX] --stress-seed N --stress-model PATH
+int ParseStressSceneArg(int argc, char** argv, int i, StressSceneOptions& options);
+
+#endif
@@ -0,0 +1,206 @@
+// GPU-free tests for the CPU side of the renderer. GL goes to mock_gl like
+// in MicroBenchmarks, so they run anywhere:
+//
+//   Tests           runs every test, exits with 1 when one fails
+//   Tests Light     only the tests whose name contains "Light"
+#include "mock_gl.h"
+#include "light_clusters.h"
+#include "occlusion_culler.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// standart libraries
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// TEST RUNNER
+//=-----------------------------=
+struct TestCase {
+  const char* name;
+  void (*run)();
+};
+
+static std::vector<TestCase>& Tests() {
+  static std::vector<TestCase> tests;
+  return tests;
+}
+
+static int failures = 0;
+
+struct TestRegistration {
+  TestRegistration(const char* name, void (*run)()) { Tests().push_back({ name, run }); }
+};
+
+#define TEST(name)                                            \
+  static void name();                                         \
+  static TestRegistration name##_registration(#name, name);   \
+  static void name()
+
+// Reports a failed condition and keeps going
+#define CHECK(condition)                                                               \
+  do {                                                                                 \
+    if (!(condition)) {                                                                \
+      std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);      \
+      failures++;                                                                      \
+    }                                                                                  \
+  } while (0)
+
+// LIGHT CLUSTERS
+//=-----------------------------=
+// Point and spot lists of one cluster
+struct ClusterLists {
+  std::vector<unsigned int> points, spots;
+  bool operator==(const ClusterLists& other) const { return points == other.points && spots == other.spots; }
+};
+
+static ClusterLists Lists(const LightClusters& clusters, size_t cluster) {
+  const ClusterData& data = clusters.clusters()[cluster];
+  const unsigned int* list = clusters.indices().data() + data.offset;
+  return { std::vector<unsigned int>(list, list + data.point_count),
+           std::vector<unsigned int>(list + data.point_count, list + data.point_count + data.spot_count) };
+}
+
+// 90 degree square frustum from 1 to 100 split into 2 x 2 tiles and the
+// slices [1, 10] and [10, 100], camera at the origin looking down -z
+TEST(LightClusters_BinsLightsIntoExpectedClusters) {
+  LightClusters clusters;
+  clusters.SetGrid(2, 2, 2);
+  clusters.SetThreads(1);
+  glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 100.0f);
+  std::vector<ClusterLight> points = {
+    { glm::vec3(-3.0f, -3.0f, -5.0f), 0.5f },  // near slice, bottom left tile
+    { glm::vec3(0.0f, 0.0f, -50.0f), 1.0f },   // far slice, on the axis, every tile
+    { glm::vec3(0.0f, 0.0f, 5.0f), 1.0f },     // behind the camera
+  };
+  std::vector<ClusterLight> spots = {
+    { glm::vec3(3.0f, 3.0f, -20.0f), 0.5f },   // far slice, top right tile
+  };
+  clusters.Build(glm::mat4(1.0f), projection, 1.0f, 100.0f, points, spots);
+
+  // Cluster x, y, z is at (z * 2 + y) * 2 + x
+  const ClusterLists expected[8] = {
+    { { 0 }, {} }, { {}, {} }, { {}, {} }, { {}, {} },
+    { { 1 }, {} }, { { 1 }, {} }, { { 1 }, {} }, { { 1 }, { 0 } },
+  };
+  CHECK(clusters.clusters().size() == 8);
+  for (size_t i = 0; i < 8 && i < clusters.clusters().size(); i++) CHECK(Lists(clusters, i) == expected[i]);
+  CHECK(clusters.indices().size() == 6);
+  CHECK(clusters.dropped() == 0);
+}
+
+// Enough lights to wake the workers, built twice so the second build runs
+// on the already started pool
+TEST(LightClusters_WorkersMatchSingleThread) {
+  glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> position(-40.0f, 40.0f), radius(0.5f, 8.0f);
+  std::vector<ClusterLight> points(64), spots(32);
+  for (auto lights : { &points, &spots }) {
+    for (ClusterLight& light : *lights) light = { glm::vec3(position(random), position(random), position(random)), radius(random) };
+  }
+
+  LightClusters single, pooled;
+  single.SetThreads(1);
+  pooled.SetThreads(4);
+  single.Build(view, projection, 0.1f, 200.0f, points, spots);
+  for (int build = 0; build < 2; build++) {
+    pooled.Build(view, projection, 0.1f, 200.0f, points, spots);
+    CHECK(pooled.indices() == single.indices());
+    CHECK(pooled.dropped() == single.dropped());
+    bool same = pooled.clusters().size() == single.clusters().size();
+    for (size_t i = 0; same && i < single.clusters().size(); i++) same = Lists(pooled, i) == Lists(single, i);
+    CHECK(same);
+  }
+  CHECK(!single.indices().empty());
+}
+
+// OCCLUSION CULLER
+//=-----------------------------=
+// side x side grid over [-size, size]^2 at view depth z, simplified like a
+// model's occluder mesh
+static OccluderMesh MakeWall(float size, float z, unsigned int side) {
+  std::vector<glm::vec3> positions;
+  std::vector<unsigned int> indices;
+  for (unsigned int y = 0; y < side; y++) {
+    for (unsigned int x = 0; x < side; x++) {
+      positions.push_back(glm::vec3(size * (2.0f * x / (side - 1) - 1.0f), size * (2.0f * y / (side - 1) - 1.0f), z));
+    }
+  }
+  for (unsigned int y = 0; y + 1 < side; y++) {
+    for (unsigned int x = 0; x + 1 < side; x++) {
+      unsigned int i = y * side + x;
+      indices.insert(indices.end(), { i, i + 1, i + side, i + 1, i + side + 1, i + side });
+    }
+  }
+  return SimplifyOccluder(positions, indices, 4);
+}
+
+// Camera at the origin looking down -z, a wall at depth 10 covers the screen
+static void RasterizeWall(OcclusionCuller& culler) {
+  glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 1.0f, 100.0f);
+  culler.Resize(256, 144);
+  culler.Begin(projection);
+  culler.AddOccluder(MakeWall(100.0f, -10.0f, 9), glm::mat4(1.0f));
+  culler.Finish();
+}
+
+static bool BoxVisible(const OcclusionCuller& culler, float z_min, float z_max) {
+  return culler.IsVisible(glm::vec3(-1.0f, -1.0f, z_min), glm::vec3(1.0f, 1.0f, z_max), glm::mat4(1.0f));
+}
+
+TEST(OcclusionCuller_SimplifiedWallKeepsItsBounds) {
+  OccluderMesh wall = MakeWall(100.0f, -10.0f, 9);
+  CHECK(!wall.indices.empty());
+  CHECK(wall.vertices.size() < 81);
+  glm::vec3 lo = wall.vertices[0], hi = wall.vertices[0];
+  for (const glm::vec3& vertex : wall.vertices) {
+    lo = glm::min(lo, vertex);
+    hi = glm::max(hi, vertex);
+  }
+  // Merged vertices move by at most one cell of 50
+  CHECK(lo.x <= -50.0f && lo.y <= -50.0f && hi.x >= 50.0f && hi.y >= 50.0f);
+}
+
+TEST(OcclusionCuller_BoxBehindOccluderIsCulled) {
+  OcclusionCuller culler;
+  RasterizeWall(culler);
+  CHECK(!BoxVisible(culler, -22.0f, -20.0f));
+}
+
+TEST(OcclusionCuller_BoxInFrontOfOccluderIsKept) {
+  OcclusionCuller culler;
+  RasterizeWall(culler);
+  CHECK(BoxVisible(culler, -6.0f, -4.0f));
+}
+
+TEST(OcclusionCuller_BoxCrossingNearPlaneIsKept) {
+  OcclusionCuller culler;
+  RasterizeWall(culler);
+  CHECK(BoxVisible(culler, -5.0f, 0.5f));
+}
+
+TEST(OcclusionCuller_SameInputSameResult) {
+  OcclusionCuller first, second;
+  RasterizeWall(first);
+  RasterizeWall(second);
+  CHECK(first.depth() == second.depth());
+  CHECK(first.triangle_count() == second.triangle_count());
+  for (float z : { -22.0f, -10.5f, -9.5f, -6.0f }) CHECK(BoxVisible(first, z - 1.0f, z) == BoxVisible(second, z - 1.0f, z));
+}
+
+int main(int argc, char** argv) {
+  mock_gl::Install();
+  int run = 0;
+  for (const TestCase& test : Tests()) {
+    if (argc > 1 && !std::strstr(test.name, argv[1])) continue;
+    int before = failures;
+    test.run();
+    std::printf("%s %s\n", failures == before ? "[  OK  ]" : "[ FAIL ]", test.name);
+    run++;
+  }
+  std::printf("%d tests, %d failed checks\n", run, failures);
+  return failures ? 1 : 0;
+}
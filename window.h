@@ -17,7 +17,7 @@ class Window {
   GLFWwindow* window_;
   int screenWidth;
   int screenHeight;
-  InputHandler* input_handler_;
+  InputHandler* input_handler_ = nullptr;
   float lastX = 400, lastY = 300;
 public:
   Window(int gl_version_major, int gl_version_minor) {
@@ -48,6 +48,8 @@ public:
 
     // Set this Window instance as the user pointer for the GLFW window
     glfwSetWindowUserPointer(window_, this);
+    // Maximized is smaller than the video mode (title bar, task bar)
+    glfwGetFramebufferSize(window_, &screenWidth, &screenHeight);
 
     // glad: load all OpenGL function pointers
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -60,21 +62,77 @@ public:
     glfwSwapInterval(0);
   }
 
+  // Offscreen window for the benchmark: fixed size, never shown, no input
+  // callbacks. GLFW 3.4 runs on its null platform there, with an EGL
+  // (surfaceless Mesa) or OSMesa context, so no display server is needed and
+  // llvmpipe works in CI. Older GLFW falls back to a hidden native window.
+  Window(int gl_version_major, int gl_version_minor, int width, int height)
+    : window_(NULL), screenWidth(width), screenHeight(height) {
+#ifdef GLFW_PLATFORM_NULL
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (glfwInit()) {
+      const int apis[] = { GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API };
+      for (int api : apis) {
+        SetOffscreenHints(gl_version_major, gl_version_minor);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+        window_ = glfwCreateWindow(width, height, "Benchmark", NULL, NULL);
+        if (window_) break;
+      }
+      if (!window_) glfwTerminate();
+    }
+    glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+#endif
+    if (!window_ && glfwInit()) {
+      SetOffscreenHints(gl_version_major, gl_version_minor);
+      window_ = glfwCreateWindow(width, height, "Benchmark", NULL, NULL);
+    }
+    if (window_ == NULL) {
+      std::cout << "Failed to create an offscreen GL context" << std::endl;
+      glfwTerminate();
+      return;
+    }
+    glfwMakeContextCurrent(window_);
+    glfwSetWindowUserPointer(window_, this);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+    }
+    glfwSwapInterval(0);
+  }
+
   void SetInputHandler(InputHandler* input_handler) { input_handler_ = input_handler; }
 
   GLFWwindow* GetWindowPTR() { return window_; }
+  bool IsValid() const { return window_ != NULL; }
   int GetScreenWidth() { return screenWidth; }
   int GetScreenHeight() { return screenHeight; }
 
 
 
 private:
+  static void SetOffscreenHints(int gl_version_major, int gl_version_minor) {
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, gl_version_major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, gl_version_minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+  }
+
   // glfw: whenever the window size changed (by OS or user resize)
-  // this callback function executes
+  // this callback function executes. The renderer picks the new size up
+  // at the start of its next frame.
   // -----------------------------------------------------------------------
   static void framebuffer_size_callback(GLFWwindow* window, 
                                         int width, int height) {
+    // Minimized windows report 0 x 0, keep the last size
+    if (width <= 0 || height <= 0) return;
     glViewport(0, 0, width, height);
+    Window* win = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if (win) {
+      win->screenWidth = width;
+      win->screenHeight = height;
+    }
   }
 
   static void mouse_callback(GLFWwindow* window, double xpos, double ypos) {